@@ -30,9 +30,12 @@
 #include "jacui/window.hpp"
 #include "jacui/cursors.hpp"
 #include "jacui/image.hpp"
+#include "jacui/prefetcher.hpp"
 #include "jacui/font.hpp"
 
 #include <algorithm>
+#include <string>
+#include <vector>
 #include <iostream>
 #include <cctype>
 #include <ctime>
@@ -292,7 +295,7 @@ std::string filename(const std::string& path)
 void update(window& win, const image& img, const font& f, const char* path)
 {
     win.caption(filename(path));
-    win.view().blit(img, win.size());
+    win.view().blit(img, win.size(), surface::bilinear);
     draw(win.view(), f, path);
     win.update();
 }
@@ -314,6 +317,36 @@ void update(window& win, const image& img, const font& f, const char* path, poin
     win.update();
 }
 
+const image& current(image_prefetcher& images)
+{
+    static const image empty;
+
+    try {
+        return images.current();
+    } catch (std::exception& e) {
+        std::cerr << images.filename() << ": " << e.what() << "\n";
+        return empty;
+    }
+}
+
+// keep showing the previous image while the current one is being
+// decoded, rather than waiting for it
+void update(window& win, image_prefetcher& images, const font& f)
+{
+    if (images.ready())
+        update(win, current(images), f, images.filename().c_str());
+    else
+        win.update(rect2d(win.size()));
+}
+
+void update(window& win, image_prefetcher& images, const font& f, point2d p)
+{
+    if (images.ready())
+        update(win, current(images), f, images.filename().c_str(), p);
+    else
+        win.update(rect2d(win.size()));
+}
+
 void usage(std::ostream& os, const char* name) 
 {
     os << "Usage: " << name << " [ OPTION ] FILE ...\n"
@@ -380,16 +413,17 @@ int main(int argc, char* argv[])
         return EXIT_FAILURE;
     }
 
-    int index = ::optind;
     bool zoom = false;
     point2d pos;
 
-    image img(argv[index]);
     font fnt(bitstream_vera_ttf, sizeof bitstream_vera_ttf, 12);
-    window win(filename(argv[index]), width, height, flags);
+    window win(filename(argv[::optind]), width, height, xrgb8888, flags);
+    image_prefetcher images(std::vector<std::string>(argv + ::optind, argv + argc), win.events());
+    images.optimize_for(win);
+    bool waiting = !images.ready();
     win.cursor(cursors::crosshair());
 
-    update(win, img, fnt, argv[index]);
+    update(win, images, fnt);
 
     timer_event::timer_type timer = interval ? win.events().set_interval(interval) : 0;
 
@@ -407,9 +441,9 @@ int main(int argc, char* argv[])
         switch (pe->type()) {
         case event::redraw:
             if (zoom) {
-                update(win, img, fnt, argv[index], pos);
+                update(win, images, fnt, pos);
             } else {
-                update(win, img, fnt, argv[index]);
+                update(win, images, fnt);
             }
             break;
 
@@ -418,9 +452,9 @@ int main(int argc, char* argv[])
             assert(me);
 
             if ((zoom = !zoom)) {
-                update(win, img, fnt, argv[index], pos = me->point());
+                update(win, images, fnt, pos = me->point());
             } else {
-                update(win, img, fnt, argv[index]);
+                update(win, images, fnt);
             }
 
             break;
@@ -438,21 +472,19 @@ int main(int argc, char* argv[])
             } 
 
             if (ke->key() == ' ' || ke->key() == 'N') {
-                if (++index == argc)
-                    index = ::optind;
-                img.load(argv[index]);
-                update(win, img, fnt, argv[index]);
+                images.next();
+                if (!(waiting = !images.ready()))
+                    update(win, images, fnt);
                 zoom = false;
             } else if (ke->key() == keyboard_event::bs || ke->key() == 'P') {
-                if (--index < :: optind)
-                    index = argc -1;
-                img.load(argv[index]);
-                update(win, img, fnt, argv[index]);
+                images.prev();
+                if (!(waiting = !images.ready()))
+                    update(win, images, fnt);
                 zoom = false;
             } else if (ke->key() == keyboard_event::ht) {
                 win.resize(width, height);
                 // programmatic resize does not trigger redraw event!
-                update(win, img, fnt, argv[index]);
+                update(win, images, fnt);
             } else if (ke->key() == keyboard_event::esc || ke->key() == 'Q') {
                 win.close();
             }
@@ -473,10 +505,20 @@ int main(int argc, char* argv[])
 
         case event::timer:
             if (!zoom) {
-                if (++index == argc)
-                    index = ::optind;
-                img.load(argv[index]);
-                update(win, img, fnt, argv[index]);
+                images.next();
+                if (!(waiting = !images.ready()))
+                    update(win, images, fnt);
+            }
+            break;
+
+        case event::user:
+            if (images.update(pe) && waiting && images.ready()) {
+                if (zoom) {
+                    update(win, images, fnt, pos);
+                } else {
+                    update(win, images, fnt);
+                }
+                waiting = false;
             }
             break;
 
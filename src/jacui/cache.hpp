@@ -0,0 +1,156 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef JACUI_CACHE_HPP
+#define JACUI_CACHE_HPP
+
+#include "image.hpp"
+
+namespace jacui {
+    /**
+       \brief jacui image cache class
+
+       An image cache keeps recently loaded image files in memory,
+       so loading the same file again becomes a lookup.  Images are
+       looked up by file name, optional target size and optional
+       pixel format; a file that has been modified since it was
+       cached is loaded again.  Least recently used images are
+       evicted when the cached images exceed a memory budget.
+
+       Images returned by the cache share their pixels with the
+       cache, so a hit copies no pixels.  Drawing onto a returned
+       image first gives it a copy of its own, which leaves the
+       cached image unchanged; the same applies to changing its
+       mipmaps setting.  All member functions may be called from
+       any thread.
+    */
+    class image_cache {
+    public:
+        /**
+           \brief image cache statistics
+        */
+        struct cache_stats {
+            std::size_t hits;      // images found in the cache
+            std::size_t misses;    // images that had to be loaded
+            std::size_t evictions; // images evicted to stay within budget
+            std::size_t entries;   // images currently cached
+            std::size_t bytes;     // memory used by cached images
+        };
+
+    public:
+        /**
+           \brief create an image cache
+
+           \param budget the memory budget for cached images in bytes
+        */
+        explicit image_cache(std::size_t budget = 64 << 20);
+
+        /**
+           \brief destroy an image cache
+
+           Images that have been retrieved from the cache remain
+           valid.
+        */
+        ~image_cache();
+
+        /**
+           \brief the process-wide image cache
+        */
+        static image_cache& instance();
+
+        /**
+           \brief retrieve an image file
+
+           Throws an error if the image could not be loaded.
+
+           \param filename the file to load
+        */
+        image get(const char* filename);
+
+        /**
+           \brief retrieve an image file, scaled down to fit a size
+
+           The image keeps its aspect ratio and is never enlarged.
+
+           \param filename the file to load
+           \param size the maximum size of the image
+        */
+        image get(const char* filename, const size2d& size);
+
+        /**
+           \brief retrieve an image file, converted to a pixel format
+
+           \param filename the file to load
+           \param format the pixel format of the image
+        */
+        image get(const char* filename, pixel_format format);
+
+        /**
+           \brief retrieve an image file, scaled down to fit a size
+           and converted to a pixel format
+
+           \param filename the file to load
+           \param size the maximum size of the image
+           \param format the pixel format of the image
+        */
+        image get(const char* filename, const size2d& size, pixel_format format);
+
+        /**
+           \brief the memory budget for cached images in bytes
+        */
+        std::size_t budget() const;
+
+        /**
+           \brief set the memory budget for cached images in bytes
+
+           Least recently used images are evicted until the cached
+           images fit the new budget.
+        */
+        void budget(std::size_t bytes);
+
+        /**
+           \brief remove all images from the cache
+        */
+        void clear();
+
+        /**
+           \brief image cache statistics
+        */
+        cache_stats stats() const;
+
+    private:
+        image_cache(const image_cache&);
+        image_cache& operator=(const image_cache&);
+
+    private:
+        struct impl;
+        impl* pimpl_;
+    };
+}
+
+#endif
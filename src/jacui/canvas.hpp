@@ -39,6 +39,15 @@ namespace jacui {
        application can draw.
     */
     class canvas: public surface {
+    public:
+        /**
+           \brief function releasing pixels owned by the caller
+
+           Called with the pixels and the context passed to the
+           canvas constructor.
+        */
+        typedef void (*release_function)(void* pixels, void* context);
+
     public:
         /**
            \brief create an empty canvas
@@ -48,10 +57,26 @@ namespace jacui {
         /**
            \brief create a copy of an existing canvas
 
+           The copy shares the canvas's pixels until either of them
+           is drawn onto, so copies are cheap.
+
            \param rhs the canvas to be copied
         */
         canvas(const canvas& rhs);
 
+#ifdef JACUI_HAS_RVALUE_REFERENCES
+        /**
+           \brief move an existing canvas
+
+           No pixels are copied, rhs is left empty.
+
+           \param rhs the canvas to be moved
+        */
+        canvas(canvas&& rhs) noexcept : pimpl_(rhs.pimpl_) {
+            rhs.pimpl_ = 0;
+        }
+#endif
+
         /**
            \brief create a canvas with a specified size
 
@@ -67,6 +92,44 @@ namespace jacui {
         */
         canvas(std::size_t width, std::size_t height);
 
+        /**
+           \brief create a canvas with a specified size and pixel format
+
+           \param size the size of the canvas
+           \param format the pixel format of the canvas
+        */
+        canvas(const size2d& size, pixel_format format);
+
+        /**
+           \brief create a canvas with a specified size and pixel format
+
+           \param width the width of the canvas
+           \param height the height of the canvas
+           \param format the pixel format of the canvas
+        */
+        canvas(std::size_t width, std::size_t height, pixel_format format);
+
+        /**
+           \brief create a canvas drawing directly onto caller-owned pixels
+
+           No pixels are copied, so e.g. camera frames or shared
+           memory buffers can be blitted and drawn onto in place.
+           The pixels must stay valid until the canvas, and any
+           surface sharing them, is destroyed; then release is
+           called, if given.  It is also called if the constructor
+           throws.  Copies of the canvas own their pixels.
+
+           \param pixels the first pixel of the top row
+           \param size the size of the canvas
+           \param pitch the distance between rows in bytes, at most 65535
+           \param format the pixel format of the pixels
+           \param release the function to call when the pixels are
+           no longer used, or 0
+           \param context passed to release
+        */
+        canvas(void* pixels, const size2d& size, std::size_t pitch, pixel_format format,
+               release_function release = 0, void* context = 0);
+
         /**
            \brief destroy a canvas
         */
@@ -75,6 +138,14 @@ namespace jacui {
         /**
            \brief resize a canvas
 
+           The pixel format of the canvas is preserved.  If the new
+           size fits into the canvas's capacity, no memory is
+           allocated and no pixels are copied; pixels that become
+           visible are cleared.  Otherwise the capacity grows to the
+           largest width and height the canvas has had.  Canvases
+           of external pixels or of a mapped file are always copied
+           to newly allocated pixels.
+
            \param size the new size of the canvas
         */
         void resize(const size2d& size);
@@ -87,6 +158,46 @@ namespace jacui {
         */
         void resize(std::size_t width, std::size_t height);
 
+        /**
+           \brief the width and height of the canvas's allocated pixels
+        */
+        size2d capacity() const;
+
+        /**
+           \brief allocate room for a canvas to grow
+
+           The canvas's size and pixels are preserved.
+
+           \param size the minimum capacity
+        */
+        void reserve(const size2d& size);
+
+        /**
+           \brief save a canvas to a snapshot file
+
+           The file stores the canvas's pixels as they are in memory,
+           so it can be restored with map_raw() without decoding.
+           Snapshot files are meant as a cache on the machine that
+           wrote them, not as an interchange format.  Canvases with
+           a palette cannot be saved.
+
+           \param filename the file to write
+        */
+        void save_raw(const char* filename) const;
+
+        /**
+           \brief restore a canvas from a snapshot file
+
+           The canvas's pixels refer directly to a mapping of the
+           file, so no pixels are read or copied until they are used.
+           Drawing onto the canvas changes the canvas, but not the
+           file.  Throws an error if the file was not written by
+           save_raw() on a machine with the same byte order.
+
+           \param filename the file to map
+        */
+        void map_raw(const char* filename);
+
         /**
            \brief swap two canvas instances
 
@@ -105,12 +216,60 @@ namespace jacui {
             return *this;
         }
 
+#ifdef JACUI_HAS_RVALUE_REFERENCES
+        /**
+           \brief move an existing canvas
+
+           \param rhs the canvas to be moved
+        */
+        canvas& operator=(canvas&& rhs) noexcept {
+            canvas tmp(static_cast<canvas&&>(rhs));
+            swap(tmp);
+            return *this;
+        }
+#endif
+
+    public:
+        /**
+           \brief the memory budget of the canvas pool in bytes
+        */
+        static std::size_t pool_budget();
+
+        /**
+           \brief set the memory budget of the canvas pool in bytes
+
+           Pixels of destroyed canvases are kept in a process wide
+           pool and reused by new canvases with the same pixel format
+           and size class, so e.g. resizing a window does not keep
+           allocating and faulting in memory.  While the pool is
+           enabled, canvases are allocated rounded up to their size
+           class, by at most a quarter of their width and height.
+           The least recently pooled pixels are freed to stay within
+           the budget.  The default budget is 0, which disables the
+           pool.
+
+           \param bytes the memory budget, or 0 to free all pooled pixels
+        */
+        static void pool_budget(std::size_t bytes);
+
     public:
+        /**
+           \brief implementation detail
+
+           Takes over a reference to a surface.
+        */
+        explicit canvas(detail::surface_type* p);
+
         /**
            \brief implementation detail
         */
         detail::surface_type* detail() const;
 
+        /**
+           \brief implementation detail
+        */
+        detail::surface_type* unshare();
+
     private:
         struct impl;
         impl* pimpl_;
@@ -58,6 +58,19 @@ namespace jacui {
         */
         cursor(const cursor& rhs);
 
+#ifdef JACUI_HAS_RVALUE_REFERENCES
+        /**
+           \brief move an existing cursor
+
+           Cursors are never freed, so rhs still refers to the same
+           cursor.
+
+           \param rhs the cursor to be moved
+        */
+        cursor(cursor&& rhs) noexcept : pimpl_(rhs.pimpl_) {
+        }
+#endif
+
         /**
            \brief destroy a cursor
         */
@@ -81,6 +94,19 @@ namespace jacui {
             return *this;
         }
 
+#ifdef JACUI_HAS_RVALUE_REFERENCES
+        /**
+           \brief move an existing cursor
+
+           \param rhs the cursor to be moved
+        */
+        cursor& operator=(cursor&& rhs) noexcept {
+            cursor tmp(static_cast<cursor&&>(rhs));
+            swap(tmp);
+            return *this;
+        }
+#endif
+
     public:
         /**
            \brief implementation detail
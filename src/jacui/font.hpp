@@ -38,12 +38,35 @@ namespace jacui {
        \brief jacui font class
     */
     class font {
+    public:
+        /**
+           \brief text size cache statistics
+        */
+        struct cache_stats {
+            std::size_t hits;   // text sizes found in the cache
+            std::size_t misses; // text sizes that had to be computed
+        };
+
     public:
         /**
            \brief create a copy of an existing font
         */
         font(const font& rhs);
 
+#ifdef JACUI_HAS_RVALUE_REFERENCES
+        /**
+           \brief move an existing font
+
+           The font data is not copied; rhs may only be destroyed or
+           assigned to.
+
+           \param rhs the font to be moved
+        */
+        font(font&& rhs) noexcept : pimpl_(rhs.pimpl_) {
+            rhs.pimpl_ = 0;
+        }
+#endif
+
         /**
            \brief create a copy of an existing font with a spezified size
         */
@@ -99,23 +122,61 @@ namespace jacui {
         */
         int leading() const;
 
+        /**
+           \brief whether pairs of glyphs of this font are kerned
+
+           Kerned text is rendered by SDL_ttf.  Text of fonts without
+           kerning, or with kerning disabled, is drawn from a cache
+           of glyphs, which is considerably faster.
+        */
+        bool kerning() const;
+
+        /**
+           \brief enable or disable kerning of this font
+
+           Kerning is enabled by default, if the font and SDL_ttf
+           support it.
+        */
+        void kerning(bool enable);
+
         /**
            \brief calculate the size of some text
+
+           This is the size of the canvas returned by render().
         */
         size2d size(const std::string& text) const;
 
         /**
            \brief calculate the size of some text
+
+           This is the size of the canvas returned by render().
         */
         size2d size(const std::wstring& text) const;
 
+        /**
+           \brief text size cache statistics of this font
+
+           Sizes of longer text are kept in a cache of recently used
+           strings.  Short ASCII or Latin-1 text is measured directly
+           and is not counted.
+        */
+        cache_stats stats() const;
+
         /**
            \brief render some text to a canvas
+
+           The canvas has the size returned by size(), with the
+           baseline ascent() pixels from the top unless some glyph
+           extends above the font's ascent.
         */
         canvas render(const std::string& text, color fg, color bg) const;
 
         /**
            \brief render some text to a canvas
+
+           The canvas has the size returned by size(), with the
+           baseline ascent() pixels from the top unless some glyph
+           extends above the font's ascent.
         */
         canvas render(const std::wstring& text, color fg, color bg) const;
 
@@ -162,6 +223,19 @@ namespace jacui {
             return *this;
         }
 
+#ifdef JACUI_HAS_RVALUE_REFERENCES
+        /**
+           \brief move an existing font
+
+           \param rhs the font to be moved
+        */
+        font& operator=(font&& rhs) noexcept {
+            font tmp(static_cast<font&&>(rhs));
+            swap(tmp);
+            return *this;
+        }
+#endif
+
     private:
         struct impl;
         impl* pimpl_;
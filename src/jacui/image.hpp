@@ -30,8 +30,29 @@
 #define JACUI_IMAGE_HPP
 
 #include "surface.hpp"
+#include "event.hpp"
 
 namespace jacui {
+    class window;
+
+    class image_future;
+
+    namespace detail {
+        void reprioritize_load(const image_future& f, int priority);
+    }
+
+    /**
+       \brief image file properties
+
+       \see image::probe
+    */
+    struct image_info {
+        size2d size;        // the image's size
+        std::size_t depth;  // bits per pixel, or per color index
+        bool alpha;         // whether the image has transparent pixels
+        std::size_t frames; // the number of animation frames
+    };
+
     /**
        \brief jacui image class
 
@@ -47,9 +68,25 @@ namespace jacui {
 
         /**
            \brief create a copy of an existing image
+
+           The copy shares the image's pixels until either of them is
+           drawn onto, so copies are cheap.
         */
         image(const image& rhs);
 
+#ifdef JACUI_HAS_RVALUE_REFERENCES
+        /**
+           \brief move an existing image
+
+           No pixels are copied, rhs is left empty.
+
+           \param rhs the image to be moved
+        */
+        image(image&& rhs) noexcept : pimpl_(rhs.pimpl_) {
+            rhs.pimpl_ = 0;
+        }
+#endif
+
         /**
            \brief create an image from a file
         */
@@ -60,6 +97,35 @@ namespace jacui {
         */
         image(const void* data, std::size_t size);
 
+        /**
+           \brief create an image from a file, scaled down to fit a size
+
+           The image keeps its aspect ratio and is never enlarged.
+           Where supported, i.e. for JPEG and non-interlaced PNG
+           files, the image is scaled while it is decoded, so memory
+           use and decoding time depend on the resulting size rather
+           than the size of the file's image.
+
+           \param filename the file to load
+           \param max_size the maximum size of the image; a zero
+           width or height does not limit that dimension
+        */
+        image(const char* filename, const size2d& max_size);
+
+        /**
+           \brief create an image from a file, optimized for a window
+
+           \see optimize_for
+        */
+        image(const char* filename, const window& w);
+
+        /**
+           \brief create an image from memory, optimized for a window
+
+           \see optimize_for
+        */
+        image(const void* data, std::size_t size, const window& w);
+
         /**
           \brief destroy an image
         */
@@ -75,6 +141,127 @@ namespace jacui {
         */
         void load(const void* data, std::size_t size);
 
+        /**
+          \brief map an image file into memory
+
+          For uncompressed files whose pixel rows are stored top to
+          bottom, i.e. binary PPM and PGM files, top-down BMP files
+          and TGA files with a top-left origin, the image's pixels
+          refer directly to a mapping of the file, so no pixels are
+          read or copied until they are used.  Drawing onto such an
+          image changes the image, but not the file.  Other files
+          are loaded as with load().
+
+          \param filename the file to map
+        */
+        void map(const char* filename);
+
+        /**
+          \brief load an image from a file, scaled down to fit a size
+
+          \see image(const char*, const size2d&)
+        */
+        void load(const char* filename, const size2d& max_size);
+
+        /**
+          \brief load an image from a file, optimized for a window
+
+          \see optimize_for
+        */
+        void load(const char* filename, const window& w);
+
+        /**
+          \brief load an image from memory, optimized for a window
+
+          \see optimize_for
+        */
+        void load(const void* data, std::size_t size, const window& w);
+
+        /**
+           \brief convert an image to the pixel format of a window
+
+           Blitting an image to a window is fastest if both share the
+           same pixel format.  Images with an alpha channel keep it,
+           using the window's color channels plus an alpha channel.
+
+           \param w the window the image will be displayed in
+        */
+        void optimize_for(const window& w);
+
+        /**
+           \brief enable or disable mipmaps
+
+           With mipmaps enabled, blits that scale the image down to
+           half its size or less read from a chain of levels, each
+           with half the width and height of the previous one and
+           averaged from its 2x2 pixel blocks.  Scaling cost then
+           depends on the destination size rather than the image
+           size, and aliasing is reduced.
+
+           Levels are built when first needed and are shared by
+           images that share the same pixels, e.g. images retrieved
+           from an image_cache.  They are discarded when the image is
+           drawn onto.  Only images with 8 bit color channels and
+           without a color key use mipmaps.  The setting applies to
+           the image's current pixels, loading another image resets
+           it.
+        */
+        void mipmaps(bool enable);
+
+        /**
+           \brief whether mipmaps are enabled
+        */
+        bool mipmaps() const;
+
+        /**
+           \brief determine the properties of an image file
+
+           Only the file's headers are read, which is much faster
+           than loading the image.  PNG, JPEG, GIF, BMP and TGA files
+           are supported; throws an error for other or damaged files.
+
+           \param filename the file to examine
+        */
+        static image_info probe(const char* filename);
+
+        /**
+           \brief determine the properties of an image in memory
+
+           \see probe(const char*)
+        */
+        static image_info probe(const void* data, std::size_t size);
+
+        /**
+           \brief load an image from a file in the background
+
+           The image is decoded on a background thread.  Use the
+           returned future to wait for the image, or to check whether
+           it is ready.
+
+           \param filename the file to load
+        */
+        static image_future load_async(const char* filename);
+
+        /**
+           \brief load an image from a file in the background
+
+           Like load_async(filename), but also pushes a user event to
+           an event queue when the image is ready.  Use
+           image_future::matches() to find out which load an event
+           belongs to.
+
+           \param filename the file to load
+           \param events the event queue to notify, e.g. window::events()
+        */
+        static image_future load_async(const char* filename, event_queue& events);
+
+        /**
+           \brief mark an area of the image as changed
+
+           Discards the image's mip levels.
+        */
+        void damage(const rect2d& r);
+
         /**
            \brief swap two image instances
 
@@ -93,12 +280,37 @@ namespace jacui {
             return *this;
         }
 
+#ifdef JACUI_HAS_RVALUE_REFERENCES
+        /**
+           \brief move an existing image
+
+           \param rhs the image to be moved
+        */
+        image& operator=(image&& rhs) noexcept {
+            image tmp(static_cast<image&&>(rhs));
+            swap(tmp);
+            return *this;
+        }
+#endif
+
     public:
+        /**
+           \brief implementation detail
+
+           Takes over a reference to a surface.
+        */
+        explicit image(detail::surface_type* p);
+
         /**
            \brief implementation detail
         */
         detail::surface_type* detail() const;
 
+        /**
+           \brief implementation detail
+        */
+        detail::surface_type* unshare();
+
     private:
         struct impl;
         impl* pimpl_;
@@ -113,6 +325,126 @@ namespace jacui {
     inline void swap(image& lhs, image& rhs) {
         lhs.swap(rhs);
     }
+
+    /**
+       \brief the result of an asynchronous image load
+
+       Copies of a future refer to the same load.  If all copies are
+       destroyed before decoding has started, the load is cancelled.
+    */
+    class image_future {
+    public:
+        /**
+           \brief create a future that does not refer to a load
+        */
+        image_future();
+
+        /**
+           \brief create a copy of an existing future
+        */
+        image_future(const image_future& rhs);
+
+#ifdef JACUI_HAS_RVALUE_REFERENCES
+        /**
+           \brief move an existing future
+
+           rhs no longer refers to a load.
+
+           \param rhs the future to be moved
+        */
+        image_future(image_future&& rhs) noexcept : state_(rhs.state_) {
+            rhs.state_ = 0;
+        }
+#endif
+
+        /**
+           \brief destroy a future
+        */
+        ~image_future();
+
+        /**
+           \brief whether the future refers to a load
+        */
+        bool valid() const;
+
+        /**
+           \brief whether the load has finished, i.e. get() will not block
+        */
+        bool ready() const;
+
+        /**
+           \brief wait for the load to finish
+        */
+        void wait() const;
+
+        /**
+           \brief wait for and retrieve the loaded image
+
+           The image is moved out of the future, so it can only be
+           retrieved once; later calls return an empty image.  Throws
+           an error if the image could not be loaded.
+        */
+        image get();
+
+        /**
+           \brief whether an event signals that this load has finished
+        */
+        bool matches(const event* e) const;
+
+        /**
+           \brief swap two future instances
+
+           \param rhs the future to be swapped
+        */
+        void swap(image_future& rhs);
+
+        /**
+           \brief copy an existing future
+
+           \param rhs the future to be copied
+        */
+        image_future& operator=(const image_future& rhs) {
+            image_future tmp(rhs);
+            swap(tmp);
+            return *this;
+        }
+
+#ifdef JACUI_HAS_RVALUE_REFERENCES
+        /**
+           \brief move an existing future
+
+           \param rhs the future to be moved
+        */
+        image_future& operator=(image_future&& rhs) noexcept {
+            image_future tmp(static_cast<image_future&&>(rhs));
+            swap(tmp);
+            return *this;
+        }
+#endif
+
+    public:
+        struct state;
+
+        /**
+           \brief implementation detail
+        */
+        explicit image_future(state* p);
+
+    private:
+        friend void detail::reprioritize_load(const image_future& f, int priority);
+
+        state* state_;
+    };
+
+    /**
+       \brief swap two future instances
+
+       \param lhs the first future to be swapped
+       \param rhs the second future to be swapped
+    */
+    inline void swap(image_future& lhs, image_future& rhs) {
+        lhs.swap(rhs);
+    }
 }
 
 #endif
@@ -0,0 +1,155 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef JACUI_PREFETCHER_HPP
+#define JACUI_PREFETCHER_HPP
+
+#include "image.hpp"
+
+#include <string>
+#include <vector>
+
+namespace jacui {
+    /**
+       \brief jacui image prefetcher class
+
+       An image prefetcher steps through a list of image files, like
+       a slide show, and decodes the images around the current one
+       in the background.  Images in the direction of the last move
+       are decoded first, and pending ones are reordered when the
+       direction changes.  Decoded images are kept while they are
+       within range and within a memory budget, so moving to an
+       adjacent image usually does not wait for decoding.
+    */
+    class image_prefetcher {
+    public:
+        /**
+           \brief create an image prefetcher
+
+           \param files the image files, positioned at the first
+           \param ahead the number of following images to keep
+           \param behind the number of preceding images to keep
+           \param budget the memory budget for decoded images in bytes
+        */
+        image_prefetcher(const std::vector<std::string>& files,
+                         std::size_t ahead = 2, std::size_t behind = 1, 
+                         std::size_t budget = 256 << 20);
+
+        /**
+           \brief create an image prefetcher that notifies an event queue
+
+           A user event is pushed to the event queue whenever an
+           image has been decoded.  Pass these events to update().
+
+           \param files the image files, positioned at the first
+           \param events the event queue to notify, e.g. window::events()
+           \param ahead the number of following images to keep
+           \param behind the number of preceding images to keep
+           \param budget the memory budget for decoded images in bytes
+        */
+        image_prefetcher(const std::vector<std::string>& files, event_queue& events,
+                         std::size_t ahead = 2, std::size_t behind = 1, 
+                         std::size_t budget = 256 << 20);
+
+        /**
+           \brief destroy an image prefetcher
+        */
+        ~image_prefetcher();
+
+        /**
+           \brief the number of image files
+        */
+        std::size_t size() const;
+
+        /**
+           \brief the index of the current image file
+        */
+        std::size_t index() const;
+
+        /**
+           \brief the name of the current image file
+        */
+        const std::string& filename() const;
+
+        /**
+           \brief move to the image file with the specified index
+        */
+        void seek(std::size_t index);
+
+        /**
+           \brief move to the next image file, wrapping around
+        */
+        void next();
+
+        /**
+           \brief move to the previous image file, wrapping around
+        */
+        void prev();
+
+        /**
+           \brief whether the current image has been decoded
+        */
+        bool ready();
+
+        /**
+           \brief the current image
+
+           Waits for the current image if it has not been decoded
+           yet; check ready() first to avoid blocking an event loop.
+           Throws an error if the image could not be loaded.
+        */
+        const image& current();
+
+        /**
+           \brief handle an event
+
+           \return whether the event signalled a decoded image
+        */
+        bool update(const event* e);
+
+        /**
+           \brief convert decoded images to the pixel format of a window
+        */
+        void optimize_for(const window& w);
+
+        /**
+           \brief the memory used by decoded images in bytes
+        */
+        std::size_t bytes() const;
+
+    private:
+        image_prefetcher(const image_prefetcher&);
+        image_prefetcher& operator=(const image_prefetcher&);
+
+    private:
+        struct impl;
+        impl* pimpl_;
+    };
+}
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef JACUI_SHARED_HPP
+#define JACUI_SHARED_HPP
+
+#include "canvas.hpp"
+
+namespace jacui {
+    /**
+       \brief jacui shared canvas class
+
+       A shared canvas lets one process draw frames which other
+       processes blit directly from shared memory, e.g. to composite
+       the output of a renderer running in a separate process.  The
+       canvas is created by name and holds two frames: the writer
+       draws onto the back frame and publishes it, readers always
+       blit the latest published frame.
+
+       A generation counter in the shared header tells readers when
+       a new frame has been published.  Drawing never waits for
+       readers; a reader which finds that the frame it was blitting
+       has been reused by the writer simply blits the latest frame
+       again, and gives up after a few attempts.
+    */
+    class shared_canvas {
+    public:
+        /**
+           \brief create a shared canvas for drawing
+
+           An existing shared canvas with the same name is reused and
+           reset, so it must no longer be mapped by any reader if its
+           size changes.
+
+           \param name the name of the shared memory object, which
+           should start with a slash, e.g. "/myapp-preview"
+           \param size the size of the frames
+           \param format the pixel format of the frames
+        */
+        shared_canvas(const char* name, const size2d& size, pixel_format format = rgb888);
+
+        /**
+           \brief open an existing shared canvas for reading
+
+           \param name the name of the shared memory object
+        */
+        explicit shared_canvas(const char* name);
+
+        /**
+           \brief close a shared canvas
+
+           The shared memory object itself remains until it is
+           removed, so readers can attach to it later on.
+        */
+        ~shared_canvas();
+
+        /**
+           \brief remove a shared memory object
+
+           Processes which have already opened the shared canvas can
+           continue to use it.
+        */
+        static void remove(const char* name);
+
+        /**
+           \brief whether the shared canvas has been created for drawing
+        */
+        bool writable() const;
+
+        /**
+           \brief the size of the frames
+        */
+        size2d size() const;
+
+        /**
+           \brief the width of the frames
+        */
+        std::size_t width() const;
+
+        /**
+           \brief the height of the frames
+        */
+        std::size_t height() const;
+
+        /**
+           \brief the pixel format of the frames
+        */
+        pixel_format format() const;
+
+        /**
+           \brief the frame being drawn
+
+           After a frame has been published, the back frame holds
+           the frame published before it, so every frame should be
+           drawn completely.  The frame must not be resized,
+           reserved or assigned, since its pixels would no longer be
+           in shared memory; publish() throws an error if they are
+           not.  Throws an error if the shared canvas has been
+           opened for reading.
+        */
+        canvas& view();
+
+        /**
+           \brief publish the frame being drawn
+
+           The frame becomes the latest frame blitted by readers,
+           and drawing continues on the other frame.  Throws an
+           error, restoring both frames, if the frame being drawn is
+           no longer in shared memory.
+        */
+        void publish();
+
+        /**
+           \brief the number of frames published so far
+        */
+        unsigned long generation() const;
+
+        /**
+           \brief blit the latest published frame at its original size
+
+           \param dst the surface to draw onto
+           \param p the position on the surface
+           \return false if no frame has been published yet, or if
+           new frames were published faster than they could be
+           blitted; dst may then show a partly drawn frame
+        */
+        bool draw(surface& dst, const point2d& p) const;
+
+        /**
+           \brief blit the latest published frame, scaled to a rectangle
+
+           \param dst the surface to draw onto
+           \param r the rectangle on the surface
+           \param f the filter used for scaling
+           \return false if no frame has been published yet, or if
+           new frames were published faster than they could be
+           blitted; dst may then show a partly drawn frame
+        */
+        bool draw(surface& dst, const rect2d& r, surface::scale_filter f = surface::nearest) const;
+
+    private:
+        shared_canvas(const shared_canvas&);
+        shared_canvas& operator=(const shared_canvas&);
+
+    private:
+        struct impl;
+        impl* pimpl_;
+    };
+}
+
+#endif
@@ -36,6 +36,130 @@ namespace jacui {
         struct surface_type;
     }
 
+    class surface;
+
+    /**
+       \brief direct access to the pixels of a surface
+
+       A pixel view keeps its surface locked while it exists, so its
+       pixels can be read and written through plain pointers.  Rows
+       are pitch() bytes apart, and each pixel has depth() bytes in
+       the surface's pixel format; use matches() to select code for
+       a known format, and map() to convert colors to pixel values
+       outside of inner loops.
+
+       The viewed area is marked as changed when the view is
+       destroyed, i.e. after its pixels have been written.  A pixel
+       view must not outlive its surface, and the surface should
+       neither be drawn onto by other means nor be copied while the
+       view exists, since copies share the pixels written through
+       the view.
+
+       \see surface::pixels
+    */
+    class pixel_view {
+    public:
+        /**
+           \brief a pixel value in the surface's pixel format
+        */
+        typedef unsigned long pixel_type;
+
+    public:
+        /**
+           \brief create another view of the same pixels
+        */
+        pixel_view(const pixel_view& rhs);
+
+        /**
+           \brief destroy a pixel view, unlocking its surface and
+           marking the viewed area as changed
+        */
+        ~pixel_view();
+
+        /**
+           \brief the size of the viewed area
+        */
+        size2d size() const { return area_.size(); }
+
+        /**
+           \brief the width of the viewed area
+        */
+        std::size_t width() const { return area_.width; }
+
+        /**
+           \brief the height of the viewed area
+        */
+        std::size_t height() const { return area_.height; }
+
+        /**
+           \brief the distance between rows in bytes
+        */
+        std::size_t pitch() const { return pitch_; }
+
+        /**
+           \brief the number of bytes per pixel
+        */
+        std::size_t depth() const { return depth_; }
+
+        /**
+           \brief whether the pixels are laid out like a pixel format
+
+           E.g. if matches(xrgb8888), pixels can be accessed as
+           32 bit integers with red in bits 16 to 23.
+        */
+        bool matches(pixel_format format) const;
+
+        /**
+           \brief the first pixel of a row of the viewed area
+        */
+        unsigned char* row(std::size_t y) const { return data_ + y * pitch_; }
+
+        /**
+           \brief the first pixel of a row of the viewed area, e.g.
+           row<Uint32>(y) for 32 bit pixels
+        */
+        template<class T> T* row(std::size_t y) const {
+            return reinterpret_cast<T*>(row(y));
+        }
+
+        /**
+           \brief the pixel value of a color
+        */
+        pixel_type map(const color& c) const;
+
+        /**
+           \brief the color of a pixel value
+        */
+        color unmap(pixel_type p) const;
+
+        /**
+           \brief swap two pixel views
+        */
+        void swap(pixel_view& rhs);
+
+        /**
+           \brief make this a view of another view's pixels
+        */
+        pixel_view& operator=(const pixel_view& rhs) {
+            pixel_view tmp(rhs);
+            swap(tmp);
+            return *this;
+        }
+
+    private:
+        friend class surface;
+
+        pixel_view(surface* owner, detail::surface_type* s, const rect2d& r);
+
+    private:
+        surface* owner_;
+        detail::surface_type* surface_;
+        unsigned char* data_;
+        std::size_t pitch_;
+        std::size_t depth_;
+        rect2d area_;
+    };
+
     /**
        \brief jacui surface class
 
@@ -45,6 +169,17 @@ namespace jacui {
        (window::view).
     */
     class surface {
+    public:
+        /**
+           \brief filter used for scaled blits
+        */
+        enum scale_filter {
+            nearest,  // nearest neighbour, fastest
+            bilinear, // bilinear interpolation
+            box,      // area averaging, for downscaling
+            lanczos   // Lanczos-3, sharpest
+        };
+
     public:
         /**
            \brief destroy a surface
@@ -107,6 +242,13 @@ namespace jacui {
             blit(s, s.size(), dst);
         }
 
+        /**
+           \brief blit the pixels of another surface to this surface
+        */
+        void blit(const surface& s, const rect2d& dst, scale_filter f) {
+            blit(s, s.size(), dst, f);
+        }
+
         /**
            \brief blit the pixels of another surface to this surface
         */
@@ -124,7 +266,17 @@ namespace jacui {
         /**
            \brief blit the pixels of another surface to this surface
         */
-        void blit(const surface& s, const rect2d& src, const rect2d& dst);
+        void blit(const surface& s, const rect2d& src, const rect2d& dst) {
+            blit(s, src, dst, nearest);
+        }
+
+        /**
+           \brief blit the pixels of another surface to this surface
+
+           If the source and destination rectangles differ in size,
+           the pixels are scaled using the specified filter.
+        */
+        void blit(const surface& s, const rect2d& src, const rect2d& dst, scale_filter f);
 
         /**
            \brief blit the pixels of another surface to this surface
@@ -136,12 +288,90 @@ namespace jacui {
         */
         void blit(const surface& s, const rect2d& src, int x, int y);
 
+        /**
+           \brief direct access to the surface's pixels
+
+           The whole surface is marked as changed when the view is
+           destroyed.
+        */
+        pixel_view pixels();
+
+        /**
+           \brief direct access to an area of the surface's pixels
+
+           The area is clipped to the surface and marked as changed
+           when the view is destroyed; row 0 of the view starts at
+           the area's top left pixel.
+
+           \param r the area to access
+        */
+        pixel_view pixels(const rect2d& r);
+
+        /**
+           \brief save the surface's pixels to a binary PPM file
+        */
+        void save_ppm(const char* filename) const;
+
+        /**
+           \brief save the surface's pixels to a 24 bit BMP file
+        */
+        void save_bmp(const char* filename) const;
+
+        /**
+           \brief save the surface's pixels to a PNG file
+
+           Surfaces with an alpha channel are saved with alpha.  The
+           rows are filtered and compressed in blocks, which are
+           processed in parallel.
+
+           \param filename the file to write
+           \param level the compression level, from 0 (fastest) to
+           9 (smallest file)
+        */
+        void save_png(const char* filename, int level = 6) const;
+
+        /**
+           \brief mark an area of the surface as changed
+
+           This is called by all drawing operations.  The default
+           implementation does nothing.
+
+           \param r the area that has changed, clipped to the surface
+        */
+        virtual void damage(const rect2d& r);
+
     public:
         /**
            \brief implementation detail
         */
         virtual detail::surface_type* detail() const = 0;
+
+        /**
+           \brief implementation detail
+
+           The surface to draw onto, which is no longer shared with
+           copies of this surface.  The default implementation
+           returns detail().
+        */
+        virtual detail::surface_type* unshare();
     };
+
+    /**
+       \brief the number of threads used for pixel operations
+
+       Scaled and format-converting blits and large fills are split
+       into horizontal bands which are processed in parallel.  The
+       result is the same regardless of the number of threads.
+    */
+    std::size_t concurrency();
+
+    /**
+       \brief set the number of threads used for pixel operations
+
+       \param n the number of threads, or 0 for the number of
+       processors; 1 disables parallel processing
+    */
+    void concurrency(std::size_t n);
 }
 
 #endif
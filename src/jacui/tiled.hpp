@@ -0,0 +1,178 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef JACUI_TILED_HPP
+#define JACUI_TILED_HPP
+
+#include "cache.hpp"
+
+namespace jacui {
+    /**
+       \brief jacui tiled image class
+
+       A tiled image draws views of image files too large to decode
+       at once.  The image is split into square tiles, which are read
+       when a draw first touches them; uncompressed PNM, BMP and TGA
+       files are mapped into memory and only the pages of touched
+       tiles are read.  Other image files are decoded once when
+       loaded.
+
+       Zoomed out views are drawn from a pyramid of images with half
+       the width and height of the level below, whose tiles are
+       computed from the level below when first needed.  Least
+       recently used tiles of all levels are evicted when the cached
+       tiles exceed a memory budget.
+    */
+    class tiled_image {
+    public:
+        /**
+           \brief tile cache statistics
+        */
+        typedef image_cache::cache_stats cache_stats;
+
+    public:
+        /**
+           \brief create an empty tiled image
+
+           \param tile_size the width and height of tiles in pixels
+           \param budget the memory budget for cached tiles in bytes
+        */
+        explicit tiled_image(std::size_t tile_size = 256, std::size_t budget = 64 << 20);
+
+        /**
+           \brief create a tiled image from an image file
+
+           \param filename the file to load
+           \param tile_size the width and height of tiles in pixels
+           \param budget the memory budget for cached tiles in bytes
+        */
+        explicit tiled_image(const char* filename, std::size_t tile_size = 256,
+                             std::size_t budget = 64 << 20);
+
+        /**
+           \brief destroy a tiled image
+        */
+        ~tiled_image();
+
+        /**
+           \brief load an image file
+
+           Throws an error if the image could not be loaded.
+        */
+        void load(const char* filename);
+
+        /**
+           \brief whether an image has been loaded
+        */
+        bool empty() const;
+
+        /**
+           \brief the size of the image
+        */
+        size2d size() const;
+
+        /**
+           \brief the width of the image
+        */
+        std::size_t width() const;
+
+        /**
+           \brief the height of the image
+        */
+        std::size_t height() const;
+
+        /**
+           \brief the width and height of tiles in pixels
+        */
+        std::size_t tile_size() const;
+
+        /**
+           \brief the number of pyramid levels
+
+           Level 0 is the image itself, the top level fits into a
+           single tile.
+        */
+        std::size_t levels() const;
+
+        /**
+           \brief draw an area of the image at its original size
+
+           \param dst the surface to draw onto
+           \param src the area of the image to draw
+           \param p the position on the surface
+        */
+        void draw(surface& dst, const rect2d& src, const point2d& p) const;
+
+        /**
+           \brief draw an area of the image, scaled to a rectangle
+
+           The area is read from the smallest pyramid level that
+           still has at least the resolution of the rectangle.
+
+           \param dst the surface to draw onto
+           \param src the area of the image to draw
+           \param r the rectangle on the surface
+           \param f the filter used for scaling
+        */
+        void draw(surface& dst, const rect2d& src, const rect2d& r,
+                  surface::scale_filter f = surface::nearest) const;
+
+        /**
+           \brief the memory budget for cached tiles in bytes
+        */
+        std::size_t budget() const;
+
+        /**
+           \brief set the memory budget for cached tiles in bytes
+
+           Least recently used tiles are evicted until the cached
+           tiles fit the new budget.
+        */
+        void budget(std::size_t bytes);
+
+        /**
+           \brief remove all tiles from the cache
+        */
+        void clear();
+
+        /**
+           \brief tile cache statistics
+        */
+        cache_stats stats() const;
+
+    private:
+        tiled_image(const tiled_image&);
+        tiled_image& operator=(const tiled_image&);
+
+    private:
+        struct impl;
+        impl* pimpl_;
+    };
+}
+
+#endif
@@ -30,6 +30,19 @@
 #define JACUI_TYPES_HPP
 
 #include <cstddef>
+#include <vector>
+
+/**
+   \brief defined if the compiler supports rvalue references
+
+   Handle classes then have move constructors and move assignment
+   operators, which never copy pixels.  Define JACUI_NO_RVALUE_REFERENCES
+   to disable them.
+*/
+#if !defined(JACUI_NO_RVALUE_REFERENCES) && \
+    (__cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900))
+#define JACUI_HAS_RVALUE_REFERENCES
+#endif
 
 /**
    \brief jacui namespace
@@ -227,6 +240,89 @@ namespace jacui {
             || lhs.height != rhs.height;
     }
 
+    /**
+       \brief jacui region type
+
+       A region is a small set of rectangles covering an area of a
+       surface.  Overlapping or nearby rectangles are merged, so the
+       region may cover somewhat more than the rectangles added to it.
+    */
+    class region {
+    public:
+        /**
+           \brief region iterator type
+        */
+        typedef std::vector<rect2d>::const_iterator const_iterator;
+
+        /**
+           \brief the maximum number of rectangles in a region
+        */
+        enum { max_size = 16 };
+
+    public:
+        /**
+           \brief create an empty region
+        */
+        region() { }
+
+        /**
+           \brief create a region from a rectangle
+        */
+        region(const rect2d& r) { add(r); }
+
+        /**
+           \brief whether the region is empty
+        */
+        bool empty() const { return rects_.empty(); }
+
+        /**
+           \brief the number of rectangles in the region
+        */
+        std::size_t size() const { return rects_.size(); }
+
+        /**
+           \brief the first rectangle of the region
+        */
+        const_iterator begin() const { return rects_.begin(); }
+
+        /**
+           \brief the end of the region's rectangles
+        */
+        const_iterator end() const { return rects_.end(); }
+
+        /**
+           \brief the smallest rectangle containing the region
+        */
+        rect2d bounds() const;
+
+        /**
+           \brief add a rectangle to the region
+        */
+        void add(const rect2d& r);
+
+        /**
+           \brief add another region to the region
+        */
+        void add(const region& r);
+
+        /**
+           \brief remove all rectangles from the region
+        */
+        void clear() { rects_.clear(); }
+
+    private:
+        std::vector<rect2d> rects_;
+    };
+
+    /**
+       \brief jacui pixel format type
+    */
+    enum pixel_format {
+        rgb888,   // 24 bit RGB
+        xrgb8888, // 32 bit RGB, high byte unused
+        argb8888  // 32 bit RGB with alpha channel
+    };
+
     /**
        \brief jacui color type
     */
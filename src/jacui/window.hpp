@@ -77,6 +77,22 @@ namespace jacui {
         */
         window(const std::string& caption, std::size_t width, std::size_t height, flags_type f = 0);
 
+        /**
+           \brief create a window with a specified caption and pixel format
+        */
+        window(const std::string& caption, pixel_format format, flags_type f = 0);
+
+        /**
+           \brief create a window with a specified caption, size and pixel format
+        */
+        window(const std::string& caption, const size2d& size, pixel_format format, flags_type f = 0);
+
+        /**
+           \brief create a window with a specified caption, size and pixel format
+        */
+        window(const std::string& caption, std::size_t width, std::size_t height, 
+               pixel_format format, flags_type f = 0);
+
         /**
            \brief destroy a window
         */
@@ -147,11 +163,26 @@ namespace jacui {
         */
         void resize(std::size_t width, std::size_t height);
 
+        /**
+           \brief the areas of the window's view drawn to since the last update
+        */
+        const region& damaged() const;
+
         /**
            \brief update a window
+
+           Only the areas of the window's view that have been drawn to
+           since the last update are presented.
         */
         void update();
 
+        /**
+           \brief update specified areas of a window
+
+           \param r the areas of the window's view to present
+        */
+        void update(const region& r);
+
         /**
            \brief close a window
         */
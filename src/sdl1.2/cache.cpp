@@ -0,0 +1,259 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "jacui/cache.hpp"
+#include "detail.hpp"
+
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace {
+    // keep the pixel format of the image file
+    const int native_format = -1;
+
+    struct cache_key {
+        cache_key(const char* filename, const jacui::size2d& size, int format)
+            : filename(filename), width(size.width), height(size.height), format(format)
+        {
+        }
+
+        bool operator<(const cache_key& rhs) const
+        {
+            if (filename != rhs.filename)
+                return filename < rhs.filename;
+            if (width != rhs.width)
+                return width < rhs.width;
+            if (height != rhs.height)
+                return height < rhs.height;
+            return format < rhs.format;
+        }
+
+        std::string filename;
+        std::size_t width;
+        std::size_t height;
+        int format;
+    };
+
+    // modification time of a file, or -1 if it cannot be determined
+    std::time_t modified(const char* filename)
+    {
+        struct stat st;
+        return stat(filename, &st) == 0 ? st.st_mtime : std::time_t(-1);
+    }
+
+    std::size_t image_bytes(const jacui::image& img)
+    {
+        SDL_Surface* s = img.detail();
+        return s ? std::size_t(s->h) * s->pitch : 0;
+    }
+
+    void load(const cache_key& key, jacui::image& res)
+    {
+        jacui::image img(key.filename.c_str(), jacui::size2d(key.width, key.height));
+
+        if (key.format == native_format) {
+            res.swap(img);
+            return;
+        }
+
+        jacui::pixel_format format = jacui::pixel_format(key.format);
+        jacui::image tmp(jacui::detail::convert_surface(img.detail(), format));
+        res.swap(tmp);
+    }
+}
+
+namespace jacui {
+    struct image_cache::impl {
+        struct entry {
+            entry(const cache_key& key, std::time_t mtime, std::size_t bytes)
+                : key(key), mtime(mtime), bytes(bytes)
+            {
+            }
+
+            cache_key key;
+            std::time_t mtime;
+            std::size_t bytes;
+            image img;
+        };
+
+        typedef std::list<entry> list_type;
+
+        typedef std::map<cache_key, list_type::iterator> map_type;
+
+        impl(std::size_t budget) : mutex(SDL_CreateMutex()), budget(budget)
+        {
+            if (!mutex)
+                detail::throw_error("error creating image cache");
+            stats.hits = stats.misses = stats.evictions = stats.entries = stats.bytes = 0;
+        }
+
+        ~impl()
+        {
+            SDL_DestroyMutex(mutex);
+        }
+
+        image get(const cache_key& key)
+        {
+            std::time_t mtime = modified(key.filename.c_str());
+
+            // images are released after the lock, see erase()
+            list_type dropped;
+            {
+                detail::mutex_lock lock(mutex);
+                map_type::iterator i = index.find(key);
+
+                if (i != index.end()) {
+                    if (i->second->mtime == mtime) {
+                        ++stats.hits;
+                        entries.splice(entries.begin(), entries, i->second);
+                        return image(detail::share_surface(i->second->img.detail()));
+                    }
+                    erase(i, dropped);
+                }
+                ++stats.misses;
+            }
+
+            // decode without holding the lock, so other threads can
+            // retrieve cached images meanwhile
+            image img;
+            load(key, img);
+            std::size_t bytes = image_bytes(img);
+
+            detail::mutex_lock lock(mutex);
+            map_type::iterator i = index.find(key);
+            if (i != index.end())
+                erase(i, dropped); // loaded by another thread meanwhile
+            if (bytes > budget)
+                return image(detail::share_surface(img.detail()));
+
+            entries.push_front(entry(key, mtime, bytes));
+            entries.front().img.swap(img);
+            index[key] = entries.begin();
+            ++stats.entries;
+            stats.bytes += bytes;
+            evict(budget, dropped);
+            return image(detail::share_surface(entries.front().img.detail()));
+        }
+
+        // move an entry to a list that is destroyed after the lock
+        // is released, so freeing its pixels does not block others
+        void erase(map_type::iterator i, list_type& dropped)
+        {
+            --stats.entries;
+            stats.bytes -= i->second->bytes;
+            dropped.splice(dropped.end(), entries, i->second);
+            index.erase(i);
+        }
+
+        // evict least recently used images until the cache fits a budget
+        void evict(std::size_t bytes, list_type& dropped)
+        {
+            while (stats.bytes > bytes && !entries.empty()) {
+                erase(index.find(entries.back().key), dropped);
+                ++stats.evictions;
+            }
+        }
+
+        SDL_mutex* mutex;
+        std::size_t budget;
+        cache_stats stats;
+        list_type entries; // most recently used first
+        map_type index;
+    };
+
+    image_cache::image_cache(std::size_t budget)
+        : pimpl_(new impl(budget))
+    {
+    }
+
+    image_cache::~image_cache()
+    {
+        delete pimpl_;
+    }
+
+    image_cache& image_cache::instance()
+    {
+        static image_cache cache;
+        return cache;
+    }
+
+    image image_cache::get(const char* filename)
+    {
+        return pimpl_->get(cache_key(filename, size2d(), native_format));
+    }
+
+    image image_cache::get(const char* filename, const size2d& size)
+    {
+        return pimpl_->get(cache_key(filename, size, native_format));
+    }
+
+    image image_cache::get(const char* filename, pixel_format format)
+    {
+        return pimpl_->get(cache_key(filename, size2d(), format));
+    }
+
+    image image_cache::get(const char* filename, const size2d& size, pixel_format format)
+    {
+        return pimpl_->get(cache_key(filename, size, format));
+    }
+
+    std::size_t image_cache::budget() const
+    {
+        detail::mutex_lock lock(pimpl_->mutex);
+        return pimpl_->budget;
+    }
+
+    void image_cache::budget(std::size_t bytes)
+    {
+        impl::list_type dropped;
+        detail::mutex_lock lock(pimpl_->mutex);
+        pimpl_->budget = bytes;
+        pimpl_->evict(bytes, dropped);
+    }
+
+    void image_cache::clear()
+    {
+        impl::list_type dropped;
+        detail::mutex_lock lock(pimpl_->mutex);
+        dropped.swap(pimpl_->entries);
+        pimpl_->index.clear();
+        pimpl_->stats.entries = 0;
+        pimpl_->stats.bytes = 0;
+    }
+
+    image_cache::cache_stats image_cache::stats() const
+    {
+        detail::mutex_lock lock(pimpl_->mutex);
+        return pimpl_->stats;
+    }
+}
@@ -29,13 +29,55 @@
 #include "jacui/canvas.hpp"
 #include "detail.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 namespace {
-    jacui::detail::surface_type* make_surface(std::size_t width, std::size_t height)
+    // the pixel format of a surface, if it is one of jacui's
+    bool canvas_format(const SDL_Surface* s, jacui::pixel_format& format)
+    {
+        const SDL_PixelFormat* f = s->format;
+        if (f->palette || f->Rmask != 0x00ff0000 || f->Gmask != 0x0000ff00 || f->Bmask != 0x000000ff)
+            return false;
+
+        if (f->BytesPerPixel == 3)
+            format = jacui::rgb888;
+        else if (f->BytesPerPixel == 4)
+            format = f->Amask ? jacui::argb8888 : jacui::xrgb8888;
+        else
+            return false;
+        return !f->Amask || f->Amask == 0xff000000;
+    }
+
+    jacui::detail::surface_type* make_surface(const jacui::size2d& size, const jacui::size2d& capacity,
+                                              const SDL_Surface* s)
     {
+        jacui::pixel_format format = jacui::rgb888;
+        if (!s || canvas_format(s, format))
+            return jacui::detail::acquire_surface(size, capacity, format);
+
+        const SDL_PixelFormat* f = s->format;
         return jacui::detail::make_surface(
-            SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 24, 0, 0, 0, 0)
+            SDL_CreateRGBSurface(SDL_SWSURFACE, size.width, size.height, f->BitsPerPixel,
+                                 f->Rmask, f->Gmask, f->Bmask, f->Amask)
             );
     }
+
+    // same pixel format: copy rows, do not blend them
+    void copy_rows(SDL_Surface* src, SDL_Surface* dst)
+    {
+        jacui::detail::surface_lock srclock(src);
+        jacui::detail::surface_lock dstlock(dst);
+
+        const Uint8* from = static_cast<const Uint8*>(src->pixels);
+        Uint8* to = static_cast<Uint8*>(dst->pixels);
+        std::size_t n = std::min(dst->w, src->w) * src->format->BytesPerPixel;
+        std::size_t h = std::min(dst->h, src->h);
+
+        for (std::size_t y = 0; y != h; ++y) {
+            std::memcpy(to + y * dst->pitch, from + y * src->pitch, n);
+        }
+    }
 }
 
 namespace jacui {
@@ -50,38 +92,97 @@ namespace jacui {
     }
 
     canvas::canvas(const canvas& rhs) 
-        : pimpl_(impl::make_impl(detail::copy_surface(rhs.pimpl_)))
+        : pimpl_(impl::make_impl(detail::lazy_copy(rhs.pimpl_)))
     {
     }
 
     canvas::canvas(const size2d& size) 
-        : pimpl_(impl::make_impl(make_surface(size.width, size.height)))
+        : pimpl_(impl::make_impl(detail::acquire_surface(size, size2d(), rgb888)))
     {
     }
 
     canvas::canvas(std::size_t width, std::size_t height) 
-        : pimpl_(impl::make_impl(make_surface(width, height)))
+        : pimpl_(impl::make_impl(detail::acquire_surface(size2d(width, height), size2d(), rgb888)))
+    {
+    }
+
+    canvas::canvas(const size2d& size, pixel_format format)
+        : pimpl_(impl::make_impl(detail::acquire_surface(size, size2d(), format)))
+    {
+    }
+
+    canvas::canvas(std::size_t width, std::size_t height, pixel_format format)
+        : pimpl_(impl::make_impl(detail::acquire_surface(size2d(width, height), size2d(), format)))
+    {
+    }
+
+    canvas::canvas(void* pixels, const size2d& size, std::size_t pitch, pixel_format format,
+                   release_function release, void* context)
+        : pimpl_(0)
+    {
+        detail::shared_data data(pixels, pitch * size.height, release, context);
+        std::size_t row = size.width * (format == rgb888 ? 3 : 4);
+
+        if (!pixels || pitch < row || pitch > 0xffff)
+            throw error("invalid pixel buffer");
+
+        canvas tmp(detail::make_surface(pixels, size.width, size.height, pitch, format));
+        if (release)
+            detail::attach_data(tmp.pimpl_, data);
+        swap(tmp);
+    }
+
+    canvas::canvas(detail::surface_type* p)
+        : pimpl_(impl::make_impl(p))
     {
     }
 
     canvas::~canvas()
     {
         if (pimpl_) {
-            SDL_FreeSurface(pimpl_);
+            detail::free_surface(pimpl_);
         }
     }
 
     void canvas::resize(const size2d& size)
     {
-        canvas tmp(size);
-        tmp.blit(*this);
-        swap(tmp);
+        resize(size.width, size.height);
     }
 
     void canvas::resize(std::size_t width, std::size_t height)
     {
-        canvas tmp(width, height);
-        tmp.blit(*this);
+        const size2d size(width, height);
+
+        // within capacity, only the visible size changes
+        if (pimpl_ && detail::resize_surface(pimpl_, size))
+            return;
+
+        const size2d old = capacity();
+        canvas tmp;
+        tmp.pimpl_ = impl::make_impl(make_surface(size, size2d(std::max(old.width, width),
+                                                               std::max(old.height, height)), pimpl_));
+        if (pimpl_)
+            copy_rows(pimpl_, tmp.pimpl_);
+        swap(tmp);
+    }
+
+    size2d canvas::capacity() const
+    {
+        return pimpl_ ? detail::surface_capacity(pimpl_) : size2d();
+    }
+
+    void canvas::reserve(const size2d& size)
+    {
+        const size2d old = capacity();
+        if (size.width <= old.width && size.height <= old.height)
+            return;
+
+        canvas tmp;
+        tmp.pimpl_ = impl::make_impl(make_surface(this->size(), size2d(std::max(old.width, size.width),
+                                                                      std::max(old.height, size.height)),
+                                                  pimpl_));
+        if (pimpl_)
+            copy_rows(pimpl_, tmp.pimpl_);
         swap(tmp);
     }
 
@@ -94,4 +195,11 @@ namespace jacui {
     {
         return pimpl_;
     }
+
+    detail::surface_type* canvas::unshare()
+    {
+        if (pimpl_)
+            pimpl_ = impl::make_impl(detail::unshare_surface(pimpl_));
+        return pimpl_;
+    }
 }
@@ -59,6 +59,11 @@ namespace jacui {
     {
     }
 
+    cursor::cursor(const cursor& rhs)
+        : pimpl_(rhs.pimpl_)
+    {
+    }
+
     cursor::~cursor()
     {
         // cursor are deliberatly never freed
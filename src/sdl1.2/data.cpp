@@ -0,0 +1,323 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "detail.hpp"
+
+#include <SDL_thread.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace jacui::detail;
+
+namespace {
+    // identifies a file and its version, whatever name it is opened by
+    struct file_key {
+        file_key() : device(0), inode(0), size(0), mtime(0) { }
+
+        Uint64 device;
+        Uint64 inode;
+        Uint64 size;
+        Uint64 mtime;
+    };
+
+    inline bool operator<(const file_key& lhs, const file_key& rhs)
+    {
+        if (lhs.device != rhs.device)
+            return lhs.device < rhs.device;
+        if (lhs.inode != rhs.inode)
+            return lhs.inode < rhs.inode;
+        if (lhs.size != rhs.size)
+            return lhs.size < rhs.size;
+        return lhs.mtime < rhs.mtime;
+    }
+
+    typedef std::map<file_key, shared_data::block*> registry_type;
+
+    // guards reference counts and the registry of mapped files
+    SDL_mutex* get_mutex()
+    {
+        static SDL_mutex* mutex = SDL_CreateMutex();
+        return mutex;
+    }
+
+    // create the mutex during static initialization, before any
+    // thread can race for it
+    SDL_mutex* const init_mutex = get_mutex();
+
+    registry_type& get_registry()
+    {
+        static registry_type registry;
+        return registry;
+    }
+
+    void throw_file_error(const char* msg, const char* filename)
+    {
+#ifdef WIN32
+        SDL_SetError("%s: error %lu", filename, GetLastError());
+#else
+        SDL_SetError("%s: %s", filename, std::strerror(errno));
+#endif
+        throw_error(msg);
+    }
+}
+
+namespace jacui {
+    namespace detail {
+        struct shared_data::block {
+            block() : data(0), size(0), count(1), mapped(false), external(false), registered(false),
+                      release(0), context(0) { }
+
+            ~block()
+            {
+                if (external) {
+                    if (release)
+                        release(const_cast<char*>(data), context);
+                } else if (mapped) {
+#ifdef WIN32
+                    UnmapViewOfFile(data);
+#else
+                    munmap(const_cast<char*>(data), size);
+#endif
+                } else {
+                    delete[] data;
+                }
+            }
+
+            const char* data;
+            std::size_t size;
+            std::size_t count;
+            bool mapped;
+            bool external;
+            bool registered;
+            release_function release;
+            void* context;
+            file_key key;
+        };
+
+        shared_data::shared_data() : block_(0)
+        {
+        }
+
+        shared_data::shared_data(const void* data, std::size_t size)
+            : block_(new block())
+        {
+            char* p = new char[size];
+            std::memcpy(p, data, size);
+            block_->data = p;
+            block_->size = size;
+        }
+
+        shared_data::shared_data(const void* data, std::size_t size,
+                                 release_function release, void* context)
+            : block_(0)
+        {
+            try {
+                block_ = new block();
+            } catch (...) {
+                if (release)
+                    release(const_cast<void*>(data), context);
+                throw;
+            }
+            block_->data = static_cast<const char*>(data);
+            block_->size = size;
+            block_->external = true;
+            block_->release = release;
+            block_->context = context;
+        }
+
+        shared_data::shared_data(const shared_data& rhs) : block_(rhs.block_)
+        {
+            if (block_) {
+                mutex_lock lock(get_mutex());
+                ++block_->count;
+            }
+        }
+
+        shared_data::~shared_data()
+        {
+            block* p = 0;
+            if (block_) {
+                mutex_lock lock(get_mutex());
+                if (--block_->count == 0) {
+                    if (block_->registered)
+                        get_registry().erase(block_->key);
+                    p = block_;
+                }
+            }
+            // unmap or release without holding the lock
+            delete p;
+        }
+
+        shared_data shared_data::map(const char* filename, bool copy_on_write)
+        {
+            // allocated up front, so nothing leaks if mapping throws
+            shared_data res;
+            res.block_ = new block();
+
+            file_key key;
+            block* shared = 0;
+            const char* data = 0;
+            std::size_t size = 0;
+
+            // files are opened and mapped without holding the lock; the
+            // registry is keyed by file identity and version, not name
+#ifdef WIN32
+            HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, 
+                                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+            if (file == INVALID_HANDLE_VALUE)
+                throw_file_error("error opening file", filename);
+            BY_HANDLE_FILE_INFORMATION info;
+            if (GetFileInformationByHandle(file, &info)) {
+                key.device = info.dwVolumeSerialNumber;
+                key.inode = Uint64(info.nFileIndexHigh) << 32 | info.nFileIndexLow;
+                key.size = Uint64(info.nFileSizeHigh) << 32 | info.nFileSizeLow;
+                key.mtime = Uint64(info.ftLastWriteTime.dwHighDateTime) << 32 
+                    | info.ftLastWriteTime.dwLowDateTime;
+                if (!copy_on_write) {
+                    mutex_lock lock(get_mutex());
+                    registry_type::iterator i = get_registry().find(key);
+                    if (i != get_registry().end()) {
+                        shared = i->second;
+                        ++shared->count;
+                    }
+                }
+                if (!shared && key.size) {
+                    HANDLE mapping = CreateFileMapping(file, 0, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY,
+                                                       0, 0, 0);
+                    if (mapping) {
+                        DWORD access = copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ;
+                        data = static_cast<const char*>(MapViewOfFile(mapping, access, 0, 0, 0));
+                        size = std::size_t(key.size);
+                        CloseHandle(mapping);
+                    }
+                }
+            }
+            CloseHandle(file);
+            if (!data && !shared)
+                throw_file_error("error mapping file", filename);
+#else
+            int fd = open(filename, O_RDONLY);
+            if (fd < 0)
+                throw_file_error("error opening file", filename);
+            struct stat st;
+            void* addr = MAP_FAILED;
+            if (fstat(fd, &st) == 0) {
+                key.device = st.st_dev;
+                key.inode = st.st_ino;
+                key.size = st.st_size;
+                key.mtime = st.st_mtime;
+                if (!copy_on_write) {
+                    mutex_lock lock(get_mutex());
+                    registry_type::iterator i = get_registry().find(key);
+                    if (i != get_registry().end()) {
+                        shared = i->second;
+                        ++shared->count;
+                    }
+                }
+                if (!shared && st.st_size > 0) {
+                    int prot = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+                    addr = mmap(0, st.st_size, prot, MAP_PRIVATE, fd, 0);
+                } else if (!shared) {
+                    errno = EINVAL; // cannot map an empty file
+                }
+            }
+            int err = errno;
+            close(fd);
+            if (addr == MAP_FAILED && !shared) {
+                errno = err;
+                throw_file_error("error mapping file", filename);
+            }
+            if (!shared) {
+                data = static_cast<const char*>(addr);
+                size = st.st_size;
+            }
+#endif
+
+            if (!shared) {
+                res.block_->data = data;
+                res.block_->size = size;
+                res.block_->mapped = true;
+            }
+
+            if (!shared && !copy_on_write) {
+                // unless another thread has mapped the file meanwhile
+                mutex_lock lock(get_mutex());
+                registry_type::iterator i = get_registry().find(key);
+                if (i == get_registry().end()) {
+                    res.block_->key = key;
+                    res.block_->registered = true;
+                    get_registry()[key] = res.block_;
+                } else {
+                    shared = i->second;
+                    ++shared->count;
+                }
+            }
+
+            if (shared) {
+                // drops the unused block or mapping, without the lock
+                shared_data tmp;
+                tmp.block_ = shared;
+                res.swap(tmp);
+            }
+            return res;
+        }
+
+        void throw_io_error(const char* msg, const char* filename)
+        {
+            SDL_SetError("%s: %s", filename, std::strerror(errno));
+            throw_error(msg);
+        }
+
+        const void* shared_data::data() const
+        {
+            return block_ ? block_->data : 0;
+        }
+
+        std::size_t shared_data::size() const
+        {
+            return block_ ? block_->size : 0;
+        }
+
+        void shared_data::swap(shared_data& rhs)
+        {
+            std::swap(block_, rhs.block_);
+        }
+    }
+}
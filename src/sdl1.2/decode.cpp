@@ -0,0 +1,391 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "jacui/image.hpp"
+#include "detail.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include <SDL_image.h>
+
+#ifdef JACUI_HAVE_LIBPNG
+#include <png.h> // older versions must be included before setjmp.h
+#endif
+
+#ifdef JACUI_HAVE_LIBJPEG
+#include <csetjmp>
+extern "C" {
+#include <jpeglib.h>
+}
+#endif
+
+namespace {
+    jacui::pixel_format native(const SDL_Surface* s)
+    {
+        if (s->format->Amask)
+            return jacui::argb8888;
+        else if (s->format->BytesPerPixel == 4)
+            return jacui::xrgb8888;
+        else
+            return jacui::rgb888;
+    }
+
+#if defined(JACUI_HAVE_LIBJPEG) || defined(JACUI_HAVE_LIBPNG)
+    // surface with RGB or RGBA bytes in memory order, as decoded
+    SDL_Surface* make_rgb_surface(std::size_t width, std::size_t height, bool alpha)
+    {
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+        if (alpha) {
+            return SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 32,
+                                        0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000);
+        } else {
+            return SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 24,
+                                        0x0000ff, 0x00ff00, 0xff0000, 0);
+        }
+#else
+        if (alpha) {
+            return SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 32,
+                                        0xff000000, 0x00ff0000, 0x0000ff00, 0x000000ff);
+        } else {
+            return SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 24,
+                                        0xff0000, 0x00ff00, 0x0000ff, 0);
+        }
+#endif
+    }
+
+    // area averages decoded rows of gray, RGB or RGBA bytes into a
+    // smaller RGB or RGBA surface, one row at a time, so the image
+    // never has to be held at full size
+    class row_scaler {
+    public:
+        row_scaler(SDL_Surface* dst, std::size_t width, std::size_t height, int channels)
+            : dst_(dst), height_(height), channels_(channels), 
+              dstchannels_(dst->format->BytesPerPixel), y_(0), rows_(0),
+              row_(width * channels), xmap_(width), xcount_(dst->w), 
+              sums_(dst->w * dstchannels_)
+        {
+            for (std::size_t x = 0; x != width; ++x) {
+                xmap_[x] = x * dst->w / width;
+                ++xcount_[xmap_[x]];
+            }
+        }
+
+        // buffer for the next decoded row
+        Uint8* row()
+        {
+            return &row_[0];
+        }
+
+        // add the decoded row to the current destination row
+        void push()
+        {
+            const Uint8* p = &row_[0];
+
+            for (std::size_t x = 0; x != xmap_.size(); ++x, p += channels_) {
+                double* s = &sums_[xmap_[x] * dstchannels_];
+
+                if (channels_ == 4) {
+                    // weight colors by alpha, so transparent pixels do not bleed
+                    double a = p[3];
+                    s[0] += p[0] * a;
+                    s[1] += p[1] * a;
+                    s[2] += p[2] * a;
+                    s[3] += a;
+                } else if (channels_ == 3) {
+                    s[0] += p[0];
+                    s[1] += p[1];
+                    s[2] += p[2];
+                } else {
+                    s[0] += p[0];
+                    s[1] += p[0];
+                    s[2] += p[0];
+                }
+            }
+            ++rows_;
+
+            std::size_t y = y_++ * dst_->h / height_;
+            if (y_ == height_ || y_ * dst_->h / height_ != y)
+                flush(y);
+        }
+
+    private:
+        void flush(std::size_t y)
+        {
+            Uint8* d = static_cast<Uint8*>(dst_->pixels) + y * dst_->pitch;
+            double* s = &sums_[0];
+
+            for (std::size_t x = 0; x != xcount_.size(); ++x) {
+                double n = double(xcount_[x]) * rows_;
+
+                if (dstchannels_ == 4) {
+                    double a = s[3];
+                    for (int c = 0; c != 3; ++c)
+                        *d++ = a ? Uint8(s[c] / a + 0.5) : 0;
+                    *d++ = Uint8(a / n + 0.5);
+                } else {
+                    for (int c = 0; c != 3; ++c)
+                        *d++ = Uint8(s[c] / n + 0.5);
+                }
+                s += dstchannels_;
+            }
+
+            std::fill(sums_.begin(), sums_.end(), 0.0);
+            rows_ = 0;
+        }
+
+    private:
+        SDL_Surface* dst_;
+        std::size_t height_;
+        int channels_;
+        int dstchannels_;
+        std::size_t y_;
+        std::size_t rows_;
+        std::vector<Uint8> row_;
+        std::vector<std::size_t> xmap_;
+        std::vector<std::size_t> xcount_;
+        std::vector<double> sums_;
+    };
+#endif
+
+#ifdef JACUI_HAVE_LIBJPEG
+    struct jpeg_error: public jpeg_error_mgr {
+        std::jmp_buf jump;
+    };
+
+    void jpeg_error_exit(j_common_ptr cinfo)
+    {
+        std::longjmp(static_cast<jpeg_error*>(cinfo->err)->jump, 1);
+    }
+
+    void jpeg_output_message(j_common_ptr)
+    {
+    }
+
+    // decode a JPEG file using DCT scaling, or return null to fall
+    // back to a full size decode
+    SDL_Surface* load_jpeg(std::FILE* fp, const jacui::size2d& max)
+    {
+        jpeg_decompress_struct cinfo;
+        jpeg_error err;
+        SDL_Surface* volatile dst = 0;
+        row_scaler* volatile scaler = 0;
+
+        cinfo.err = jpeg_std_error(&err);
+        err.error_exit = jpeg_error_exit;
+        err.output_message = jpeg_output_message;
+
+        if (setjmp(err.jump)) {
+            jpeg_destroy_decompress(&cinfo);
+            delete scaler;
+            SDL_FreeSurface(dst);
+            return 0;
+        }
+
+        jpeg_create_decompress(&cinfo);
+        jpeg_stdio_src(&cinfo, fp);
+        jpeg_read_header(&cinfo, TRUE);
+
+        jacui::size2d size = jacui::detail::fit_size(
+            jacui::size2d(cinfo.image_width, cinfo.image_height), max);
+        if (size.width == cinfo.image_width && size.height == cinfo.image_height)
+            std::longjmp(err.jump, 1); // nothing to scale
+        if (cinfo.jpeg_color_space != JCS_GRAYSCALE && cinfo.jpeg_color_space != JCS_YCbCr)
+            std::longjmp(err.jump, 1); // e.g. CMYK
+
+        // the largest reduction that is still not smaller than the result
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = 8;
+        while (cinfo.scale_denom > 1 
+               && ((cinfo.image_width + cinfo.scale_denom - 1) / cinfo.scale_denom < size.width
+                   || (cinfo.image_height + cinfo.scale_denom - 1) / cinfo.scale_denom < size.height))
+            cinfo.scale_denom /= 2;
+        cinfo.out_color_space = cinfo.jpeg_color_space == JCS_GRAYSCALE ? JCS_GRAYSCALE : JCS_RGB;
+        jpeg_start_decompress(&cinfo);
+
+        if (!(dst = make_rgb_surface(size.width, size.height, false)))
+            std::longjmp(err.jump, 1);
+        scaler = new row_scaler(dst, cinfo.output_width, cinfo.output_height, 
+                                cinfo.output_components);
+
+        while (cinfo.output_scanline < cinfo.output_height) {
+            JSAMPROW row = scaler->row();
+            jpeg_read_scanlines(&cinfo, &row, 1);
+            scaler->push();
+        }
+
+        jpeg_finish_decompress(&cinfo);
+        jpeg_destroy_decompress(&cinfo);
+        delete scaler;
+        return dst;
+    }
+#endif
+
+#ifdef JACUI_HAVE_LIBPNG
+    void png_error_fn(png_structp png, png_const_charp)
+    {
+        longjmp(png_jmpbuf(png), 1);
+    }
+
+    void png_warning_fn(png_structp, png_const_charp)
+    {
+    }
+
+    // decode a PNG file while scaling it down row by row, or return
+    // null to fall back to a full size decode
+    SDL_Surface* load_png(std::FILE* fp, const jacui::size2d& max)
+    {
+        png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, 0, 
+                                                 png_error_fn, png_warning_fn);
+        if (!png)
+            return 0;
+        png_infop info = png_create_info_struct(png);
+        SDL_Surface* volatile dst = 0;
+        row_scaler* volatile scaler = 0;
+
+        if (setjmp(png_jmpbuf(png))) {
+            png_destroy_read_struct(&png, &info, 0);
+            delete scaler;
+            SDL_FreeSurface(dst);
+            return 0;
+        }
+        if (!info)
+            png_error(png, "error creating PNG info");
+
+        png_init_io(png, fp);
+        png_read_info(png, info);
+
+        png_uint_32 width, height;
+        int depth, type, interlace;
+        png_get_IHDR(png, info, &width, &height, &depth, &type, &interlace, 0, 0);
+
+        jacui::size2d size = jacui::detail::fit_size(jacui::size2d(width, height), max);
+        if (size.width == width && size.height == height)
+            png_error(png, "nothing to scale");
+        if (interlace != PNG_INTERLACE_NONE)
+            png_error(png, "interlaced images need a full size buffer");
+
+        png_set_strip_16(png);
+        png_set_expand(png);
+        png_set_gray_to_rgb(png);
+        png_read_update_info(png, info);
+        int channels = png_get_channels(png, info);
+
+        if (!(dst = make_rgb_surface(size.width, size.height, channels == 4)))
+            png_error(png, "error creating surface");
+        scaler = new row_scaler(dst, width, height, channels);
+
+        for (png_uint_32 y = 0; y != height; ++y) {
+            png_read_row(png, scaler->row(), 0);
+            scaler->push();
+        }
+
+        png_destroy_read_struct(&png, &info, 0);
+        delete scaler;
+        return dst;
+    }
+#endif
+
+    // decode at reduced size if supported for the file's format
+    SDL_Surface* load_scaled(const char* filename, const jacui::size2d& max)
+    {
+        SDL_Surface* res = 0;
+#if defined(JACUI_HAVE_LIBJPEG) || defined(JACUI_HAVE_LIBPNG)
+        if (std::FILE* fp = std::fopen(filename, "rb")) {
+            unsigned char magic[8] = { 0 };
+            std::size_t n = std::fread(magic, 1, sizeof magic, fp);
+            std::rewind(fp);
+#ifdef JACUI_HAVE_LIBJPEG
+            if (n >= 3 && magic[0] == 0xff && magic[1] == 0xd8 && magic[2] == 0xff)
+                res = load_jpeg(fp, max);
+#endif
+#ifdef JACUI_HAVE_LIBPNG
+            if (n == 8 && !png_sig_cmp(magic, 0, 8))
+                res = load_png(fp, max);
+#endif
+            std::fclose(fp);
+        }
+#else
+        (void)filename;
+        (void)max;
+#endif
+        return res;
+    }
+}
+
+namespace jacui {
+    namespace detail {
+        size2d fit_size(const size2d& size, const size2d& max)
+        {
+            double scale = 1.0;
+            if (max.width && size.width > max.width)
+                scale = std::min(scale, double(max.width) / size.width);
+            if (max.height && size.height > max.height)
+                scale = std::min(scale, double(max.height) / size.height);
+            if (scale == 1.0)
+                return size;
+
+            std::size_t width = std::size_t(size.width * scale + 0.5);
+            std::size_t height = std::size_t(size.height * scale + 0.5);
+            return size2d(std::max<std::size_t>(width, 1), std::max<std::size_t>(height, 1));
+        }
+    }
+
+    image::image(const char* filename, const size2d& max_size)
+        : pimpl_(0)
+    {
+        // without a limit, load as usual rather than probing the file
+        bool limited = max_size.width || max_size.height;
+        image tmp(static_cast<detail::surface_type*>(limited ? load_scaled(filename, max_size) : 0));
+
+        if (!tmp.detail()) {
+            image src(filename);
+            size2d size = detail::fit_size(src.size(), max_size);
+
+            if (size == src.size()) {
+                tmp.swap(src);
+            } else {
+                image dst(detail::make_surface(size.width, size.height, native(src.detail())));
+                SDL_Rect srcrect = detail::make_rect(src.size());
+                SDL_Rect dstrect = detail::make_rect(size);
+                detail::surface_lock srclock(src.detail());
+                detail::surface_lock dstlock(dst.detail());
+                detail::warp(src.detail(), &srcrect, dst.detail(), &dstrect, surface::box);
+                tmp.swap(dst);
+            }
+        }
+        swap(tmp);
+    }
+
+    void image::load(const char* filename, const size2d& max_size)
+    {
+        image tmp(filename, max_size);
+        swap(tmp);
+    }
+}
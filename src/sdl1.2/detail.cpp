@@ -34,7 +34,7 @@
 #include <cctype>
 
 namespace {
-    enum { uc_user, uc_timeout, uc_interval };
+    enum { uc_user, uc_timeout, uc_interval, uc_shared };
 
     inline SDL_Event make_user_event(int code, void* p1 = 0, void* p2 = 0) {
         SDL_Event event;
@@ -86,14 +86,56 @@ namespace {
 
 namespace jacui {
     namespace detail {
+        shared_event::shared_event() : mutex_(SDL_CreateMutex()), count_(1)
+        {
+            if (!mutex_)
+                throw_error("error creating mutex");
+        }
+
+        shared_event::~shared_event()
+        {
+            SDL_DestroyMutex(mutex_);
+        }
+
+        void shared_event::acquire()
+        {
+            SDL_LockMutex(mutex_);
+            ++count_;
+            SDL_UnlockMutex(mutex_);
+        }
+
+        void shared_event::release()
+        {
+            SDL_LockMutex(mutex_);
+            int n = --count_;
+            SDL_UnlockMutex(mutex_);
+            if (n == 0)
+                delete this;
+        }
+
+        bool shared_event::shared() const
+        {
+            SDL_LockMutex(mutex_);
+            bool res = count_ > 1;
+            SDL_UnlockMutex(mutex_);
+            return res;
+        }
+
         event_queue::event_queue() : ntimer(0)
         {
             std::fill(&timers[0], &timers[max_timers], SDL_TimerID(0));
             event_.type = SDL_NOEVENT;
         }
 
+        event_queue::~event_queue()
+        {
+            detach_loads(this);
+            release();
+        }
+
         event* event_queue::wait()
         {
+            release();
             if (type() == event::quit)
                 return 0;
             if (type() == event::resize)
@@ -107,6 +149,7 @@ namespace jacui {
 
         event* event_queue::poll()
         {
+            release();
             if (type() == event::quit)
                 return 0;
             if (type() == event::resize)
@@ -125,6 +168,16 @@ namespace jacui {
                 throw_error("error pushing event");
         }
 
+        void event_queue::post(shared_event* pe)
+        {
+            pe->acquire();
+            SDL_Event event = make_user_event(uc_shared, pe);
+            if (SDL_PushEvent(&event) < 0) {
+                pe->release();
+                throw_error("error pushing event");
+            }
+        }
+
         timer_event::timer_type event_queue::set_timeout(unsigned long ms)
         {
             timer_type timer = make_timer();
@@ -179,6 +232,7 @@ namespace jacui {
             case SDL_USEREVENT:
                 switch (event_.user.code) {
                 case uc_user:
+                case uc_shared:
                     return event::user;
                 case uc_timeout:
                 case uc_interval:
@@ -215,6 +269,7 @@ namespace jacui {
             case SDL_USEREVENT:
                 switch (event_.user.code) {
                 case uc_user:
+                case uc_shared:
                     return "user";
                 case uc_timeout:
                 case uc_interval:
@@ -335,12 +390,32 @@ namespace jacui {
 
         event* event_queue::user() const 
         {
-            return is_user() ? static_cast<event*>(event_.user.data1) : 0;
+            if (is_shared())
+                return static_cast<shared_event*>(event_.user.data1);
+            else if (is_user())
+                return static_cast<event*>(event_.user.data1);
+            else
+                return 0;
         }
 
         bool event_queue::is_user() const
         {
-            return event_.type == SDL_USEREVENT && event_.user.code == uc_user;
+            return event_.type == SDL_USEREVENT 
+                && (event_.user.code == uc_user || event_.user.code == uc_shared);
+        }
+
+        bool event_queue::is_shared() const
+        {
+            return event_.type == SDL_USEREVENT && event_.user.code == uc_shared;
+        }
+
+        void event_queue::release()
+        {
+            // drop the queue's reference to the previous shared event
+            if (is_shared()) {
+                static_cast<shared_event*>(event_.user.data1)->release();
+                event_.type = SDL_NOEVENT;
+            }
         }
 
         bool event_queue::is_timeout() const
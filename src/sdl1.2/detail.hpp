@@ -31,13 +31,19 @@
 
 #include "jacui/event.hpp"
 #include "jacui/error.hpp"
+#include "jacui/surface.hpp"
 #include "jacui/types.hpp"
 
 #include <SDL.h>
+#include <SDL_thread.h>
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 namespace jacui {
+    class image_future;
+
     namespace detail {
         struct surface_type: public SDL_Surface { };
 
@@ -52,6 +58,9 @@ namespace jacui {
             throw e;
         }
 
+        // convert errno of a failed file operation to sdl exception
+        void throw_io_error(const char* msg, const char* filename);
+
         class surface_lock {
         public:
             surface_lock(SDL_Surface* s) : surface_(s) {
@@ -76,6 +85,43 @@ namespace jacui {
             SDL_Surface* surface_;
         };
 
+        class mutex_lock {
+        public:
+            mutex_lock(SDL_mutex* m) : mutex_(m) { SDL_LockMutex(mutex_); }
+            ~mutex_lock() { SDL_UnlockMutex(mutex_); }
+
+        private:
+            mutex_lock(const mutex_lock&);
+            mutex_lock& operator=(const mutex_lock&);
+
+        private:
+            SDL_mutex* mutex_;
+        };
+
+        // user event shared between threads, deleted with its last reference
+        class shared_event: public user_event {
+        public:
+            shared_event();
+
+            void acquire();
+
+            void release();
+
+            // whether any other references exist
+            bool shared() const;
+
+        protected:
+            virtual ~shared_event();
+
+        private:
+            shared_event(const shared_event&);
+            shared_event& operator=(const shared_event&);
+
+        private:
+            SDL_mutex* mutex_;
+            int count_;
+        };
+
         class event_queue: public jacui::event_queue,
             private resize_event, 
             private redraw_event, 
@@ -86,12 +132,17 @@ namespace jacui {
         public:
             event_queue();
 
+            ~event_queue();
+
             event* wait();
 
             event* poll();
 
             void push(event*);
 
+            // push a shared event, referenced until the next wait() or poll()
+            void post(shared_event* pe);
+
             timer_event::timer_type set_timeout(unsigned long ms);
 
             timer_event::timer_type set_interval(unsigned long ms);
@@ -128,6 +179,10 @@ namespace jacui {
 
             bool is_user() const;
 
+            bool is_shared() const;
+
+            void release();
+
             bool is_timeout() const;
 
             bool is_interval() const;
@@ -159,16 +214,322 @@ namespace jacui {
             init& operator=(const init&);
         };
 
+        // bounds checked access to the bytes of a file format
+        class byte_reader {
+        public:
+            byte_reader(const void* data, std::size_t size) 
+                : data_(static_cast<const Uint8*>(data)), size_(size)
+            {
+            }
+
+            std::size_t size() const
+            {
+                return size_;
+            }
+
+            bool has(std::size_t pos, std::size_t n) const
+            {
+                return pos <= size_ && n <= size_ - pos;
+            }
+
+            bool match(std::size_t pos, const char* s, std::size_t n) const
+            {
+                return has(pos, n) && std::equal(s, s + n, reinterpret_cast<const char*>(data_ + pos));
+            }
+
+            unsigned long u8(std::size_t pos) const
+            {
+                check(pos, 1);
+                return data_[pos];
+            }
+
+            unsigned long le16(std::size_t pos) const
+            {
+                check(pos, 2);
+                return data_[pos] | data_[pos + 1] << 8;
+            }
+
+            unsigned long le32(std::size_t pos) const
+            {
+                return le16(pos) | le16(pos + 2) << 16;
+            }
+
+            unsigned long be16(std::size_t pos) const
+            {
+                check(pos, 2);
+                return data_[pos] << 8 | data_[pos + 1];
+            }
+
+            unsigned long be32(std::size_t pos) const
+            {
+                return be16(pos) << 16 | be16(pos + 2);
+            }
+
+        private:
+            void check(std::size_t pos, std::size_t n) const
+            {
+                if (!has(pos, n))
+                    throw error("truncated image file");
+            }
+
+        private:
+            const Uint8* data_;
+            std::size_t size_;
+        };
+
+        // reference counted, immutable block of memory, copied, mapped
+        // from a file or owned by the caller; read-only mappings of the same file are
+        // shared, copy-on-write mappings are private and may be
+        // written to without affecting the file
+        class shared_data {
+        public:
+            typedef void (*release_function)(void* data, void* context);
+
+            shared_data();
+
+            shared_data(const void* data, std::size_t size);
+
+            // refer to external memory without copying it; release is
+            // called when the last reference is gone, or if this throws
+            shared_data(const void* data, std::size_t size, release_function release, void* context);
+
+            shared_data(const shared_data& rhs);
+
+            ~shared_data();
+
+            static shared_data map(const char* filename, bool copy_on_write = false);
+
+            const void* data() const;
+
+            std::size_t size() const;
+
+            void swap(shared_data& rhs);
+
+            shared_data& operator=(const shared_data& rhs) {
+                shared_data tmp(rhs);
+                swap(tmp);
+                return *this;
+            }
+
+        public:
+            struct block;
+
+        private:
+            block* block_;
+        };
+
+        // a unit of background work, deleted after it has been run
+        class job {
+        public:
+            explicit job(int priority = 0) : priority(priority) { }
+
+            virtual ~job();
+
+            virtual void run() = 0;
+
+            // jobs with higher priority run first
+            int priority;
+        };
+
+        // run a job on a background thread, taking ownership of it
+        void post_job(job* pj);
+
+        // change the priority of a job that is still queued; false if
+        // it has been started, and may have been deleted, already
+        bool reprioritize_job(job* pj, int priority);
+
+        // decode an image file with a given job priority
+        image_future load_async(const char* filename, jacui::event_queue* events, int priority);
+
+        // change the job priority of a load that has not started yet
+        void reprioritize_load(const image_future& f, int priority);
+
+        // stop pending loads from posting to an event queue that is
+        // being destroyed
+        void detach_loads(jacui::event_queue* events);
+
+        // process [0, size) in bands of at least grain items, possibly in
+        // parallel; the first exception thrown by a band is rethrown in
+        // the caller once no band runs any more, as an error unless it
+        // is a std::bad_alloc
+        void parallel_for(int size, int grain, void (*fn)(void*, int, int), void* arg);
+
+        template<class Function>
+        void parallel_for_band(void* arg, int begin, int end) {
+            (*static_cast<Function*>(arg))(begin, end);
+        }
+
+        template<class Function>
+        void parallel_for(int size, int grain, Function& f) {
+            parallel_for(size, grain, &parallel_for_band<Function>, &f);
+        }
+
+        // minimum number of pixels worth processing in a separate band
+        const int parallel_pixels = 16384;
+
+        inline int parallel_rows(int width) {
+            return width > 0 ? (parallel_pixels + width - 1) / width : 1;
+        }
+
+        // the rects of a region to update on a video surface, clipped to
+        // its size, or false if the surface can only be flipped as a whole
+        bool update_rects(const SDL_Surface* s, const region& r, std::vector<SDL_Rect>& rects);
+
+        // size scaled down to fit a maximum size, keeping the aspect
+        // ratio; zero maximum width or height means unbounded
+        size2d fit_size(const size2d& size, const size2d& max);
+
+        // scale a source rectangle to a destination rectangle
+        void warp(SDL_Surface* src, SDL_Rect* srcrect, SDL_Surface* dst, SDL_Rect* dstrect,
+                  surface::scale_filter filter);
+
+        // whether filtered scaling uses SIMD instructions where they
+        // are available; both kernels draw the same pixels, the scalar
+        // one is kept for testing the other
+        void simd(bool enable);
+
+        // average 2x2 pixel blocks of a surface with byte channels into
+        // a surface of the same format, at an offset
+        void halve(const SDL_Surface* src, SDL_Surface* dst, int x = 0, int y = 0);
+
         inline surface_type* make_surface(SDL_Surface* p) {
             if (!p)
                 throw_error("error creating surface");
             return static_cast<surface_type*>(p);
         }
 
+        inline surface_type* make_surface(std::size_t width, std::size_t height,
+                                          pixel_format format = rgb888) {
+            switch (format) {
+            case xrgb8888:
+                return make_surface(SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 32,
+                                                         0x00ff0000, 0x0000ff00, 0x000000ff, 0));
+            case argb8888:
+                return make_surface(SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 32,
+                                                         0x00ff0000, 0x0000ff00, 0x000000ff,
+                                                         0xff000000));
+            default:
+                return make_surface(SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 24,
+                                                         0, 0, 0, 0));
+            }
+        }
+
+        inline surface_type* make_surface(void* pixels, std::size_t width, std::size_t height,
+                                          std::size_t pitch, pixel_format format) {
+            switch (format) {
+            case xrgb8888:
+                return make_surface(SDL_CreateRGBSurfaceFrom(pixels, width, height, 32, pitch,
+                                                             0x00ff0000, 0x0000ff00, 0x000000ff, 0));
+            case argb8888:
+                return make_surface(SDL_CreateRGBSurfaceFrom(pixels, width, height, 32, pitch,
+                                                             0x00ff0000, 0x0000ff00, 0x000000ff,
+                                                             0xff000000));
+            default:
+                return make_surface(SDL_CreateRGBSurfaceFrom(pixels, width, height, 24, pitch,
+                                                             0, 0, 0, 0));
+            }
+        }
+
         inline surface_type* copy_surface(surface_type* p) {
-            return p ? make_surface(SDL_ConvertSurface(p, p->format, p->flags)) : 0;
+            // copies always own their pixels
+            return p ? make_surface(SDL_ConvertSurface(p, p->format, p->flags & ~SDL_PREALLOC)) : 0;
         }
 
+        // a copy in another pixel format, which keeps the colorkey
+        // and alpha settings like SDL_DisplayFormat()
+        inline surface_type* convert_surface(surface_type* p, pixel_format format) {
+            SDL_Surface* tmp = make_surface(1, 1, format);
+            SDL_Surface* q = SDL_ConvertSurface(p, tmp->format, p->flags & ~SDL_PREALLOC);
+            SDL_FreeSurface(tmp);
+            return make_surface(q);
+        }
+
+        // add a reference to a surface that may be shared between threads
+        surface_type* share_surface(surface_type* p);
+
+        // the surface for a copy of a canvas or image: surfaces owning
+        // their pixels are shared until either copy draws onto them,
+        // surfaces with external pixels are copied right away
+        surface_type* lazy_copy(surface_type* p);
+
+        // whether no other reference to a surface exists
+        bool is_unique(surface_type* p);
+
+        // a surface referenced only by the caller, for drawing onto;
+        // shared surfaces are copied and the caller's reference to
+        // them is released
+        surface_type* unshare_surface(surface_type* p);
+
+        // release a reference to a surface that may be shared between threads
+        void free_surface(surface_type* p);
+
+        // a surface for a canvas with room for at least capacity
+        // pixels, reusing a pooled surface of the same size class if
+        // canvas::pool_budget() is set
+        surface_type* acquire_surface(const size2d& size, const size2d& capacity, pixel_format format);
+
+        // keep a surface made by acquire_surface() in the pool when its
+        // last reference is freed; false if it has to be freed instead
+        bool recycle_surface(surface_type* p);
+
+        // the allocated size of a surface
+        size2d surface_capacity(surface_type* p);
+
+        // change the size of an unshared surface made by
+        // acquire_surface() within its capacity, clearing pixels that
+        // become visible; false if the surface has to be reallocated
+        bool resize_surface(surface_type* p, const size2d& size);
+
+        // keep data alive until a surface is freed with free_surface(),
+        // e.g. the file mapping a surface's pixels refer to
+        void attach_data(surface_type* p, const shared_data& data);
+
+        // build mip levels of a surface when it is scaled down, see
+        // image::mipmaps()
+        void enable_mipmaps(surface_type* p, bool enable);
+
+        bool has_mipmaps(surface_type* p);
+
+        // drop the mip levels built so far, e.g. after drawing
+        void clear_mipmaps(surface_type* p);
+
+        // a reference to the smallest mip level that is still at least
+        // as large as a blit's destination, with the source rectangle
+        // adjusted to the level; null if there is no such level
+        surface_type* mipmap(surface_type* p, SDL_Rect& srcrect, const SDL_Rect& dstrect);
+
+        // pixel rows of an uncompressed image file
+        struct raw_layout {
+            raw_layout() : offset(0), width(0), height(0), pitch(0), depth(0),
+                           rmask(0), gmask(0), bmask(0), amask(0), gray(false)
+            {
+            }
+
+            // whether a single surface can wrap the rows, SDL's
+            // pitch is 16 bits
+            bool wrappable() const
+            {
+                return width <= 0xffff && pitch <= 0xffff;
+            }
+
+            std::size_t offset;
+            std::size_t width;
+            std::size_t height;
+            std::size_t pitch;
+            int depth;
+            Uint32 rmask;
+            Uint32 gmask;
+            Uint32 bmask;
+            Uint32 amask;
+            bool gray;
+        };
+
+        // find the pixel rows of an uncompressed PNM, BMP or TGA file
+        bool layout_raw(const shared_data& data, raw_layout& l);
+
+        // a surface for pixel rows within mapped data
+        surface_type* map_surface(const shared_data& data, const raw_layout& l);
+
         inline cursor_type* make_cursor(SDL_Cursor* p) {
             if (!p)
                 throw_error("error creating cursor");
@@ -186,6 +547,10 @@ namespace jacui {
             return make_rwops(s.data(), s.size());
         }
 
+        inline SDL_RWops* make_rwops(const shared_data& s) {
+            return make_rwops(s.data(), s.size());
+        }
+
         inline SDL_Rect make_rect(point2d p) {
             SDL_Rect rect = { p.x, p.y, 0, 0 };
             return rect;
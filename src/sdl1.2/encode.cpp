@@ -0,0 +1,520 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "jacui/surface.hpp"
+#include "detail.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef JACUI_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+    // writes a file, throwing an error if anything fails
+    class file_writer {
+    public:
+        explicit file_writer(const char* filename)
+            : filename_(filename), fp_(std::fopen(filename, "wb")), ok_(true)
+        {
+            if (!fp_)
+                jacui::detail::throw_io_error("error creating file", filename);
+        }
+
+        ~file_writer()
+        {
+            if (fp_)
+                std::fclose(fp_);
+        }
+
+        void write(const void* data, std::size_t size)
+        {
+            if (ok_ && size && std::fwrite(data, size, 1, fp_) != 1)
+                ok_ = false;
+        }
+
+        void close()
+        {
+            std::FILE* fp = fp_;
+            fp_ = 0;
+            if (std::fclose(fp) != 0 || !ok_)
+                jacui::detail::throw_io_error("error writing file", filename_);
+        }
+
+    private:
+        file_writer(const file_writer&);
+        file_writer& operator=(const file_writer&);
+
+    private:
+        const char* filename_;
+        std::FILE* fp_;
+        bool ok_;
+    };
+
+    void put_le16(Uint8* p, unsigned long v)
+    {
+        p[0] = Uint8(v);
+        p[1] = Uint8(v >> 8);
+    }
+
+    void put_le32(Uint8* p, unsigned long v)
+    {
+        put_le16(p, v);
+        put_le16(p + 2, v >> 16);
+    }
+
+    void put_be32(Uint8* p, unsigned long v)
+    {
+        p[0] = Uint8(v >> 24);
+        p[1] = Uint8(v >> 16);
+        p[2] = Uint8(v >> 8);
+        p[3] = Uint8(v);
+    }
+
+    inline Uint32 load_pixel(const Uint8* p, int bpp)
+    {
+        switch (bpp) {
+        case 1:
+            return *p;
+        case 2: {
+            Uint16 v;
+            std::memcpy(&v, p, 2);
+            return v;
+        }
+        case 3:
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+            return p[0] | p[1] << 8 | p[2] << 16;
+#else
+            return p[0] << 16 | p[1] << 8 | p[2];
+#endif
+        default: {
+            Uint32 v;
+            std::memcpy(&v, p, 4);
+            return v;
+        }
+        }
+    }
+
+    // converts rows of a surface to RGB or RGBA bytes
+    class row_reader {
+    public:
+        row_reader(SDL_Surface* s, bool alpha) : surface_(s), alpha_(alpha)
+        {
+            const SDL_PixelFormat* f = s->format;
+            direct_ = (f->BytesPerPixel == 3 || f->BytesPerPixel == 4) && !f->palette
+                && !f->Rloss && !f->Gloss && !f->Bloss && (!alpha || !f->Aloss);
+        }
+
+        std::size_t channels() const
+        {
+            return alpha_ ? 4 : 3;
+        }
+
+        std::size_t size() const
+        {
+            return surface_->w * channels();
+        }
+
+        void read(int y, Uint8* out) const
+        {
+            const SDL_PixelFormat* f = surface_->format;
+            const int bpp = f->BytesPerPixel;
+            const Uint8* p = static_cast<const Uint8*>(surface_->pixels) + y * surface_->pitch;
+
+            if (direct_) {
+                // 8 bit channels: shift them out of the pixel
+                for (int x = 0; x != surface_->w; ++x, p += bpp) {
+                    Uint32 v = load_pixel(p, bpp);
+                    *out++ = Uint8((v & f->Rmask) >> f->Rshift);
+                    *out++ = Uint8((v & f->Gmask) >> f->Gshift);
+                    *out++ = Uint8((v & f->Bmask) >> f->Bshift);
+                    if (alpha_)
+                        *out++ = Uint8((v & f->Amask) >> f->Ashift);
+                }
+            } else {
+                for (int x = 0; x != surface_->w; ++x, p += bpp) {
+                    Uint8 r, g, b, a;
+                    SDL_GetRGBA(load_pixel(p, bpp), const_cast<SDL_PixelFormat*>(f), &r, &g, &b, &a);
+                    *out++ = r;
+                    *out++ = g;
+                    *out++ = b;
+                    if (alpha_)
+                        *out++ = a;
+                }
+            }
+        }
+
+    private:
+        SDL_Surface* surface_;
+        bool alpha_;
+        bool direct_;
+    };
+
+    SDL_Surface* checked_surface(const jacui::surface& s)
+    {
+        if (s.empty())
+            throw jacui::error("cannot save an empty surface");
+        return s.detail();
+    }
+
+    inline unsigned long abs_byte(int d)
+    {
+        int v = static_cast<signed char>(d & 0xff);
+        return v < 0 ? -v : v;
+    }
+
+    inline int paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = std::abs(p - a);
+        int pb = std::abs(p - b);
+        int pc = std::abs(p - c);
+        return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+    }
+
+    // filter a PNG row, choosing the filter with the smallest sum of
+    // absolute differences like libpng does
+    void filter_row(const Uint8* cur, const Uint8* prev, std::size_t n, std::size_t bpp, Uint8* out)
+    {
+        unsigned long sums[5] = { 0, 0, 0, 0, 0 };
+
+        for (std::size_t i = 0; i != n; ++i) {
+            int x = cur[i];
+            int a = i >= bpp ? cur[i - bpp] : 0;
+            int b = prev[i];
+            int c = i >= bpp ? prev[i - bpp] : 0;
+            sums[0] += abs_byte(x);
+            sums[1] += abs_byte(x - a);
+            sums[2] += abs_byte(x - b);
+            sums[3] += abs_byte(x - ((a + b) >> 1));
+            sums[4] += abs_byte(x - paeth(a, b, c));
+        }
+
+        int filter = std::min_element(sums, sums + 5) - sums;
+        *out++ = Uint8(filter);
+
+        for (std::size_t i = 0; i != n; ++i) {
+            int x = cur[i];
+            int a = i >= bpp ? cur[i - bpp] : 0;
+            int b = prev[i];
+            int c = i >= bpp ? prev[i - bpp] : 0;
+            switch (filter) {
+            case 0: out[i] = Uint8(x); break;
+            case 1: out[i] = Uint8(x - a); break;
+            case 2: out[i] = Uint8(x - b); break;
+            case 3: out[i] = Uint8(x - ((a + b) >> 1)); break;
+            default: out[i] = Uint8(x - paeth(a, b, c)); break;
+            }
+        }
+    }
+
+#ifndef JACUI_HAVE_ZLIB
+    // without zlib, PNG data is stored uncompressed
+    unsigned long crc32(unsigned long crc, const Uint8* p, std::size_t n)
+    {
+        static unsigned long table[256];
+        static bool init = false;
+
+        if (!init) {
+            for (unsigned long i = 0; i != 256; ++i) {
+                unsigned long c = i;
+                for (int k = 0; k != 8; ++k)
+                    c = c & 1 ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+                table[i] = c;
+            }
+            init = true;
+        }
+
+        crc ^= 0xffffffffUL;
+        while (n--)
+            crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        return crc ^ 0xffffffffUL;
+    }
+
+    unsigned long adler32(unsigned long adler, const Uint8* p, std::size_t n)
+    {
+        unsigned long a = adler & 0xffff;
+        unsigned long b = adler >> 16;
+
+        while (n) {
+            std::size_t k = std::min<std::size_t>(n, 5552); // no overflow
+            n -= k;
+            while (k--) {
+                a += *p++;
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        return b << 16 | a;
+    }
+#endif
+
+    // a block of PNG rows, filtered and compressed independently
+    struct png_block {
+        int begin;
+        int end;
+        std::vector<Uint8> filtered;
+        std::vector<Uint8> compressed;
+        unsigned long adler;
+        bool ok;
+    };
+
+    class png_encoder {
+    public:
+        png_encoder(SDL_Surface* s, int level)
+            : reader_(s, s->format->Amask != 0), level_(std::max(0, std::min(level, 9)))
+        {
+            std::size_t n = reader_.size() + 1;
+            int rows = std::max<int>(1, (256 << 10) / n);
+
+            // allocate up front, the blocks are processed on other threads
+            for (int y = 0; y < s->h; y += rows) {
+                blocks.push_back(png_block());
+                png_block& b = blocks.back();
+                b.begin = y;
+                b.end = std::min(y + rows, s->h);
+                b.filtered.resize((b.end - b.begin) * n);
+#ifdef JACUI_HAVE_ZLIB
+                b.compressed.resize(compressBound(b.filtered.size()) + 64);
+#endif
+                b.adler = 1;
+                b.ok = false;
+            }
+        }
+
+        void filter(png_block& b)
+        {
+            std::size_t n = reader_.size();
+            std::vector<Uint8> prev(n), cur(n);
+            Uint8* out = &b.filtered[0];
+
+            if (b.begin > 0)
+                reader_.read(b.begin - 1, &prev[0]);
+
+            for (int y = b.begin; y != b.end; ++y, out += n + 1) {
+                reader_.read(y, &cur[0]);
+                filter_row(&cur[0], &prev[0], n, reader_.channels(), out);
+                prev.swap(cur);
+            }
+        }
+
+        void compress(png_block& b)
+        {
+            bool last = &b == &blocks.back();
+#ifdef JACUI_HAVE_ZLIB
+            z_stream z;
+            std::memset(&z, 0, sizeof z);
+            if (deflateInit2(&z, level_, Z_DEFLATED, -15, 8, Z_FILTERED) != Z_OK)
+                return;
+
+            // the preceding block's data keeps matches across block boundaries
+            if (&b != &blocks.front()) {
+                const std::vector<Uint8>& prev = (&b - 1)->filtered;
+                std::size_t n = std::min<std::size_t>(prev.size(), 32768);
+                deflateSetDictionary(&z, &prev[prev.size() - n], n);
+            }
+
+            z.next_in = &b.filtered[0];
+            z.avail_in = b.filtered.size();
+            z.next_out = &b.compressed[0];
+            z.avail_out = b.compressed.size();
+
+            // a sync flush ends non-final blocks on a byte boundary
+            int rc = deflate(&z, last ? Z_FINISH : Z_SYNC_FLUSH);
+            b.ok = last ? rc == Z_STREAM_END : rc == Z_OK && !z.avail_in && z.avail_out;
+            b.compressed.resize(z.total_out);
+            b.adler = adler32(1, &b.filtered[0], b.filtered.size());
+            deflateEnd(&z);
+#else
+            // stored deflate blocks of at most 65535 bytes
+            const Uint8* p = &b.filtered[0];
+            std::size_t n = b.filtered.size();
+            b.compressed.reserve(n + (n / 65535 + 1) * 5);
+            do {
+                std::size_t k = std::min<std::size_t>(n, 65535);
+                Uint8 header[5] = { Uint8(last && k == n), 0, 0, 0, 0 };
+                put_le16(header + 1, k);
+                put_le16(header + 3, ~k & 0xffff);
+                b.compressed.insert(b.compressed.end(), header, header + 5);
+                b.compressed.insert(b.compressed.end(), p, p + k);
+                p += k;
+                n -= k;
+            } while (n);
+            b.ok = true;
+#endif
+        }
+
+        void write(file_writer& out)
+        {
+            static const Uint8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+            out.write(signature, sizeof signature);
+
+            Uint8 header[13] = { 0 };
+            put_be32(header, reader_.size() / reader_.channels());
+            put_be32(header + 4, blocks.back().end);
+            header[8] = 8; // bit depth
+            header[9] = reader_.channels() == 4 ? 6 : 2;
+            write_chunk(out, "IHDR", header, sizeof header);
+
+            unsigned long adler = 1;
+            for (std::size_t i = 0; i != blocks.size(); ++i) {
+                png_block& b = blocks[i];
+                if (!b.ok)
+                    throw jacui::error("error compressing PNG data");
+#ifdef JACUI_HAVE_ZLIB
+                adler = i ? adler32_combine(adler, b.adler, b.filtered.size()) : b.adler;
+#else
+                adler = adler32(adler, &b.filtered[0], b.filtered.size());
+#endif
+                if (i == 0) {
+                    static const Uint8 zlib_header[2] = { 0x78, 0x01 };
+                    b.compressed.insert(b.compressed.begin(), zlib_header, zlib_header + 2);
+                }
+                if (i + 1 == blocks.size()) {
+                    Uint8 trailer[4];
+                    put_be32(trailer, adler);
+                    b.compressed.insert(b.compressed.end(), trailer, trailer + 4);
+                }
+                write_chunk(out, "IDAT", &b.compressed[0], b.compressed.size());
+            }
+
+            write_chunk(out, "IEND", 0, 0);
+        }
+
+        std::vector<png_block> blocks;
+
+    private:
+        static void write_chunk(file_writer& out, const char* type, const Uint8* data, std::size_t n)
+        {
+            Uint8 buf[8];
+            put_be32(buf, n);
+            std::memcpy(buf + 4, type, 4);
+            out.write(buf, 8);
+            out.write(data, n);
+
+            unsigned long crc = crc32(0, buf + 4, 4);
+            if (n)
+                crc = crc32(crc, data, n);
+            put_be32(buf, crc);
+            out.write(buf, 4);
+        }
+
+    private:
+        row_reader reader_;
+        int level_;
+    };
+
+    struct png_filter_blocks {
+        void operator()(int begin, int end) {
+            for (int i = begin; i != end; ++i)
+                encoder->filter(encoder->blocks[i]);
+        }
+
+        png_encoder* encoder;
+    };
+
+    struct png_compress_blocks {
+        void operator()(int begin, int end) {
+            for (int i = begin; i != end; ++i)
+                encoder->compress(encoder->blocks[i]);
+        }
+
+        png_encoder* encoder;
+    };
+}
+
+namespace jacui {
+    void surface::save_ppm(const char* filename) const
+    {
+        SDL_Surface* s = checked_surface(*this);
+        detail::surface_lock lock(s);
+        row_reader reader(s, false);
+        std::vector<Uint8> row(reader.size());
+
+        file_writer out(filename);
+        char header[64];
+        out.write(header, std::sprintf(header, "P6\n%d %d\n255\n", s->w, s->h));
+        for (int y = 0; y != s->h; ++y) {
+            reader.read(y, &row[0]);
+            out.write(&row[0], row.size());
+        }
+        out.close();
+    }
+
+    void surface::save_bmp(const char* filename) const
+    {
+        SDL_Surface* s = checked_surface(*this);
+        detail::surface_lock lock(s);
+        row_reader reader(s, false);
+        std::size_t pitch = (reader.size() + 3) & ~3;
+        std::vector<Uint8> row(pitch);
+
+        Uint8 header[54] = { 'B', 'M' };
+        put_le32(header + 2, sizeof header + pitch * s->h);
+        put_le32(header + 10, sizeof header);
+        put_le32(header + 14, 40);
+        put_le32(header + 18, s->w);
+        put_le32(header + 22, s->h);
+        put_le16(header + 26, 1);
+        put_le16(header + 28, 24);
+        put_le32(header + 34, pitch * s->h);
+        put_le32(header + 38, 2835); // 72 dpi
+        put_le32(header + 42, 2835);
+
+        file_writer out(filename);
+        out.write(header, sizeof header);
+        for (int y = s->h; y-- != 0; ) {
+            // bottom-up rows of BGR pixels
+            reader.read(y, &row[0]);
+            for (std::size_t i = 0; i < reader.size(); i += 3)
+                std::swap(row[i], row[i + 2]);
+            out.write(&row[0], row.size());
+        }
+        out.close();
+    }
+
+    void surface::save_png(const char* filename, int level) const
+    {
+        SDL_Surface* s = checked_surface(*this);
+        detail::surface_lock lock(s);
+        png_encoder encoder(s, level);
+
+        png_filter_blocks filter = { &encoder };
+        detail::parallel_for(encoder.blocks.size(), 1, filter);
+        png_compress_blocks compress = { &encoder };
+        detail::parallel_for(encoder.blocks.size(), 1, compress);
+
+        file_writer out(filename);
+        encoder.write(out);
+        out.close();
+    }
+}
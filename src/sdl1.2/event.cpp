@@ -36,6 +36,7 @@ namespace jacui {
 
     event_queue::~event_queue()
     {
+        detail::detach_loads(this);
     }
 
     const input_event::modmask_type input_event::shift_mask = KMOD_SHIFT;
@@ -27,78 +27,592 @@
  */
 
 #include "jacui/font.hpp"
+#include "jacui/image.hpp"
 #include "detail.hpp"
 
 #include <SDL_ttf.h>
 
 #include <algorithm>
-#include <fstream>
-#include <iterator>
+#include <list>
+#include <map>
 #include <vector>
 
 using namespace jacui::detail;
 
+#if defined(SDL_TTF_MAJOR_VERSION) && SDL_VERSIONNUM(SDL_TTF_MAJOR_VERSION, SDL_TTF_MINOR_VERSION, SDL_TTF_PATCHLEVEL) >= SDL_VERSIONNUM(2, 0, 10)
+# define JACUI_TTF_KERNING
+#endif
+
 namespace {
-    class rendered: public jacui::surface {
+    // cached glyph metrics and location of its coverage in the atlas
+    struct glyph {
+        glyph() 
+            : x(0), y(0), w(0), h(0), minx(0), maxx(0), miny(0), maxy(0), advance(0),
+              measured(false), rendered(false) { }
+
+        int x, y, w, h;
+        int minx, maxx, miny, maxy, advance;
+        bool measured;
+        bool rendered;
+    };
+
+    // glyph coverage packed into shelves of an 8 bit alpha atlas; when
+    // the atlas or the number of other glyphs reaches its limit, the
+    // whole cache is dropped and refilled
+    class glyph_cache {
     public:
-        rendered(TTF_Font* f, const char* s, SDL_Color fg) 
-            : detail_(make_surface(TTF_RenderUTF8_Blended(f, s, fg)))
+        glyph_cache() : width_(min_width), height_(0), shelfx_(0), shelfy_(0), shelfh_(0) { }
+
+        // glyph metrics only
+        const glyph& metrics(TTF_Font* font, Uint16 ch)
         {
+            glyph& g = find(ch);
+            if (!g.measured)
+                measure(font, ch, g);
+            return g;
         }
 
-        rendered(TTF_Font* f, const char* s, SDL_Color fg, SDL_Color bg) 
-            : detail_(make_surface(TTF_RenderUTF8_Shaded(f, s, fg, bg)))
+        // glyph metrics and coverage, valid until the next call
+        const glyph& bitmap(TTF_Font* font, Uint16 ch)
         {
+            if (atlas_.size() >= max_atlas_size && !find(ch).rendered)
+                clear();
+            glyph& g = find(ch);
+            if (!g.measured)
+                measure(font, ch, g);
+            if (!g.rendered)
+                render(font, ch, g);
+            return g;
         }
 
-        rendered(TTF_Font* f, const Uint16* s, SDL_Color fg) 
-            : detail_(make_surface(TTF_RenderUNICODE_Blended(f, s, fg)))
+        const Uint8* coverage(const glyph& g) const
         {
+            return &atlas_[g.y * width_ + g.x];
         }
 
-        rendered(TTF_Font* f, const Uint16* s, SDL_Color fg, SDL_Color bg) 
-            : detail_(make_surface(TTF_RenderUNICODE_Shaded(f, s, fg, bg)))
+        int pitch() const
         {
+            return width_;
         }
 
-        ~rendered() 
+        void clear()
         {
-            SDL_FreeSurface(detail_);
+            std::fill(latin1_, latin1_ + 256, glyph());
+            others_.clear();
+            atlas_.clear();
+            width_ = min_width;
+            height_ = shelfx_ = shelfy_ = shelfh_ = 0;
         }
 
     private:
-        surface_type* detail() const { return detail_; }
+        enum { min_width = 512, max_atlas_size = 2048 * 1024, max_others = 1024 };
+
+        glyph& find(Uint16 ch)
+        {
+            if (ch < 256)
+                return latin1_[ch];
+            if (others_.size() >= max_others && others_.find(ch) == others_.end())
+                clear();
+            return others_[ch];
+        }
+
+        void measure(TTF_Font* font, Uint16 ch, glyph& g)
+        {
+            if (TTF_GlyphMetrics(font, ch, &g.minx, &g.maxx, &g.miny, &g.maxy, &g.advance) < 0)
+                throw_error("error getting glyph metrics");
+            g.measured = true;
+        }
+
+        void render(TTF_Font* font, Uint16 ch, glyph& g)
+        {
+            if (g.maxx > g.minx && g.maxy > g.miny) {
+                SDL_Color white = { 0xff, 0xff, 0xff, 0 };
+                SDL_Surface* s = TTF_RenderGlyph_Blended(font, ch, white);
+                if (!s)
+                    throw_error("error rendering glyph");
+                try {
+                    insert(s, g);
+                } catch (...) {
+                    SDL_FreeSurface(s);
+                    throw;
+                }
+                SDL_FreeSurface(s);
+            }
+            g.rendered = true;
+        }
+
+        // copy the alpha channel of a rendered glyph into the atlas
+        void insert(SDL_Surface* s, glyph& g)
+        {
+            if (s->w > width_)
+                widen(s->w);
+            if (shelfx_ + s->w > width_) {
+                shelfy_ += shelfh_;
+                shelfx_ = shelfh_ = 0;
+            }
+            if (shelfy_ + s->h > height_) {
+                height_ = std::max(shelfy_ + s->h, std::min<int>(height_ * 2, max_atlas_size / width_));
+                atlas_.resize(width_ * height_);
+            }
+
+            g.x = shelfx_;
+            g.y = shelfy_;
+            g.w = s->w;
+            g.h = s->h;
+            shelfx_ += s->w;
+            shelfh_ = std::max(shelfh_, s->h);
+
+            surface_lock lock(s);
+            const SDL_PixelFormat* fmt = s->format;
+            for (int y = 0; y != g.h; ++y) {
+                const Uint32* src = reinterpret_cast<const Uint32*>(
+                    static_cast<const Uint8*>(s->pixels) + y * s->pitch
+                    );
+                Uint8* dst = &atlas_[(g.y + y) * width_ + g.x];
+                for (int x = 0; x != g.w; ++x) {
+                    dst[x] = Uint8((src[x] & fmt->Amask) >> fmt->Ashift);
+                }
+            }
+        }
+
+        void widen(int width)
+        {
+            int w = std::max<int>(width, width_ * 2);
+            std::vector<Uint8> tmp(w * height_);
+            for (int y = 0; y != height_; ++y) {
+                std::copy(&atlas_[y * width_], &atlas_[y * width_] + width_, &tmp[y * w]);
+            }
+            atlas_.swap(tmp);
+            width_ = w;
+        }
 
     private:
-        surface_type* detail_;
+        glyph latin1_[256];
+        std::map<Uint16, glyph> others_;
+        std::vector<Uint8> atlas_;
+        int width_;
+        int height_;
+        int shelfx_;
+        int shelfy_;
+        int shelfh_;
     };
+
+    // decode the next UCS-2 character of a UTF-8 string, like SDL_ttf
+    inline Uint16 next_char(const char*& p, const char* end)
+    {
+        Uint32 ch = static_cast<unsigned char>(*p++);
+        int n = ch >= 0xf0 ? 3 : ch >= 0xe0 ? 2 : ch >= 0xc0 ? 1 : 0;
+        if (n) {
+            ch &= 0x3f >> n;
+            for (; n && p != end; --n) {
+                ch = ch << 6 | (*p++ & 0x3f);
+            }
+        }
+        return Uint16(ch);
+    }
+
+    // assume wchar_t is (widened) UTF-16
+    inline Uint16 next_char(const wchar_t*& p, const wchar_t*)
+    {
+        return Uint16(*p++);
+    }
+
+    // extent of a line of text, relative to the pen position and baseline
+    struct extent {
+        int left, right, top, bottom;
+    };
+
+    template<class Char>
+    extent measure(glyph_cache& cache, TTF_Font* font, const Char* begin, const Char* end)
+    {
+        extent e = { 0, 0, -TTF_FontAscent(font), TTF_FontHeight(font) - TTF_FontAscent(font) };
+        int pen = 0;
+        for (const Char* p = begin; p != end; ) {
+            const glyph& g = cache.metrics(font, next_char(p, end));
+            if (g.maxx > g.minx && g.maxy > g.miny) {
+                e.left = std::min(e.left, pen + g.minx);
+                e.right = std::max(e.right, pen + g.maxx);
+                e.top = std::min(e.top, -g.maxy);
+                e.bottom = std::max(e.bottom, -g.miny);
+            }
+            pen += g.advance;
+            e.right = std::max(e.right, pen);
+        }
+        return e;
+    }
+
+    inline int channel_offset(Uint8 shift, int bpp)
+    {
+        return SDL_BYTEORDER == SDL_BIG_ENDIAN ? bpp - 1 - shift / 8 : shift / 8;
+    }
+
+    inline void blend(Uint8& d, int s, int a)
+    {
+        d = Uint8(d + ((s - d) * a + 127) / 255);
+    }
+
+    inline Uint32 load_pixel(const Uint8* p, int bpp)
+    {
+        switch (bpp) {
+        case 1:
+            return *p;
+        case 2:
+            return *reinterpret_cast<const Uint16*>(p);
+        case 3:
+            if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
+                return p[0] << 16 | p[1] << 8 | p[2];
+            else
+                return p[0] | p[1] << 8 | p[2] << 16;
+        default:
+            return *reinterpret_cast<const Uint32*>(p);
+        }
+    }
+
+    inline void store_pixel(Uint8* p, int bpp, Uint32 v)
+    {
+        switch (bpp) {
+        case 1:
+            *p = Uint8(v);
+            break;
+        case 2:
+            *reinterpret_cast<Uint16*>(p) = Uint16(v);
+            break;
+        case 3:
+            if (SDL_BYTEORDER == SDL_BIG_ENDIAN) {
+                p[0] = Uint8(v >> 16);
+                p[1] = Uint8(v >> 8);
+                p[2] = Uint8(v);
+            } else {
+                p[0] = Uint8(v);
+                p[1] = Uint8(v >> 8);
+                p[2] = Uint8(v >> 16);
+            }
+            break;
+        default:
+            *reinterpret_cast<Uint32*>(p) = v;
+            break;
+        }
+    }
+
+    // blend glyph coverage in color c onto a surface, clipped to r
+    void composite(SDL_Surface* s, SDL_Rect& r, const Uint8* src, int pitch,
+                   int x, int y, int w, int h, jacui::color c)
+    {
+        int x0 = std::max<int>(x, r.x), x1 = std::min<int>(x + w, r.x + r.w);
+        int y0 = std::max<int>(y, r.y), y1 = std::min<int>(y + h, r.y + r.h);
+
+        if (x1 <= x0 || y1 <= y0) {
+            r.w = r.h = 0;
+            return;
+        }
+
+        r.x = x0;
+        r.y = y0;
+        r.w = x1 - x0;
+        r.h = y1 - y0;
+
+        SDL_PixelFormat* fmt = s->format;
+        const int bpp = fmt->BytesPerPixel;
+        const bool bytes = bpp >= 3 && !fmt->Rloss && !fmt->Gloss && !fmt->Bloss;
+        const int ro = channel_offset(fmt->Rshift, bpp);
+        const int go = channel_offset(fmt->Gshift, bpp);
+        const int bo = channel_offset(fmt->Bshift, bpp);
+
+        for (int py = y0; py != y1; ++py) {
+            const Uint8* a = src + (py - y) * pitch + (x0 - x);
+            Uint8* d = static_cast<Uint8*>(s->pixels) + py * s->pitch + x0 * bpp;
+            for (int px = x0; px != x1; ++px, ++a, d += bpp) {
+                if (*a == 0) {
+                    continue;
+                } else if (bytes) {
+                    blend(d[ro], c.r, *a);
+                    blend(d[go], c.g, *a);
+                    blend(d[bo], c.b, *a);
+                } else {
+                    Uint8 pr, pg, pb, pa;
+                    SDL_GetRGBA(load_pixel(d, bpp), fmt, &pr, &pg, &pb, &pa);
+                    blend(pr, c.r, *a);
+                    blend(pg, c.g, *a);
+                    blend(pb, c.b, *a);
+                    store_pixel(d, bpp, SDL_MapRGBA(fmt, pr, pg, pb, pa));
+                }
+            }
+        }
+    }
+
+    // draw a line of text with its baseline at y, returns the changed area
+    template<class Char>
+    jacui::rect2d draw_text(glyph_cache& cache, TTF_Font* font, SDL_Surface* s,
+                            const Char* begin, const Char* end, jacui::color c, int x, int y)
+    {
+        SDL_Rect clip;
+        SDL_GetClipRect(s, &clip);
+
+        int x0 = clip.x + clip.w, y0 = clip.y + clip.h, x1 = clip.x, y1 = clip.y;
+
+        surface_lock lock(s);
+        bool first = true;
+        int pen = x;
+        for (const Char* p = begin; p != end; ) {
+            const glyph& g = cache.bitmap(font, next_char(p, end));
+            if (first) {
+                // like SDL_ttf, shift text right if the first glyph extends left
+                pen -= std::min(g.minx, 0);
+                first = false;
+            }
+            if (g.w) {
+                SDL_Rect r = clip;
+                composite(s, r, cache.coverage(g), cache.pitch(),
+                          pen + g.minx, y - g.maxy, g.w, g.h, c);
+                if (r.w && r.h) {
+                    x0 = std::min<int>(x0, r.x);
+                    y0 = std::min<int>(y0, r.y);
+                    x1 = std::max<int>(x1, r.x + r.w);
+                    y1 = std::max<int>(y1, r.y + r.h);
+                }
+            }
+            pen += g.advance;
+        }
+
+        return x1 > x0 && y1 > y0 ? jacui::rect2d(x0, y0, x1 - x0, y1 - y0) : jacui::rect2d();
+    }
+
+    enum { short_text = 32 };
+
+    // whether text is short and consists of characters in the glyph table
+    inline bool is_short(const char* begin, const char* end)
+    {
+        if (end - begin > short_text)
+            return false;
+        for (const char* p = begin; p != end; ++p) {
+            if (*p & 0x80)
+                return false;
+        }
+        return true;
+    }
+
+    inline bool is_short(const wchar_t* begin, const wchar_t* end)
+    {
+        if (end - begin > short_text)
+            return false;
+        for (const wchar_t* p = begin; p != end; ++p) {
+            if (Uint32(*p) >= 256)
+                return false;
+        }
+        return true;
+    }
+
+    // whether SDL_ttf kerns a font; rather than every pair, this
+    // measures all pairs of printable ASCII characters at once
+    bool has_kerning(TTF_Font* font, bool enable)
+    {
+#ifdef JACUI_TTF_KERNING
+        TTF_SetFontKerning(font, enable);
+        if (enable) {
+            std::string pairs;
+            for (char a = ' '; a <= '~'; ++a) {
+                for (char b = ' '; b <= '~'; ++b) {
+                    pairs += a;
+                    pairs += b;
+                }
+            }
+
+            int kerned = 0, unkerned = 0, height = 0;
+            TTF_SizeUTF8(font, pairs.c_str(), &kerned, &height);
+            TTF_SetFontKerning(font, 0);
+            TTF_SizeUTF8(font, pairs.c_str(), &unkerned, &height);
+            TTF_SetFontKerning(font, 1);
+            return kerned != unkerned;
+        }
+#endif
+        return false;
+    }
+
+    // assume wchar_t is (widened) UTF-16
+    inline std::vector<Uint16> ucs2(const std::wstring& text)
+    {
+        std::vector<Uint16> uc(text.begin(), text.end());
+        uc.push_back(0);
+        return uc;
+    }
+
+    // text size and rendering by SDL_ttf, for kerned fonts
+    jacui::size2d ttf_size(TTF_Font* font, const std::string& text)
+    {
+        int width = 0, height = 0;
+        if (TTF_SizeUTF8(font, text.c_str(), &width, &height) < 0)
+            throw_error("error getting text size");
+        return jacui::size2d(width, height);
+    }
+
+    jacui::size2d ttf_size(TTF_Font* font, const std::wstring& text)
+    {
+        int width = 0, height = 0;
+        if (TTF_SizeUNICODE(font, &ucs2(text)[0], &width, &height) < 0)
+            throw_error("error getting text size");
+        return jacui::size2d(width, height);
+    }
+
+    jacui::image ttf_render(TTF_Font* font, const std::string& text, jacui::color c)
+    {
+        return jacui::image(make_surface(TTF_RenderUTF8_Blended(font, text.c_str(), make_color(c))));
+    }
+
+    jacui::image ttf_render(TTF_Font* font, const std::wstring& text, jacui::color c)
+    {
+        return jacui::image(make_surface(TTF_RenderUNICODE_Blended(font, &ucs2(text)[0], make_color(c))));
+    }
+
+    // recently used text sizes
+    template<class String>
+    class size_cache {
+    public:
+        size_cache() : hits(0), misses(0), size_(0) { }
+
+        const jacui::size2d* find(const String& s)
+        {
+            typename map_type::iterator i = map_.find(s);
+            if (i == map_.end()) {
+                ++misses;
+                return 0;
+            } else {
+                ++hits;
+                list_.splice(list_.begin(), list_, i->second);
+                return &i->second->second;
+            }
+        }
+
+        void insert(const String& s, const jacui::size2d& size)
+        {
+            if (size_ == max_size) {
+                map_.erase(list_.back().first);
+                list_.pop_back();
+                --size_;
+            }
+            list_.push_front(entry_type(s, size));
+            map_[s] = list_.begin();
+            ++size_;
+        }
+
+        void clear()
+        {
+            map_.clear();
+            list_.clear();
+            size_ = 0;
+        }
+
+    public:
+        std::size_t hits;
+        std::size_t misses;
+
+    private:
+        enum { max_size = 1024 };
+
+        typedef std::pair<String, jacui::size2d> entry_type;
+        typedef std::list<entry_type> list_type;
+        typedef std::map<String, typename list_type::iterator> map_type;
+
+    private:
+        list_type list_;
+        map_type map_;
+        std::size_t size_;
+    };
+
+    template<class Char>
+    jacui::size2d text_size(glyph_cache& cache, TTF_Font* font, const Char* begin, const Char* end)
+    {
+        extent e = measure(cache, font, begin, end);
+        return jacui::size2d(e.right - e.left, e.bottom - e.top);
+    }
+
+    template<class String>
+    jacui::size2d text_size(glyph_cache& glyphs, TTF_Font* font, bool kerned, const String& text)
+    {
+        const typename String::value_type* begin = text.data();
+        return kerned ? ttf_size(font, text) : text_size(glyphs, font, begin, begin + text.size());
+    }
+
+    template<class String>
+    jacui::size2d text_size(glyph_cache& glyphs, size_cache<String>& sizes, TTF_Font* font,
+                            bool kerned, const String& text)
+    {
+        const typename String::value_type* begin = text.data();
+        const typename String::value_type* end = begin + text.size();
+
+        if (text.empty()) {
+            return jacui::size2d(0, 0);
+        } else if (is_short(begin, end)) {
+            return text_size(glyphs, font, kerned, text);
+        } else if (const jacui::size2d* p = sizes.find(text)) {
+            return *p;
+        } else {
+            jacui::size2d res = text_size(glyphs, font, kerned, text);
+            sizes.insert(text, res);
+            return res;
+        }
+    }
+
+    template<class String>
+    jacui::canvas render_text(glyph_cache& glyphs, TTF_Font* font, bool kerned,
+                              const String& text, jacui::color fg, jacui::color bg)
+    {
+        jacui::canvas res;
+        if (text.empty()) {
+            return res;
+        } else if (kerned) {
+            jacui::image tmp = ttf_render(font, text, fg);
+            res.resize(tmp.size());
+            res.fill(bg);
+            res.blit(tmp);
+        } else {
+            const typename String::value_type* begin = text.data();
+            const typename String::value_type* end = begin + text.size();
+            extent e = measure(glyphs, font, begin, end);
+            // the same box as size(), including glyphs beyond ascent and descent
+            res.resize(e.right - e.left, e.bottom - e.top);
+            res.fill(bg);
+            draw_text(glyphs, font, res.detail(), begin, end, fg, 0, -e.top);
+        }
+        return res;
+    }
+
+    template<class String>
+    void draw_string(glyph_cache& glyphs, TTF_Font* font, bool kerned, jacui::surface& s,
+                     const String& text, jacui::color c, int x, int y)
+    {
+        if (text.empty()) {
+            return;
+        } else if (kerned) {
+            s.blit(ttf_render(font, text, c), x, y - TTF_FontAscent(font));
+        } else if (SDL_Surface* dst = s.unshare()) {
+            const typename String::value_type* begin = text.data();
+            jacui::rect2d r = draw_text(glyphs, font, dst, begin, begin + text.size(), c, x, y);
+            if (!r.empty())
+                s.damage(r);
+        }
+    }
 }
 
 namespace jacui {
     struct font::impl { 
-        // rely on std::string's efficient memory handling
-        typedef std::string buffer_type;
+        // face data is shared by all copies and sizes of a font
+        typedef detail::shared_data buffer_type;
         
-        impl(const buffer_type& buf, float ptsize)
-            : buffer(buf), font(0), size(0)
+        impl(const buffer_type& buf, float ptsize, bool kern)
+            : buffer(buf), font(0), size(0), kerning(kern), kerned(false)
         {
             resize(ptsize);
         }
 
         impl(const void* data, std::size_t size, float ptsize)
-            : buffer(static_cast<const char*>(data), size), font(0), size(0)
+            : buffer(data, size), font(0), size(0), kerning(true), kerned(false)
         {
             resize(ptsize);
         }
 
         impl(const char* filename, float ptsize)
-            : font(0), size(0)
+            : buffer(buffer_type::map(filename)), font(0), size(0), kerning(true), kerned(false)
         {
-            std::ifstream is(filename);
-            std::istreambuf_iterator<char> i(is);
-            std::istreambuf_iterator<char> end;
-            buffer.reserve(65536); // actually a quite small ttf
-            std::copy(i, end, std::back_inserter(buffer));
             resize(ptsize);
         }
 
@@ -116,20 +630,30 @@ namespace jacui {
                 TTF_CloseFont(font);
             font = f;
             size = ptsize;
+            kerned = has_kerning(f, kerning);
+            glyphs.clear();
+            sizes.clear();
+            wsizes.clear();
         }
 
         buffer_type buffer;
         TTF_Font* font;
         float size;
+        bool kerning;
+        // kerned fonts are rendered by SDL_ttf, not from the glyph cache
+        bool kerned;
+        glyph_cache glyphs;
+        size_cache<std::string> sizes;
+        size_cache<std::wstring> wsizes;
     };
 
     font::font(const font& rhs)
-        : pimpl_(new impl(rhs.pimpl_->buffer, rhs.pimpl_->size))
+        : pimpl_(new impl(rhs.pimpl_->buffer, rhs.pimpl_->size, rhs.pimpl_->kerning))
     {
     }
 
     font::font(const font& rhs, float ptsize)
-        : pimpl_(new impl(rhs.pimpl_->buffer, ptsize))
+        : pimpl_(new impl(rhs.pimpl_->buffer, ptsize, rhs.pimpl_->kerning))
     {
     }
 
@@ -183,56 +707,46 @@ namespace jacui {
         return std::max(TTF_FontLineSkip(pimpl_->font) - TTF_FontHeight(pimpl_->font), 0);
     }
 
+    bool font::kerning() const
+    {
+        return pimpl_->kerned;
+    }
+
+    void font::kerning(bool enable)
+    {
+        pimpl_->kerning = enable;
+        pimpl_->kerned = has_kerning(pimpl_->font, enable);
+        pimpl_->sizes.clear();
+        pimpl_->wsizes.clear();
+    }
+
     size2d font::size(const std::string& text) const
     {
-        int width = 0, height = 0;
-        if (!text.empty()) {
-            if (TTF_SizeUTF8(pimpl_->font, text.c_str(), &width, &height) < 0) {
-                throw_error("error getting text size");
-            }
-        }
-        return size2d(width, height);
+        return text_size(pimpl_->glyphs, pimpl_->sizes, pimpl_->font, pimpl_->kerned, text);
     }
 
     size2d font::size(const std::wstring& text) const
     {
-        int width = 0, height = 0;
-        if (!text.empty()) {
-            // assume wchar_t is (widened) UTF-16
-            std::vector<Uint16> uc(text.begin(), text.end());
-            uc.push_back(0);
+        return text_size(pimpl_->glyphs, pimpl_->wsizes, pimpl_->font, pimpl_->kerned, text);
+    }
 
-            if (TTF_SizeUNICODE(pimpl_->font, &uc[0], &width, &height) < 0) {
-                throw_error("error getting text size");
-            }
-        }
-        return size2d(width, height);
+    font::cache_stats font::stats() const
+    {
+        cache_stats res = {
+            pimpl_->sizes.hits + pimpl_->wsizes.hits, 
+            pimpl_->sizes.misses + pimpl_->wsizes.misses
+        };
+        return res;
     }
 
     canvas font::render(const std::string& text, color fg, color bg) const
     {
-        canvas res;
-        if (!text.empty()) {
-            rendered tmp(pimpl_->font, text.c_str(), make_color(fg), make_color(bg));
-            res.resize(tmp.size());
-            res.blit(tmp);
-        }
-        return res;
+        return render_text(pimpl_->glyphs, pimpl_->font, pimpl_->kerned, text, fg, bg);
     }
 
     canvas font::render(const std::wstring& text, color fg, color bg) const
     {
-        canvas res;
-        if (!text.empty()) {
-            // assume wchar_t is (widened) UTF-16
-            std::vector<Uint16> uc(text.begin(), text.end());
-            uc.push_back(0);
-
-            rendered tmp(pimpl_->font, &uc[0], make_color(fg), make_color(bg));
-            res.resize(tmp.size());
-            res.blit(tmp);
-        }
-        return res;
+        return render_text(pimpl_->glyphs, pimpl_->font, pimpl_->kerned, text, fg, bg);
     }
 
     void font::draw(surface& s, const std::string& text, color c, const point2d& p) const
@@ -247,22 +761,12 @@ namespace jacui {
 
     void font::draw(surface& s, const std::string& text, color c, int x, int y) const
     {
-        if (!text.empty()) {
-            rendered tmp(pimpl_->font, text.c_str(), make_color(c));
-            s.blit(tmp, x, y - TTF_FontAscent(pimpl_->font));
-        }
+        draw_string(pimpl_->glyphs, pimpl_->font, pimpl_->kerned, s, text, c, x, y);
     }
 
     void font::draw(surface& s, const std::wstring& text, color c, int x, int y) const
     {
-        if (!text.empty()) {
-            // assume wchar_t is (widened) UTF-16
-            std::vector<Uint16> uc(text.begin(), text.end());
-            uc.push_back(0);
-
-            rendered tmp(pimpl_->font, &uc[0], make_color(c));
-            s.blit(tmp, x, y - TTF_FontAscent(pimpl_->font));
-        }
+        draw_string(pimpl_->glyphs, pimpl_->font, pimpl_->kerned, s, text, c, x, y);
     }
 
     void font::resize(float ptsize)
@@ -27,13 +27,99 @@
  */
 
 #include "jacui/image.hpp"
+#include "jacui/window.hpp"
 #include "detail.hpp"
 
 #include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
 
 #include <SDL_image.h>
 
 namespace {
+    typedef std::map<SDL_Surface*, jacui::detail::shared_data> attachment_map;
+
+    // mip levels built so far, each half the size of the previous
+    typedef std::vector<jacui::detail::surface_type*> mip_chain;
+
+    typedef std::map<SDL_Surface*, mip_chain> mipmap_map;
+
+    // guards reference counts of shared surfaces, their attachments
+    // and their mip levels
+    SDL_mutex* surface_mutex()
+    {
+        static SDL_mutex* mutex = SDL_CreateMutex();
+        return mutex;
+    }
+
+    // create the mutex during static initialization, before any
+    // thread can race for it
+    SDL_mutex* const init_surface_mutex = surface_mutex();
+
+    attachment_map& get_attachments()
+    {
+        static attachment_map attachments;
+        return attachments;
+    }
+
+    mipmap_map& get_mipmaps()
+    {
+        static mipmap_map mipmaps;
+        return mipmaps;
+    }
+
+    typedef std::set<jacui::image_future::state*> load_set;
+
+    // guards the event queues of pending loads
+    SDL_mutex* load_mutex()
+    {
+        static SDL_mutex* mutex = SDL_CreateMutex();
+        return mutex;
+    }
+
+    // likewise created before any thread starts
+    SDL_mutex* const init_load_mutex = load_mutex();
+
+    // pending loads which post to an event queue when finished
+    load_set& get_loads()
+    {
+        static load_set loads;
+        return loads;
+    }
+
+    // whether averaging bytes averages color channels
+    bool is_halvable(const SDL_Surface* p)
+    {
+        const SDL_PixelFormat* f = p->format;
+        return (f->BytesPerPixel == 3 || f->BytesPerPixel == 4) && !f->palette
+            && !f->Rloss && !f->Gloss && !f->Bloss && (!f->Amask || !f->Aloss)
+            && !(p->flags & SDL_SRCCOLORKEY);
+    }
+
+    jacui::detail::surface_type* halve_surface(SDL_Surface* p)
+    {
+        const SDL_PixelFormat* f = p->format;
+        jacui::image tmp(jacui::detail::make_surface(
+            SDL_CreateRGBSurface(SDL_SWSURFACE, (p->w + 1) / 2, (p->h + 1) / 2, f->BitsPerPixel,
+                                 f->Rmask, f->Gmask, f->Bmask, f->Amask)
+            ));
+        jacui::detail::surface_type* q = tmp.detail();
+        if (p->flags & SDL_SRCALPHA)
+            SDL_SetAlpha(q, SDL_SRCALPHA, f->alpha);
+
+        jacui::detail::surface_lock lock(p);
+        jacui::detail::halve(p, q);
+        return jacui::detail::share_surface(q);
+    }
+
+    void free_levels(const mip_chain& levels)
+    {
+        for (mip_chain::const_iterator i = levels.begin(); i != levels.end(); ++i)
+            jacui::detail::free_surface(*i);
+    }
+
     jacui::detail::surface_type* load_image(const char* filename)
     {
         return jacui::detail::make_surface(IMG_Load(filename));
@@ -45,9 +131,193 @@ namespace {
             IMG_Load_RW(jacui::detail::make_rwops(data, size), 1)
             );
     }
+
+    jacui::detail::surface_type* display_image(SDL_Surface* p)
+    {
+        if (p->format->Amask || p->flags & SDL_SRCALPHA) {
+            return jacui::detail::make_surface(SDL_DisplayFormatAlpha(p));
+        } else {
+            return jacui::detail::make_surface(SDL_DisplayFormat(p));
+        }
+    }
 }
 
 namespace jacui {
+    namespace detail {
+        surface_type* share_surface(surface_type* p)
+        {
+            if (p) {
+                mutex_lock lock(surface_mutex());
+                ++p->refcount;
+            }
+            return p;
+        }
+
+        surface_type* lazy_copy(surface_type* p)
+        {
+            if (!p || !(p->flags & SDL_PREALLOC))
+                return share_surface(p);
+
+            // the caller may change external pixels behind our back
+            surface_type* q = copy_surface(p);
+            if (has_mipmaps(p))
+                enable_mipmaps(q, true);
+            return q;
+        }
+
+        bool is_unique(surface_type* p)
+        {
+            mutex_lock lock(surface_mutex());
+            return p->refcount == 1;
+        }
+
+        surface_type* unshare_surface(surface_type* p)
+        {
+            if (is_unique(p))
+                return p;
+
+            // other references only read the surface, so it cannot
+            // change while it is being copied
+            image tmp(copy_surface(p));
+            SDL_SetClipRect(tmp.detail(), &p->clip_rect);
+            if (has_mipmaps(p))
+                enable_mipmaps(tmp.detail(), true);
+            free_surface(p);
+            return share_surface(tmp.detail());
+        }
+
+        void free_surface(surface_type* p)
+        {
+            shared_data data;
+            mip_chain levels;
+            {
+                mutex_lock lock(surface_mutex());
+                if (--p->refcount > 0)
+                    return;
+                p->refcount = 1;
+
+                // only surfaces with external pixels have attachments
+                if (p->flags & SDL_PREALLOC) {
+                    attachment_map::iterator i = get_attachments().find(p);
+                    if (i != get_attachments().end()) {
+                        data.swap(i->second);
+                        get_attachments().erase(i);
+                    }
+                }
+
+                if (!get_mipmaps().empty()) {
+                    mipmap_map::iterator i = get_mipmaps().find(p);
+                    if (i != get_mipmaps().end()) {
+                        levels.swap(i->second);
+                        get_mipmaps().erase(i);
+                    }
+                }
+            }
+            free_levels(levels);
+            if (!recycle_surface(p))
+                SDL_FreeSurface(p);
+        }
+
+        void attach_data(surface_type* p, const shared_data& data)
+        {
+            mutex_lock lock(surface_mutex());
+            get_attachments()[p] = data;
+        }
+
+        void enable_mipmaps(surface_type* p, bool enable)
+        {
+            mip_chain levels;
+            {
+                mutex_lock lock(surface_mutex());
+                if (enable) {
+                    get_mipmaps()[p];
+                } else {
+                    mipmap_map::iterator i = get_mipmaps().find(p);
+                    if (i != get_mipmaps().end()) {
+                        levels.swap(i->second);
+                        get_mipmaps().erase(i);
+                    }
+                }
+            }
+            free_levels(levels);
+        }
+
+        bool has_mipmaps(surface_type* p)
+        {
+            mutex_lock lock(surface_mutex());
+            return get_mipmaps().find(p) != get_mipmaps().end();
+        }
+
+        void clear_mipmaps(surface_type* p)
+        {
+            mip_chain levels;
+            {
+                mutex_lock lock(surface_mutex());
+                if (get_mipmaps().empty())
+                    return;
+                mipmap_map::iterator i = get_mipmaps().find(p);
+                if (i != get_mipmaps().end())
+                    levels.swap(i->second);
+            }
+            free_levels(levels);
+        }
+
+        surface_type* mipmap(surface_type* p, SDL_Rect& srcrect, const SDL_Rect& dstrect)
+        {
+            std::size_t n = 0;
+            while (dstrect.w > 0 && dstrect.h > 0 &&
+                   srcrect.w >> (n + 1) >= dstrect.w && srcrect.h >> (n + 1) >= dstrect.h)
+                ++n;
+            if (n == 0 || !is_halvable(p))
+                return 0;
+
+            surface_type* level = 0;
+            while (!level) {
+                surface_type* base;
+                std::size_t built;
+                {
+                    mutex_lock lock(surface_mutex());
+                    mipmap_map::iterator i = get_mipmaps().find(p);
+                    if (i == get_mipmaps().end())
+                        return 0;
+                    built = i->second.size();
+                    base = built ? i->second.back() : p;
+                    if (built >= n)
+                        level = i->second[n - 1];
+                    ++(level ? level : base)->refcount;
+                }
+
+                if (!level) {
+                    // build the next level without holding the lock
+                    image ref(base);
+                    surface_type* next = halve_surface(base);
+                    {
+                        mutex_lock lock(surface_mutex());
+                        mipmap_map::iterator i = get_mipmaps().find(p);
+                        if (i != get_mipmaps().end() && i->second.size() == built) {
+                            i->second.push_back(next);
+                            next = 0;
+                        }
+                    }
+                    if (next)
+                        free_surface(next); // disabled or built by another thread
+                }
+            }
+
+            // scale the source rectangle, rounding to the nearest level pixel
+            const int half = 1 << (n - 1);
+            const int x0 = (srcrect.x + half) >> n;
+            const int y0 = (srcrect.y + half) >> n;
+            const int x1 = std::min((srcrect.x + srcrect.w + half) >> n, level->w);
+            const int y1 = std::min((srcrect.y + srcrect.h + half) >> n, level->h);
+            srcrect.x = x0;
+            srcrect.y = y0;
+            srcrect.w = std::max(x1 - x0, 0);
+            srcrect.h = std::max(y1 - y0, 0);
+            return level;
+        }
+    }
+
     struct image::impl: public detail::surface_type { 
         static impl* make_impl(detail::surface_type* p) {
             return static_cast<impl*>(p);
@@ -59,7 +329,7 @@ namespace jacui {
     }
 
     image::image(const image& rhs)
-        : pimpl_(impl::make_impl(detail::copy_surface(rhs.pimpl_)))
+        : pimpl_(impl::make_impl(detail::lazy_copy(rhs.pimpl_)))
     {
     }
 
@@ -73,10 +343,31 @@ namespace jacui {
     {
     }
 
+    image::image(const char* filename, const window& w)
+        : pimpl_(0)
+    {
+        image tmp(filename);
+        tmp.optimize_for(w);
+        swap(tmp);
+    }
+
+    image::image(const void* data, std::size_t size, const window& w)
+        : pimpl_(0)
+    {
+        image tmp(data, size);
+        tmp.optimize_for(w);
+        swap(tmp);
+    }
+
+    image::image(detail::surface_type* p)
+        : pimpl_(impl::make_impl(p))
+    {
+    }
+
     image::~image()
     {
         if (pimpl_) {
-            SDL_FreeSurface(pimpl_);
+            detail::free_surface(pimpl_);
         }
     }
 
@@ -92,6 +383,46 @@ namespace jacui {
         swap(tmp);
     }
 
+    void image::load(const char* filename, const window& w)
+    {
+        image tmp(filename, w);
+        swap(tmp);
+    }
+
+    void image::load(const void* data, std::size_t size, const window& w)
+    {
+        image tmp(data, size, w);
+        swap(tmp);
+    }
+
+    void image::optimize_for(const window&)
+    {
+        if (pimpl_) {
+            image tmp;
+            tmp.pimpl_ = impl::make_impl(display_image(pimpl_));
+            tmp.mipmaps(mipmaps());
+            swap(tmp);
+        }
+    }
+
+    void image::mipmaps(bool enable)
+    {
+        // mip levels belong to the surface, which copies may share
+        if (pimpl_ && enable != mipmaps())
+            detail::enable_mipmaps(unshare(), enable);
+    }
+
+    bool image::mipmaps() const
+    {
+        return pimpl_ && detail::has_mipmaps(pimpl_);
+    }
+
+    void image::damage(const rect2d&)
+    {
+        if (pimpl_)
+            detail::clear_mipmaps(pimpl_);
+    }
+
     void image::swap(image& rhs)
     {
         std::swap(pimpl_, rhs.pimpl_);
@@ -101,4 +432,227 @@ namespace jacui {
     {
         return pimpl_;
     }
+
+    detail::surface_type* image::unshare()
+    {
+        if (pimpl_)
+            pimpl_ = impl::make_impl(detail::unshare_surface(pimpl_));
+        return pimpl_;
+    }
+
+    struct image_future::state: public detail::shared_event {
+        state(const char* filename, event_queue* events)
+            : filename(filename), events(events), mutex(SDL_CreateMutex()), cond(SDL_CreateCond()),
+              job(0), done(false)
+        {
+            if (!mutex || !cond)
+                detail::throw_error("error creating image future");
+            if (events) {
+                detail::mutex_lock lock(load_mutex());
+                get_loads().insert(this);
+            }
+        }
+
+        ~state()
+        {
+            {
+                detail::mutex_lock lock(load_mutex());
+                get_loads().erase(this);
+            }
+            if (cond)
+                SDL_DestroyCond(cond);
+            if (mutex)
+                SDL_DestroyMutex(mutex);
+        }
+
+        const char* name() const
+        {
+            return "image";
+        }
+
+        void cancel()
+        {
+        }
+
+        void finish(const std::string& msg)
+        {
+            SDL_LockMutex(mutex);
+            error = msg;
+            done = true;
+            SDL_CondBroadcast(cond);
+            SDL_UnlockMutex(mutex);
+        }
+
+        std::string filename;
+        event_queue* events; // guarded by load_mutex(), cleared when the queue is destroyed
+        SDL_mutex* mutex;
+        SDL_cond* cond;
+        detail::job* job; // while queued, guarded by mutex
+        bool done;
+        image result;
+        std::string error;
+    };
+
+    namespace {
+        class load_job: public detail::job {
+        public:
+            load_job(image_future::state* p, int priority) : job(priority), state_(p)
+            {
+                state_->acquire();
+                state_->job = this;
+            }
+
+            ~load_job()
+            {
+                dequeue();
+                state_->release();
+            }
+
+            void run()
+            {
+                dequeue();
+                if (!state_->shared())
+                    return; // all futures are gone
+
+                std::string error;
+                try {
+                    image tmp(state_->filename.c_str());
+                    state_->result.swap(tmp);
+                } catch (std::exception& e) {
+                    error = e.what();
+                }
+                state_->finish(error);
+
+                // the queue cannot be destroyed while the lock is held
+                detail::mutex_lock lock(load_mutex());
+                if (event_queue* events = state_->events) {
+                    if (detail::event_queue* q = dynamic_cast<detail::event_queue*>(events))
+                        q->post(state_);
+                    else
+                        events->push(state_);
+                    state_->events = 0;
+                    get_loads().erase(state_);
+                }
+            }
+
+        private:
+            void dequeue()
+            {
+                SDL_LockMutex(state_->mutex);
+                state_->job = 0;
+                SDL_UnlockMutex(state_->mutex);
+            }
+
+        private:
+            image_future::state* state_;
+        };
+    }
+
+    image_future detail::load_async(const char* filename, jacui::event_queue* events, int priority)
+    {
+        image_future::state* p = new image_future::state(filename, events);
+        image_future res(p); // takes the initial reference
+        post_job(new load_job(p, priority));
+        return res;
+    }
+
+    void detail::reprioritize_load(const image_future& f, int priority)
+    {
+        if (image_future::state* p = f.state_) {
+            mutex_lock lock(p->mutex);
+            if (p->job)
+                reprioritize_job(p->job, priority);
+        }
+    }
+
+    void detail::detach_loads(jacui::event_queue* events)
+    {
+        mutex_lock lock(load_mutex());
+        for (load_set::iterator i = get_loads().begin(); i != get_loads().end(); ) {
+            if ((*i)->events == events) {
+                (*i)->events = 0;
+                get_loads().erase(i++);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    image_future image::load_async(const char* filename)
+    {
+        return detail::load_async(filename, 0, 0);
+    }
+
+    image_future image::load_async(const char* filename, event_queue& events)
+    {
+        return detail::load_async(filename, &events, 0);
+    }
+
+    image_future::image_future() : state_(0)
+    {
+    }
+
+    image_future::image_future(state* p) : state_(p)
+    {
+    }
+
+    image_future::image_future(const image_future& rhs) : state_(rhs.state_)
+    {
+        if (state_)
+            state_->acquire();
+    }
+
+    image_future::~image_future()
+    {
+        if (state_)
+            state_->release();
+    }
+
+    bool image_future::valid() const
+    {
+        return state_ != 0;
+    }
+
+    bool image_future::ready() const
+    {
+        if (!state_)
+            return false;
+        SDL_LockMutex(state_->mutex);
+        bool done = state_->done;
+        SDL_UnlockMutex(state_->mutex);
+        return done;
+    }
+
+    void image_future::wait() const
+    {
+        if (state_) {
+            SDL_LockMutex(state_->mutex);
+            while (!state_->done) {
+                SDL_CondWait(state_->cond, state_->mutex);
+            }
+            SDL_UnlockMutex(state_->mutex);
+        }
+    }
+
+    image image_future::get()
+    {
+        image res;
+        if (state_) {
+            wait();
+            if (!state_->error.empty())
+                throw error(state_->error);
+            res.swap(state_->result);
+        }
+        return res;
+    }
+
+    bool image_future::matches(const event* e) const
+    {
+        return state_ && e == state_;
+    }
+
+    void image_future::swap(image_future& rhs)
+    {
+        std::swap(state_, rhs.state_);
+    }
 }
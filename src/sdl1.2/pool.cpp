@@ -0,0 +1,269 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "jacui/canvas.hpp"
+#include "detail.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+
+using namespace jacui::detail;
+
+namespace {
+    struct pool_entry {
+        pool_entry(jacui::pixel_format format, const jacui::size2d& size, SDL_Surface* surface)
+            : format(format), size(size), surface(surface)
+        {
+        }
+
+        jacui::pixel_format format;
+        jacui::size2d size;
+        SDL_Surface* surface;
+    };
+
+    // most recently pooled surfaces first
+    typedef std::list<pool_entry> pool_list;
+
+    // guards the pool and its budget
+    SDL_mutex* pool_mutex()
+    {
+        static SDL_mutex* mutex = SDL_CreateMutex();
+        return mutex;
+    }
+
+    // create the mutex during static initialization, before any
+    // thread can race for it
+    SDL_mutex* const init_pool_mutex = pool_mutex();
+
+    // frees the pooled surfaces at exit
+    struct surface_pool {
+        ~surface_pool()
+        {
+            for (pool_list::iterator i = entries.begin(); i != entries.end(); ++i)
+                SDL_FreeSurface(i->surface);
+        }
+
+        pool_list entries;
+    };
+
+    pool_list& get_pool()
+    {
+        static surface_pool pool;
+        return pool.entries;
+    }
+
+    std::size_t pool_budget = 0;
+
+    std::size_t pool_bytes = 0;
+
+    // surfaces made by acquire_surface() keep the number of rows
+    // allocated in SDL's otherwise unused field, other surfaces
+    // leave it 0
+    inline bool from_pool(const SDL_Surface* p)
+    {
+        return p->unused1 != 0;
+    }
+
+    // the pixels a surface made by acquire_surface() has room for,
+    // as many as fit into its pitch
+    inline jacui::size2d allocated(const SDL_Surface* p)
+    {
+        return jacui::size2d(p->pitch / p->format->BytesPerPixel, p->unused1);
+    }
+
+    // the pixels a new surface of some size has room for, with its
+    // pitch rounded up like SDL's
+    inline jacui::size2d allocated(const jacui::size2d& size, jacui::pixel_format format)
+    {
+        const std::size_t bpp = format == jacui::rgb888 ? 3 : 4;
+        return jacui::size2d((size.width * bpp + 3) / 4 * 4 / bpp, size.height);
+    }
+
+    std::size_t surface_bytes(const SDL_Surface* p)
+    {
+        return std::size_t(p->pitch) * p->unused1;
+    }
+
+    // round up to 4, 5, 6 or 7 times a power of two, wasting at most a
+    // quarter, so surfaces of similar sizes share a size class
+    std::size_t size_class(std::size_t n)
+    {
+        if (n <= 8)
+            return n;
+
+        int shift = 0;
+        while ((n - 1) >> shift >= 8)
+            ++shift;
+        return (((n - 1) >> shift) + 1) << shift;
+    }
+
+    jacui::pixel_format format_of(const SDL_Surface* p)
+    {
+        if (p->format->BytesPerPixel == 3)
+            return jacui::rgb888;
+        return p->format->Amask ? jacui::argb8888 : jacui::xrgb8888;
+    }
+
+    // clear the pixels of a surface that lie outside the old size
+    void clear_exposed(SDL_Surface* p, const jacui::size2d& old)
+    {
+        surface_lock lock(p);
+
+        const std::size_t bpp = p->format->BytesPerPixel;
+        const std::size_t rows = std::min<std::size_t>(old.height, p->h);
+        Uint8* pixels = static_cast<Uint8*>(p->pixels);
+
+        if (std::size_t(p->w) > old.width) {
+            for (std::size_t y = 0; y != rows; ++y)
+                std::memset(pixels + y * p->pitch + old.width * bpp, 0, (p->w - old.width) * bpp);
+        }
+        for (std::size_t y = rows; y < std::size_t(p->h); ++y)
+            std::memset(pixels + y * p->pitch, 0, p->w * bpp);
+    }
+
+    void set_size(SDL_Surface* p, const jacui::size2d& size)
+    {
+        p->w = size.width;
+        p->h = size.height;
+        SDL_SetClipRect(p, 0);
+    }
+
+    // free pooled surfaces until the pool fits into a budget
+    void evict(std::size_t budget)
+    {
+        pool_list victims;
+        {
+            mutex_lock lock(pool_mutex());
+            while (pool_bytes > budget) {
+                pool_bytes -= surface_bytes(get_pool().back().surface);
+                victims.splice(victims.begin(), get_pool(), --get_pool().end());
+            }
+        }
+        for (pool_list::iterator i = victims.begin(); i != victims.end(); ++i)
+            SDL_FreeSurface(i->surface);
+    }
+}
+
+namespace jacui {
+    namespace detail {
+        surface_type* acquire_surface(const size2d& size, const size2d& capacity, pixel_format format)
+        {
+            size2d alloc(std::max(size.width, capacity.width), std::max(size.height, capacity.height));
+            SDL_Surface* p = 0;
+            {
+                mutex_lock lock(pool_mutex());
+                if (pool_budget) {
+                    alloc = size2d(size_class(alloc.width), size_class(alloc.height));
+                    const size2d pooled = allocated(alloc, format);
+                    for (pool_list::iterator i = get_pool().begin(); i != get_pool().end(); ++i) {
+                        if (i->format == format && i->size == pooled) {
+                            p = i->surface;
+                            pool_bytes -= surface_bytes(p);
+                            get_pool().erase(i);
+                            break;
+                        }
+                    }
+                }
+            }
+
+            if (p) {
+                // pooled surfaces may have been drawn onto with
+                // blending disabled, restore a fresh surface
+                SDL_SetColorKey(p, 0, 0);
+                SDL_SetAlpha(p, p->format->Amask ? SDL_SRCALPHA : 0, SDL_ALPHA_OPAQUE);
+                set_size(p, size);
+                clear_exposed(p, size2d(0, 0));
+                return make_surface(p);
+            }
+
+            // SDL's pitch is 16 bits
+            if (alloc.width * (format == rgb888 ? 3 : 4) > 0xffff)
+                alloc.width = size.width;
+
+            canvas tmp(make_surface(alloc.width, alloc.height, format));
+            tmp.detail()->unused1 = alloc.height;
+            set_size(tmp.detail(), size);
+            return share_surface(tmp.detail());
+        }
+
+        bool recycle_surface(surface_type* p)
+        {
+            if (!from_pool(p))
+                return false;
+
+            std::size_t budget;
+            {
+                mutex_lock lock(pool_mutex());
+                const std::size_t bytes = surface_bytes(p);
+                if (bytes > pool_budget)
+                    return false;
+                get_pool().push_front(pool_entry(format_of(p), allocated(p), p));
+                pool_bytes += bytes;
+                budget = pool_budget;
+            }
+            evict(budget);
+            return true;
+        }
+
+        size2d surface_capacity(surface_type* p)
+        {
+            return from_pool(p) ? allocated(p) : size2d(p->w, p->h);
+        }
+
+        bool resize_surface(surface_type* p, const size2d& size)
+        {
+            // other surfaces' sizes belong to SDL or to external pixels
+            if (!from_pool(p) || !is_unique(p))
+                return false;
+
+            const size2d old(p->w, p->h);
+            const size2d capacity = allocated(p);
+            if (size.width > capacity.width || size.height > capacity.height)
+                return false;
+            set_size(p, size);
+            clear_exposed(p, old);
+            return true;
+        }
+    }
+
+    std::size_t canvas::pool_budget()
+    {
+        mutex_lock lock(pool_mutex());
+        return ::pool_budget;
+    }
+
+    void canvas::pool_budget(std::size_t bytes)
+    {
+        {
+            mutex_lock lock(pool_mutex());
+            ::pool_budget = bytes;
+        }
+        evict(bytes);
+    }
+}
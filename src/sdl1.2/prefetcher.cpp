@@ -0,0 +1,288 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "jacui/prefetcher.hpp"
+#include "jacui/window.hpp"
+#include "detail.hpp"
+
+#include <map>
+#include <set>
+
+namespace {
+    std::size_t image_bytes(const jacui::image& img)
+    {
+        SDL_Surface* s = img.detail();
+        return s ? std::size_t(s->h) * s->pitch : 0;
+    }
+}
+
+namespace jacui {
+    struct image_prefetcher::impl {
+        struct entry {
+            entry() : priority(0), loaded(false) { }
+
+            image_future future;
+            image img;
+            std::string error;
+            int priority;
+            bool loaded;
+        };
+
+        typedef std::map<std::size_t, entry> map_type;
+
+        impl(const std::vector<std::string>& files, event_queue* events,
+             std::size_t ahead, std::size_t behind, std::size_t budget)
+            : files(files), events(events), ahead(ahead), behind(behind), budget(budget),
+              index(0), forward(true), window(0)
+        {
+            if (files.empty())
+                throw error("no image files");
+            schedule();
+        }
+
+        // the indices to keep, most important first
+        std::vector<std::size_t> wanted() const
+        {
+            std::vector<std::size_t> res;
+            std::set<std::size_t> seen;
+            std::size_t n = files.size();
+
+            res.push_back(index);
+            seen.insert(index);
+
+            for (std::size_t d = 1; d <= std::max(ahead, behind); ++d) {
+                std::size_t next = (index + d) % n;
+                std::size_t prev = (index + n - d % n) % n;
+
+                if (forward) {
+                    if (d <= ahead && seen.insert(next).second)
+                        res.push_back(next);
+                    if (d <= behind && seen.insert(prev).second)
+                        res.push_back(prev);
+                } else {
+                    if (d <= behind && seen.insert(prev).second)
+                        res.push_back(prev);
+                    if (d <= ahead && seen.insert(next).second)
+                        res.push_back(next);
+                }
+            }
+            return res;
+        }
+
+        // start and cancel loads for the current position
+        void schedule()
+        {
+            std::vector<std::size_t> keep = wanted();
+
+            // estimate sizes of pending images from decoded ones
+            std::size_t total = 0, count = 0;
+            for (map_type::const_iterator i = entries.begin(); i != entries.end(); ++i) {
+                if (i->second.loaded && i->second.img.detail()) {
+                    total += image_bytes(i->second.img);
+                    ++count;
+                }
+            }
+            std::size_t estimate = count ? total / count : 0;
+
+            std::size_t used = 0, rank = 0;
+            for (; rank != keep.size(); ++rank) {
+                map_type::const_iterator i = entries.find(keep[rank]);
+                std::size_t n = i != entries.end() && i->second.loaded 
+                    ? image_bytes(i->second.img) : estimate;
+                if (rank != 0 && used + n > budget)
+                    break;
+                used += n;
+            }
+            keep.resize(rank);
+
+            std::set<std::size_t> keepset(keep.begin(), keep.end());
+            for (map_type::iterator i = entries.begin(); i != entries.end(); ) {
+                if (keepset.count(i->first))
+                    ++i;
+                else
+                    entries.erase(i++); // drops the future, cancelling the load
+            }
+
+            // loads still queued move up or down with their rank, e.g.
+            // when the direction changes
+            for (std::size_t r = 0; r != keep.size(); ++r) {
+                entry& e = entries[keep[r]];
+                if (e.loaded) {
+                    continue;
+                } else if (!e.future.valid()) {
+                    e.future = detail::load_async(files[keep[r]].c_str(), events, -int(r));
+                    e.priority = -int(r);
+                } else if (e.priority != -int(r)) {
+                    detail::reprioritize_load(e.future, -int(r));
+                    e.priority = -int(r);
+                }
+            }
+        }
+
+        void harvest(entry& e)
+        {
+            if (!e.loaded && e.future.valid() && e.future.ready()) {
+                try {
+                    image tmp = e.future.get();
+                    if (window)
+                        tmp.optimize_for(*window);
+                    e.img.swap(tmp);
+                } catch (std::exception& ex) {
+                    e.error = ex.what();
+                }
+                e.future = image_future();
+                e.loaded = true;
+            }
+        }
+
+        void harvest()
+        {
+            for (map_type::iterator i = entries.begin(); i != entries.end(); ++i) {
+                harvest(i->second);
+            }
+        }
+
+        void seek(std::size_t n, bool fwd)
+        {
+            index = n % files.size();
+            forward = fwd;
+            harvest();
+            schedule();
+        }
+
+        std::vector<std::string> files;
+        event_queue* events;
+        std::size_t ahead;
+        std::size_t behind;
+        std::size_t budget;
+        std::size_t index;
+        bool forward;
+        const jacui::window* window;
+        map_type entries;
+    };
+
+    image_prefetcher::image_prefetcher(const std::vector<std::string>& files,
+                                       std::size_t ahead, std::size_t behind, 
+                                       std::size_t budget)
+        : pimpl_(new impl(files, 0, ahead, behind, budget))
+    {
+    }
+
+    image_prefetcher::image_prefetcher(const std::vector<std::string>& files, event_queue& events,
+                                       std::size_t ahead, std::size_t behind, 
+                                       std::size_t budget)
+        : pimpl_(new impl(files, &events, ahead, behind, budget))
+    {
+    }
+
+    image_prefetcher::~image_prefetcher()
+    {
+        delete pimpl_;
+    }
+
+    std::size_t image_prefetcher::size() const
+    {
+        return pimpl_->files.size();
+    }
+
+    std::size_t image_prefetcher::index() const
+    {
+        return pimpl_->index;
+    }
+
+    const std::string& image_prefetcher::filename() const
+    {
+        return pimpl_->files[pimpl_->index];
+    }
+
+    void image_prefetcher::seek(std::size_t index)
+    {
+        pimpl_->seek(index, index >= pimpl_->index);
+    }
+
+    void image_prefetcher::next()
+    {
+        pimpl_->seek(pimpl_->index + 1, true);
+    }
+
+    void image_prefetcher::prev()
+    {
+        pimpl_->seek(pimpl_->index + pimpl_->files.size() - 1, false);
+    }
+
+    bool image_prefetcher::ready()
+    {
+        impl::entry& e = pimpl_->entries[pimpl_->index];
+        pimpl_->harvest(e);
+        return e.loaded;
+    }
+
+    const image& image_prefetcher::current()
+    {
+        impl::entry& e = pimpl_->entries[pimpl_->index];
+        if (!e.loaded) {
+            e.future.wait();
+            pimpl_->harvest(e);
+            // a new image size may change how many fit the budget
+            pimpl_->schedule();
+        }
+        if (!e.error.empty())
+            throw error(e.error);
+        return e.img;
+    }
+
+    bool image_prefetcher::update(const event* e)
+    {
+        for (impl::map_type::iterator i = pimpl_->entries.begin(); i != pimpl_->entries.end(); ++i) {
+            if (i->second.future.matches(e)) {
+                pimpl_->harvest(i->second);
+                pimpl_->schedule();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void image_prefetcher::optimize_for(const window& w)
+    {
+        pimpl_->window = &w;
+        for (impl::map_type::iterator i = pimpl_->entries.begin(); i != pimpl_->entries.end(); ++i) {
+            if (i->second.loaded && i->second.img.detail())
+                i->second.img.optimize_for(w);
+        }
+    }
+
+    std::size_t image_prefetcher::bytes() const
+    {
+        std::size_t n = 0;
+        for (impl::map_type::const_iterator i = pimpl_->entries.begin(); i != pimpl_->entries.end(); ++i) {
+            n += image_bytes(i->second.img);
+        }
+        return n;
+    }
+}
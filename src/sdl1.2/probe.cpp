@@ -0,0 +1,269 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "jacui/image.hpp"
+#include "detail.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+using jacui::detail::byte_reader;
+
+namespace {
+    jacui::image_info make_info(std::size_t width, std::size_t height, std::size_t depth,
+                                bool alpha, std::size_t frames = 1)
+    {
+        if (!width || !height)
+            throw jacui::error("invalid image size");
+
+        jacui::image_info info;
+        info.size = jacui::size2d(width, height);
+        info.depth = depth;
+        info.alpha = alpha;
+        info.frames = frames;
+        return info;
+    }
+
+    bool is_png(const byte_reader& r)
+    {
+        return r.match(0, "\x89PNG\r\n\x1a\n", 8);
+    }
+
+    jacui::image_info probe_png(const byte_reader& r)
+    {
+        if (!r.match(12, "IHDR", 4))
+            throw jacui::error("invalid PNG file");
+
+        unsigned long type = r.u8(25);
+        unsigned long channels;
+        switch (type) {
+        case 0: // grayscale
+        case 3: // palette
+            channels = 1;
+            break;
+        case 2: // RGB
+            channels = 3;
+            break;
+        case 4: // grayscale and alpha
+            channels = 2;
+            break;
+        case 6: // RGBA
+            channels = 4;
+            break;
+        default:
+            throw jacui::error("invalid PNG color type");
+        }
+
+        jacui::image_info info = make_info(r.be32(16), r.be32(20), r.u8(24) * channels, type & 4);
+
+        // transparency and animation chunks precede the image data
+        for (std::size_t pos = 8; r.has(pos, 8); ) {
+            std::size_t len = r.be32(pos);
+            if (r.match(pos + 4, "IDAT", 4) || r.match(pos + 4, "IEND", 4) || len > r.size())
+                break;
+            if (r.match(pos + 4, "tRNS", 4))
+                info.alpha = true;
+            else if (r.match(pos + 4, "acTL", 4))
+                info.frames = r.be32(pos + 8);
+            pos += len + 12;
+        }
+        return info;
+    }
+
+    bool is_jpeg(const byte_reader& r)
+    {
+        return r.match(0, "\xff\xd8\xff", 3);
+    }
+
+    jacui::image_info probe_jpeg(const byte_reader& r)
+    {
+        for (std::size_t pos = 2; ; ) {
+            if (r.u8(pos) != 0xff)
+                throw jacui::error("invalid JPEG marker");
+            while (r.u8(pos) == 0xff)
+                ++pos;
+
+            unsigned long marker = r.u8(pos++);
+            if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd8))
+                continue; // markers without a segment
+            if (marker == 0xd9 || marker == 0xda)
+                throw jacui::error("missing JPEG frame header");
+
+            // start of frame, except DHT, JPG and DAC
+            if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc)
+                return make_info(r.be16(pos + 5), r.be16(pos + 3), r.u8(pos + 2) * r.u8(pos + 7), false);
+            pos += r.be16(pos);
+        }
+    }
+
+    bool is_gif(const byte_reader& r)
+    {
+        return r.match(0, "GIF87a", 6) || r.match(0, "GIF89a", 6);
+    }
+
+    // skip a sequence of data sub-blocks
+    std::size_t skip_blocks(const byte_reader& r, std::size_t pos)
+    {
+        while (r.has(pos, 1)) {
+            std::size_t n = r.u8(pos);
+            pos += n + 1;
+            if (!n)
+                return pos;
+        }
+        return r.size();
+    }
+
+    jacui::image_info probe_gif(const byte_reader& r)
+    {
+        unsigned long flags = r.u8(10);
+        unsigned long depth = 0;
+        std::size_t pos = 13;
+
+        if (flags & 0x80) {
+            depth = (flags & 7) + 1;
+            pos += 3 << depth;
+        }
+
+        bool alpha = false;
+        std::size_t frames = 0;
+
+        // count image descriptors; truncated files end the stream
+        while (r.has(pos, 1)) {
+            unsigned long type = r.u8(pos++);
+
+            if (type == 0x3b) {
+                break; // trailer
+            } else if (type == 0x21) {
+                // graphic control extension with transparent color
+                if (r.u8(pos) == 0xf9 && r.u8(pos + 1) >= 4 && (r.u8(pos + 2) & 1))
+                    alpha = true;
+                pos = skip_blocks(r, pos + 1);
+            } else if (type == 0x2c) {
+                flags = r.u8(pos + 8);
+                pos += 9;
+                if (flags & 0x80) {
+                    depth = std::max((flags & 7) + 1, depth);
+                    pos += 3 << ((flags & 7) + 1);
+                }
+                pos = skip_blocks(r, pos + 1);
+                ++frames;
+            } else {
+                throw jacui::error("invalid GIF block");
+            }
+        }
+
+        return make_info(r.le16(6), r.le16(8), depth ? depth : 8, alpha, frames);
+    }
+
+    bool is_bmp(const byte_reader& r)
+    {
+        return r.match(0, "BM", 2);
+    }
+
+    jacui::image_info probe_bmp(const byte_reader& r)
+    {
+        unsigned long header = r.le32(14);
+
+        if (header == 12) {
+            // OS/2 bitmap core header
+            return make_info(r.le16(18), r.le16(20), r.le16(24), false);
+        } else if (header >= 40) {
+            Sint32 width = r.le32(18);
+            Sint32 height = r.le32(22); // negative for top-down bitmaps
+            unsigned long depth = r.le16(28);
+            unsigned long compression = r.le32(30);
+
+            // alpha mask of a V3 or later header, or BI_ALPHABITFIELDS
+            bool alpha = depth == 32 && (header >= 56 || compression == 6) && r.le32(66);
+            return make_info(std::abs(width), std::abs(height), depth, alpha);
+        } else {
+            throw jacui::error("invalid BMP header");
+        }
+    }
+
+    // TGA files have no signature, so check the header for sanity
+    bool is_tga(const byte_reader& r)
+    {
+        if (!r.has(0, 18) || r.u8(1) > 1)
+            return false;
+
+        switch (r.u8(2)) {
+        case 1: case 2: case 3: case 9: case 10: case 11:
+            break;
+        default:
+            return false;
+        }
+
+        switch (r.u8(16)) {
+        case 8: case 15: case 16: case 24: case 32:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    jacui::image_info probe_tga(const byte_reader& r)
+    {
+        unsigned long type = r.u8(2);
+        unsigned long depth = r.u8(16);
+        bool alpha;
+
+        if (type == 1 || type == 9)
+            alpha = r.u8(7) == 32; // color map entry size
+        else
+            alpha = depth == 32 || (r.u8(17) & 0x0f);
+
+        return make_info(r.le16(12), r.le16(14), depth, alpha);
+    }
+}
+
+namespace jacui {
+    image_info image::probe(const char* filename)
+    {
+        detail::shared_data data = detail::shared_data::map(filename);
+        return probe(data.data(), data.size());
+    }
+
+    image_info image::probe(const void* data, std::size_t size)
+    {
+        detail::byte_reader r(data, size);
+
+        if (is_png(r))
+            return probe_png(r);
+        else if (is_jpeg(r))
+            return probe_jpeg(r);
+        else if (is_gif(r))
+            return probe_gif(r);
+        else if (is_bmp(r))
+            return probe_bmp(r);
+        else if (is_tga(r))
+            return probe_tga(r);
+        else
+            throw error("unknown image format");
+    }
+}
@@ -0,0 +1,343 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "jacui/canvas.hpp"
+#include "jacui/image.hpp"
+#include "detail.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+using jacui::detail::byte_reader;
+using jacui::detail::raw_layout;
+
+namespace {
+    // masks for RGB bytes in memory order
+    void rgb_masks(raw_layout& l)
+    {
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+        l.rmask = 0x0000ff;
+        l.gmask = 0x00ff00;
+        l.bmask = 0xff0000;
+#else
+        l.rmask = 0xff0000;
+        l.gmask = 0x00ff00;
+        l.bmask = 0x0000ff;
+#endif
+    }
+
+    // masks for BGR or BGRA bytes in memory order
+    void bgr_masks(raw_layout& l, bool alpha)
+    {
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+        l.rmask = 0x00ff0000;
+        l.gmask = 0x0000ff00;
+        l.bmask = 0x000000ff;
+        l.amask = alpha ? 0xff000000 : 0;
+#else
+        if (l.depth == 24) {
+            l.rmask = 0x0000ff;
+            l.gmask = 0x00ff00;
+            l.bmask = 0xff0000;
+        } else {
+            l.rmask = 0x0000ff00;
+            l.gmask = 0x00ff0000;
+            l.bmask = 0xff000000;
+            l.amask = alpha ? 0x000000ff : 0;
+        }
+#endif
+    }
+
+    bool is_space(unsigned long c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+    }
+
+    // binary PPM or PGM with 8 bit samples
+    bool layout_pnm(const byte_reader& r, raw_layout& l)
+    {
+        if (!r.match(0, "P6", 2) && !r.match(0, "P5", 2))
+            return false;
+
+        std::size_t pos = 2;
+        unsigned long values[3];
+
+        for (int i = 0; i != 3; ++i) {
+            for (;;) {
+                if (is_space(r.u8(pos)))
+                    ++pos;
+                else if (r.u8(pos) == '#')
+                    while (r.u8(pos) != '\n')
+                        ++pos;
+                else
+                    break;
+            }
+
+            unsigned long c = r.u8(pos);
+            if (c < '0' || c > '9')
+                return false;
+            for (values[i] = 0; c >= '0' && c <= '9'; c = r.u8(++pos)) {
+                if (values[i] > 0xffffff)
+                    return false;
+                values[i] = values[i] * 10 + (c - '0');
+            }
+        }
+
+        // samples with a maximum other than 255 would need scaling
+        if (!is_space(r.u8(pos)) || values[2] != 255)
+            return false;
+
+        l.offset = pos + 1;
+        l.width = values[0];
+        l.height = values[1];
+        l.gray = r.u8(1) == '5';
+        l.depth = l.gray ? 8 : 24;
+        l.pitch = l.width * l.depth / 8;
+        if (!l.gray)
+            rgb_masks(l);
+        return true;
+    }
+
+    // uncompressed top-down BMP
+    bool layout_bmp(const byte_reader& r, raw_layout& l)
+    {
+        if (!r.match(0, "BM", 2) || r.le32(14) < 40)
+            return false;
+
+        Sint32 width = r.le32(18);
+        Sint32 height = r.le32(22);
+        if (width <= 0 || height >= 0)
+            return false; // bottom-up rows cannot be mapped
+
+        l.offset = r.le32(10);
+        l.width = width;
+        l.height = -height;
+        l.depth = r.le16(28);
+        l.pitch = (l.width * l.depth + 31) / 32 * 4;
+
+        unsigned long compression = r.le32(30);
+        if (compression == 0 && (l.depth == 24 || l.depth == 32)) {
+            bgr_masks(l, false);
+            return true;
+        }
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+        if (compression == 3 && (l.depth == 16 || l.depth == 32)) {
+            l.rmask = r.le32(54);
+            l.gmask = r.le32(58);
+            l.bmask = r.le32(62);
+            l.amask = r.le32(14) >= 56 ? r.le32(66) : 0;
+            return true;
+        }
+#endif
+        return false;
+    }
+
+    // uncompressed TGA with a top-left origin
+    bool layout_tga(const byte_reader& r, raw_layout& l)
+    {
+        if (!r.has(0, 18) || r.u8(1) > 1 || (r.u8(17) & 0x30) != 0x20)
+            return false;
+
+        l.offset = 18 + r.u8(0);
+        if (r.u8(1))
+            l.offset += r.le16(5) * ((r.u8(7) + 7) / 8); // unused color map
+        l.width = r.le16(12);
+        l.height = r.le16(14);
+        l.depth = r.u8(16);
+        l.pitch = l.width * l.depth / 8;
+
+        if (r.u8(2) == 2 && (l.depth == 24 || l.depth == 32)) {
+            bgr_masks(l, l.depth == 32);
+            return true;
+        } else if (r.u8(2) == 3 && l.depth == 8) {
+            l.gray = true;
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    // whether the pixel rows are complete and can be read in place
+    bool fits(const byte_reader& r, const raw_layout& l)
+    {
+        std::size_t row = l.width * (l.depth / 8);
+        if (!l.width || !l.height || row > l.pitch)
+            return false;
+        if (l.depth != 24 && l.offset % (l.depth / 8))
+            return false; // misaligned pixels
+        if (!r.has(l.offset, 0) || (r.size() - l.offset) / l.pitch < l.height - 1)
+            return false;
+        return r.has(l.offset + (l.height - 1) * l.pitch, row);
+    }
+
+    bool layout_image(const byte_reader& r, raw_layout& l)
+    {
+        try {
+            return (layout_pnm(r, l) || layout_bmp(r, l) || layout_tga(r, l)) && fits(r, l);
+        } catch (const jacui::error&) {
+            return false; // leave reporting damaged files to the decoder
+        }
+    }
+
+    // canvas snapshot: a header with little endian fields, followed
+    // by page aligned pixel rows in native byte order
+    const char canvas_magic[8] = { 'J', 'C', 'A', 'N', 'V', 'A', 'S', '\0' };
+
+    const unsigned long canvas_version = 1;
+
+    const std::size_t canvas_offset = 4096;
+
+    enum { 
+        little_endian = 1, 
+        big_endian = 2, 
+        native_order = SDL_BYTEORDER == SDL_LIL_ENDIAN ? little_endian : big_endian
+    };
+
+    void put_le32(char* p, unsigned long v)
+    {
+        for (int i = 0; i != 4; ++i, v >>= 8)
+            p[i] = char(v & 0xff);
+    }
+
+    void layout_canvas(const byte_reader& r, raw_layout& l)
+    {
+        if (!r.match(0, canvas_magic, sizeof canvas_magic))
+            throw jacui::error("not a canvas file");
+        if (r.le32(8) != canvas_version)
+            throw jacui::error("unsupported canvas file version");
+        if (r.le32(12) != native_order)
+            throw jacui::error("canvas file has a different byte order");
+
+        l.depth = r.le32(16);
+        l.width = r.le32(20);
+        l.height = r.le32(24);
+        l.pitch = r.le32(28);
+        l.offset = r.le32(32);
+        l.rmask = r.le32(36);
+        l.gmask = r.le32(40);
+        l.bmask = r.le32(44);
+        l.amask = r.le32(48);
+
+        if ((l.depth != 16 && l.depth != 24 && l.depth != 32) || !fits(r, l) || !l.wrappable())
+            throw jacui::error("invalid canvas file");
+    }
+}
+
+namespace jacui {
+    namespace detail {
+        bool layout_raw(const shared_data& data, raw_layout& l)
+        {
+            return layout_image(byte_reader(data.data(), data.size()), l);
+        }
+
+        surface_type* map_surface(const shared_data& data, const raw_layout& l)
+        {
+            // writing to a copy-on-write mapping does not change the file
+            char* pixels = const_cast<char*>(static_cast<const char*>(data.data())) + l.offset;
+            surface_type* p = make_surface(
+                SDL_CreateRGBSurfaceFrom(pixels, l.width, l.height, l.depth, l.pitch,
+                                         l.rmask, l.gmask, l.bmask, l.amask)
+                );
+
+            if (l.gray) {
+                SDL_Color colors[256];
+                for (int i = 0; i != 256; ++i) {
+                    colors[i].r = colors[i].g = colors[i].b = i;
+                    colors[i].unused = 0;
+                }
+                SDL_SetColors(p, colors, 0, 256);
+            }
+            return p;
+        }
+    }
+
+    void image::map(const char* filename)
+    {
+        detail::shared_data data = detail::shared_data::map(filename, true);
+        raw_layout l;
+
+        if (detail::layout_raw(data, l) && l.wrappable()) {
+            image tmp(detail::map_surface(data, l));
+            detail::attach_data(tmp.detail(), data);
+            swap(tmp);
+        } else {
+            load(filename);
+        }
+    }
+
+    void canvas::save_raw(const char* filename) const
+    {
+        SDL_Surface* s = detail();
+        if (!s)
+            throw error("cannot save an empty canvas");
+
+        // map_raw() only restores formats with fixed masks
+        const SDL_PixelFormat* f = s->format;
+        if (f->BitsPerPixel != 16 && f->BitsPerPixel != 24 && f->BitsPerPixel != 32)
+            throw error("cannot save a canvas with a palette");
+
+        char header[canvas_offset] = { 0 };
+        std::copy(canvas_magic, canvas_magic + sizeof canvas_magic, header);
+        put_le32(header + 8, canvas_version);
+        put_le32(header + 12, native_order);
+        put_le32(header + 16, f->BitsPerPixel);
+        put_le32(header + 20, s->w);
+        put_le32(header + 24, s->h);
+        put_le32(header + 28, s->pitch);
+        put_le32(header + 32, canvas_offset);
+        put_le32(header + 36, f->Rmask);
+        put_le32(header + 40, f->Gmask);
+        put_le32(header + 44, f->Bmask);
+        put_le32(header + 48, f->Amask);
+
+        detail::surface_lock lock(s);
+        std::FILE* fp = std::fopen(filename, "wb");
+        if (!fp)
+            detail::throw_io_error("error creating canvas file", filename);
+
+        bool ok = std::fwrite(header, sizeof header, 1, fp) == 1;
+        const char* row = static_cast<const char*>(s->pixels);
+        for (int y = 0; ok && y != s->h; ++y, row += s->pitch)
+            ok = std::fwrite(row, s->pitch, 1, fp) == 1;
+        if (std::fclose(fp) != 0)
+            ok = false;
+        if (!ok)
+            detail::throw_io_error("error writing canvas file", filename);
+    }
+
+    void canvas::map_raw(const char* filename)
+    {
+        detail::shared_data data = detail::shared_data::map(filename, true);
+        raw_layout l;
+        layout_canvas(byte_reader(data.data(), data.size()), l);
+
+        canvas tmp(detail::map_surface(data, l));
+        detail::attach_data(tmp.detail(), data);
+        swap(tmp);
+    }
+}
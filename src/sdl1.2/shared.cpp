@@ -0,0 +1,430 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "jacui/shared.hpp"
+#include "jacui/error.hpp"
+#include "detail.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const char shared_magic[8] = { 'J', 'A', 'C', 'U', 'I', 'S', 'H', 'M' };
+
+    const Uint32 shared_version = 1;
+
+    // frames start on a page boundary after the header
+    const std::size_t header_size = 4096;
+
+    // the blits a reader retries before giving up on a stable frame
+    const unsigned max_attempts = 4;
+
+    // the largest frame whose size fits into the header and which
+    // can be mapped twice along with the header
+    const std::size_t max_frame_size =
+        std::min<std::size_t>(0xffffffc0, (std::size_t(-1) - header_size) / 2 & ~std::size_t(63));
+
+    struct shared_header {
+        char magic[8];
+        Uint32 version;
+        Uint32 format;
+        Uint32 width;
+        Uint32 height;
+        Uint32 pitch;
+        Uint32 frame_size;
+        volatile Uint32 sequence; // odd while publishing, 0 before the first frame
+        volatile Uint32 front;    // index of the latest published frame
+    };
+
+    inline void memory_barrier()
+    {
+#ifdef WIN32
+        MemoryBarrier();
+#else
+        __sync_synchronize();
+#endif
+    }
+
+    inline Uint32 load_sequence(const shared_header* h)
+    {
+        Uint32 seq = h->sequence;
+        memory_barrier();
+        return seq;
+    }
+
+    inline void store_sequence(shared_header* h, Uint32 seq)
+    {
+        memory_barrier();
+        h->sequence = seq;
+    }
+
+    std::size_t frame_pitch(std::size_t width, jacui::pixel_format format)
+    {
+        return (width * (format == jacui::rgb888 ? 3 : 4) + 3) & ~std::size_t(3);
+    }
+
+    std::size_t frame_size(std::size_t pitch, std::size_t height)
+    {
+        return (pitch * height + 63) & ~std::size_t(63);
+    }
+
+    // whether a frame's layout is representable, so frame_pitch()
+    // and frame_size() do not overflow
+    bool valid_frame(std::size_t width, std::size_t height, std::size_t pitch)
+    {
+        return width && height && width <= 0xffff && pitch <= 0xffff
+            && height <= max_frame_size / pitch;
+    }
+
+    void throw_shm_error(const char* msg, const char* name)
+    {
+#ifdef WIN32
+        SDL_SetError("%s: error %lu", name, GetLastError());
+        jacui::detail::throw_error(msg);
+#else
+        jacui::detail::throw_io_error(msg, name);
+#endif
+    }
+
+    struct blit_at {
+        blit_at(jacui::surface& dst, const jacui::point2d& p) : dst(dst), p(p) { }
+
+        void operator()(const jacui::canvas& frame) const
+        {
+            dst.blit(frame, p);
+        }
+
+        jacui::surface& dst;
+        jacui::point2d p;
+    };
+
+    struct blit_scaled {
+        blit_scaled(jacui::surface& dst, const jacui::rect2d& r, jacui::surface::scale_filter f)
+            : dst(dst), r(r), f(f) { }
+
+        void operator()(const jacui::canvas& frame) const
+        {
+            dst.blit(frame, r, f);
+        }
+
+        jacui::surface& dst;
+        jacui::rect2d r;
+        jacui::surface::scale_filter f;
+    };
+}
+
+namespace jacui {
+    struct shared_canvas::impl {
+        impl() : data(0), length(0), header(0), writable(false), back(0)
+        {
+#ifdef WIN32
+            handle = 0;
+#endif
+        }
+
+        ~impl()
+        {
+            // frames are preallocated surfaces and never touch their pixels when freed
+#ifdef WIN32
+            if (data)
+                UnmapViewOfFile(data);
+            if (handle)
+                CloseHandle(handle);
+#else
+            if (data)
+                munmap(data, length);
+#endif
+        }
+
+        void create(const char* name, const size2d& size, pixel_format format)
+        {
+            std::size_t pitch = size.width <= 0xffff ? frame_pitch(size.width, format) : 0;
+
+            if (!valid_frame(size.width, size.height, pitch))
+                throw error("invalid shared canvas size");
+            length = header_size + 2 * frame_size(pitch, size.height);
+
+#ifdef WIN32
+            handle = CreateFileMappingA(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, 0, length, name);
+            if (!handle)
+                throw_shm_error("error creating shared canvas", name);
+            if (!(data = MapViewOfFile(handle, FILE_MAP_WRITE, 0, 0, length)))
+                throw_shm_error("error mapping shared canvas", name);
+#else
+            int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+            if (fd == -1)
+                throw_shm_error("error creating shared canvas", name);
+            if (ftruncate(fd, length) == -1) {
+                int err = errno;
+                close(fd);
+                errno = err;
+                throw_shm_error("error creating shared canvas", name);
+            }
+            void* p = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (p == MAP_FAILED)
+                throw_shm_error("error mapping shared canvas", name);
+            data = p;
+#endif
+            header = static_cast<shared_header*>(data);
+            writable = true;
+
+            // readers reject the header until it is complete
+            std::memset(header->magic, 0, sizeof header->magic);
+            memory_barrier();
+            header->version = shared_version;
+            header->format = format;
+            header->width = size.width;
+            header->height = size.height;
+            header->pitch = pitch;
+            header->frame_size = frame_size(pitch, size.height);
+            header->sequence = 0;
+            header->front = 0;
+            memory_barrier();
+            std::memcpy(header->magic, shared_magic, sizeof header->magic);
+
+            map_frames();
+        }
+
+        void open(const char* name)
+        {
+#ifdef WIN32
+            handle = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+            if (!handle)
+                throw_shm_error("error opening shared canvas", name);
+            if (!(data = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0)))
+                throw_shm_error("error mapping shared canvas", name);
+            MEMORY_BASIC_INFORMATION info;
+            if (!VirtualQuery(data, &info, sizeof info))
+                throw_shm_error("error mapping shared canvas", name);
+            length = info.RegionSize;
+#else
+            int fd = shm_open(name, O_RDONLY, 0);
+            if (fd == -1)
+                throw_shm_error("error opening shared canvas", name);
+            struct stat st;
+            if (fstat(fd, &st) == -1) {
+                int err = errno;
+                close(fd);
+                errno = err;
+                throw_shm_error("error opening shared canvas", name);
+            }
+            if (static_cast<std::size_t>(st.st_size) < header_size) {
+                close(fd);
+                throw error("invalid shared canvas");
+            }
+            length = st.st_size;
+            void* p = mmap(0, length, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (p == MAP_FAILED)
+                throw_shm_error("error mapping shared canvas", name);
+            data = p;
+#endif
+            header = static_cast<shared_header*>(data);
+
+            if (std::memcmp(header->magic, shared_magic, sizeof header->magic) != 0)
+                throw error("invalid shared canvas");
+            memory_barrier();
+            if (header->version != shared_version
+                || header->format > argb8888
+                || !valid_frame(header->width, header->height, header->pitch)
+                || header->pitch != frame_pitch(header->width, pixel_format(header->format))
+                || header->frame_size != frame_size(header->pitch, header->height)
+                || header_size + 2 * std::size_t(header->frame_size) > length)
+                throw error("invalid shared canvas");
+
+            map_frames();
+        }
+
+        void map_frames()
+        {
+            size2d size(header->width, header->height);
+            pixel_format format = pixel_format(header->format);
+
+            for (int i = 0; i != 2; ++i) {
+                canvas tmp(frame_pixels(i), size, header->pitch, format);
+                frames[i].swap(tmp);
+            }
+        }
+
+        void* frame_pixels(unsigned i) const
+        {
+            return static_cast<char*>(data) + header_size + i * header->frame_size;
+        }
+
+        // whether a frame still draws onto shared memory
+        bool mapped(unsigned i) const
+        {
+            SDL_Surface* s = frames[i].detail();
+            return s && s->pixels == frame_pixels(i) && s->pitch == header->pitch
+                && Uint32(s->w) == header->width && Uint32(s->h) == header->height;
+        }
+
+        template<class Blit>
+        bool draw(Blit blit) const
+        {
+            for (unsigned attempt = 0; ; ++attempt) {
+                Uint32 seq = load_sequence(header);
+                if (!seq)
+                    return false;
+                blit(frames[header->front & 1]);
+                // a frame published meanwhile may have been drawn over
+                if (!(seq & 1) && load_sequence(header) == seq)
+                    return true;
+                if (attempt == max_attempts)
+                    return false;
+            }
+        }
+
+        void* data;
+        std::size_t length;
+        shared_header* header;
+        canvas frames[2];
+        bool writable;
+        unsigned back;
+#ifdef WIN32
+        HANDLE handle;
+#endif
+    };
+
+    shared_canvas::shared_canvas(const char* name, const size2d& size, pixel_format format)
+        : pimpl_(new impl())
+    {
+        try {
+            pimpl_->create(name, size, format);
+        } catch (...) {
+            delete pimpl_;
+            throw;
+        }
+    }
+
+    shared_canvas::shared_canvas(const char* name)
+        : pimpl_(new impl())
+    {
+        try {
+            pimpl_->open(name);
+        } catch (...) {
+            delete pimpl_;
+            throw;
+        }
+    }
+
+    shared_canvas::~shared_canvas()
+    {
+        delete pimpl_;
+    }
+
+    void shared_canvas::remove(const char* name)
+    {
+#ifndef WIN32
+        // named file mappings vanish with their last handle on Windows
+        if (shm_unlink(name) == -1 && errno != ENOENT)
+            throw_shm_error("error removing shared canvas", name);
+#else
+        (void)name;
+#endif
+    }
+
+    bool shared_canvas::writable() const
+    {
+        return pimpl_->writable;
+    }
+
+    size2d shared_canvas::size() const
+    {
+        return size2d(pimpl_->header->width, pimpl_->header->height);
+    }
+
+    std::size_t shared_canvas::width() const
+    {
+        return pimpl_->header->width;
+    }
+
+    std::size_t shared_canvas::height() const
+    {
+        return pimpl_->header->height;
+    }
+
+    pixel_format shared_canvas::format() const
+    {
+        return pixel_format(pimpl_->header->format);
+    }
+
+    canvas& shared_canvas::view()
+    {
+        if (!pimpl_->writable)
+            throw error("shared canvas is read-only");
+        return pimpl_->frames[pimpl_->back];
+    }
+
+    void shared_canvas::publish()
+    {
+        if (!pimpl_->writable)
+            throw error("shared canvas is read-only");
+
+        // the view has been resized or replaced, so its pixels are
+        // no longer in shared memory
+        if (!pimpl_->mapped(pimpl_->back)) {
+            pimpl_->map_frames();
+            throw error("shared canvas frame has been replaced");
+        }
+
+        shared_header* h = pimpl_->header;
+        Uint32 seq = h->sequence;
+        store_sequence(h, seq + 1);
+        memory_barrier();
+        h->front = pimpl_->back;
+        store_sequence(h, seq + 2);
+        pimpl_->back ^= 1;
+    }
+
+    unsigned long shared_canvas::generation() const
+    {
+        return load_sequence(pimpl_->header) / 2;
+    }
+
+    bool shared_canvas::draw(surface& dst, const point2d& p) const
+    {
+        return pimpl_->draw(blit_at(dst, p));
+    }
+
+    bool shared_canvas::draw(surface& dst, const rect2d& r, surface::scale_filter f) const
+    {
+        return pimpl_->draw(blit_scaled(dst, r, f));
+    }
+}
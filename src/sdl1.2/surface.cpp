@@ -28,118 +28,236 @@
 
 #include "jacui/surface.hpp"
 #include "jacui/error.hpp"
+#include "jacui/image.hpp"
 #include "detail.hpp"
 
 #include <algorithm>
-#include <cassert>
 
 using namespace jacui::detail;
 
 namespace {
-    inline jacui::color get_pixel(SDL_Surface* s, int x, int y)
+    bool is_parallel(const SDL_Rect& r)
     {
-        int bpp = s->format->BytesPerPixel;
-        /* Here p is the address to the pixel we want to retrieve */
-        Uint8 *p = static_cast<Uint8*>(s->pixels) + y * s->pitch + x * bpp;
+        return r.w * r.h >= 2 * parallel_pixels && jacui::concurrency() > 1;
+    }
 
-        switch (bpp) {
-        case 1:
-            return map_pixel(s->format, *p);
+    bool clip_rect(SDL_Rect& r, const SDL_Rect& clip)
+    {
+        int x0 = std::max(r.x, clip.x);
+        int y0 = std::max(r.y, clip.y);
+        int x1 = std::min(r.x + r.w, clip.x + clip.w);
+        int y1 = std::min(r.y + r.h, clip.y + clip.h);
+
+        if (x1 <= x0 || y1 <= y0) {
+            r.w = r.h = 0;
+            return false;
+        } else {
+            r.x = x0;
+            r.y = y0;
+            r.w = x1 - x0;
+            r.h = y1 - y0;
+            return true;
+        }
+    }
 
-        case 2:
-            return map_pixel(s->format, *reinterpret_cast<Uint16*>(p));
+    template<class T>
+    void fill_rows(Uint8* p, int pitch, int w, int h, T v)
+    {
+        for (int y = 0; y != h; ++y, p += pitch) {
+            std::fill_n(reinterpret_cast<T*>(p), w, v);
+        }
+    }
 
-        case 3:
-            if(SDL_BYTEORDER == SDL_BIG_ENDIAN)
-                return map_pixel(s->format, p[0] << 16 | p[1] << 8 | p[2]);
-            else
-                return map_pixel(s->format, p[0] | p[1] << 8 | p[2] << 16);
+    struct fill_band {
+        fill_band(SDL_Surface* s, const SDL_Rect& r, Uint32 v) : s(s), r(r), v(v) { }
+
+        void operator()(int begin, int end) {
+            const int bpp = s->format->BytesPerPixel;
+            Uint8* p = static_cast<Uint8*>(s->pixels) + (r.y + begin) * s->pitch + r.x * bpp;
+
+            switch (bpp) {
+            case 1:
+                fill_rows(p, s->pitch, r.w, end - begin, Uint8(v));
+                break;
+            case 2:
+                fill_rows(p, s->pitch, r.w, end - begin, Uint16(v));
+                break;
+            case 3:
+                for (int y = begin; y != end; ++y, p += s->pitch) {
+                    for (int x = 0; x != r.w; ++x) {
+                        Uint8* q = p + x * 3;
+                        if (SDL_BYTEORDER == SDL_BIG_ENDIAN) {
+                            q[0] = (v >> 16) & 0xff;
+                            q[1] = (v >> 8) & 0xff;
+                            q[2] = v & 0xff;
+                        } else {
+                            q[0] = v & 0xff;
+                            q[1] = (v >> 8) & 0xff;
+                            q[2] = (v >> 16) & 0xff;
+                        }
+                    }
+                }
+                break;
+            case 4:
+                fill_rows(p, s->pitch, r.w, end - begin, Uint32(v));
+                break;
+            }
+        }
 
-        case 4:
-            return map_pixel(s->format, *reinterpret_cast<Uint32*>(p));
+        SDL_Surface* s;
+        SDL_Rect r;
+        Uint32 v;
+    };
 
-        default:
-            return jacui::color();
+    void fill_surface(SDL_Surface* s, SDL_Rect* rect, Uint32 pixel)
+    {
+        if (!(s->flags & SDL_HWSURFACE) && is_parallel(*rect)) {
+            SDL_Rect clip;
+            SDL_GetClipRect(s, &clip);
+            if (clip_rect(*rect, clip)) {
+                surface_lock lock(s);
+                fill_band band(s, *rect, pixel);
+                parallel_for(rect->h, parallel_rows(rect->w), band);
+            }
+        } else if (SDL_FillRect(s, rect, pixel) < 0) {
+            throw_error("error filling surface");
         }
     }
 
-    inline void set_pixel(SDL_Surface* s, int x, int y, const jacui::color& c)
+    // whether a format has 8 bit channels, which convert exactly like SDL
+    bool has_byte_channels(const SDL_PixelFormat* f)
     {
-        int bpp = s->format->BytesPerPixel;
-        /* Here p is the address to the pixel we want to set */
-        Uint8 *p = static_cast<Uint8*>(s->pixels) + y * s->pitch + x * bpp;
-
-        Uint32 pixel = map_color(s->format, c);
-
-        switch(bpp) {
-        case 1:
-            *p = pixel;
-            break;
-
-        case 2:
-            *reinterpret_cast<Uint16*>(p) = pixel;
-            break;
-
-        case 3:
-            if(SDL_BYTEORDER == SDL_BIG_ENDIAN) {
-                p[0] = (pixel >> 16) & 0xff;
-                p[1] = (pixel >> 8) & 0xff;
-                p[2] = pixel & 0xff;
-            } else {
-                p[0] = pixel & 0xff;
-                p[1] = (pixel >> 8) & 0xff;
-                p[2] = (pixel >> 16) & 0xff;
-            }
-            break;
-
-        case 4:
-            *reinterpret_cast<Uint32*>(p) = pixel;
-            break;
-        }
+        return (f->BytesPerPixel == 3 || f->BytesPerPixel == 4) && !f->palette
+            && !f->Rloss && !f->Gloss && !f->Bloss && (!f->Amask || !f->Aloss);
     }
 
-    void warp(SDL_Surface* src, SDL_Rect* srcrect, SDL_Surface* dst, SDL_Rect* dstrect) {
-        assert(src && srcrect->x >= 0 && srcrect->y >= 0);
-        assert(dst && dstrect->x >= 0 && dstrect->y >= 0);
+    bool is_conversion(SDL_Surface* src, SDL_Surface* dst)
+    {
+        const SDL_PixelFormat* sf = src->format;
+        const SDL_PixelFormat* df = dst->format;
+
+        // leave alpha blending, color keys, palettes and channels
+        // wider or narrower than 8 bits to SDL
+        if (src->flags & (SDL_SRCALPHA | SDL_SRCCOLORKEY) || !has_byte_channels(sf) || !has_byte_channels(df))
+            return false;
+        return sf->BytesPerPixel != df->BytesPerPixel
+            || sf->Rmask != df->Rmask
+            || sf->Gmask != df->Gmask
+            || sf->Bmask != df->Bmask
+            || sf->Amask != df->Amask;
+    }
 
+    void blit_surface(SDL_Surface* src, SDL_Rect* srcrect, SDL_Surface* dst, SDL_Rect* dstrect)
+    {
+        // clip source like SDL_BlitSurface, destination size follows
         if (srcrect->x + srcrect->w > src->w)
-            srcrect->w = src->w - srcrect->w;
+            srcrect->w = std::max(src->w - srcrect->x, 0);
         if (srcrect->y + srcrect->h > src->h)
-            srcrect->y = src->h - srcrect->y;
-        if (srcrect->w <= 0 || srcrect->h <= 0)
-            return;
-
-        SDL_Rect clip;
-        SDL_GetClipRect(dst, &clip);
-
-        int dx = dstrect->x + dstrect->w;
-        int dy = dstrect->y + dstrect->h;
-        dstrect->x = std::max(dstrect->x, clip.x);
-        dstrect->y = std::max(dstrect->y, clip.y);
-        dstrect->w = std::max(std::min(dx, clip.x + clip.w) - dstrect->x, 0);
-        dstrect->h = std::max(std::min(dy, clip.y + clip.h) - dstrect->y, 0);
-        
-        if (dstrect->w <= 0 || dstrect->h <= 0)
-            return;
-
-        for (int y = 0; y != dstrect->h; ++y) {
-            for (int x = 0; x != dstrect->w; ++x) {
-                int srcx = srcrect->x + x * srcrect->w / dstrect->w;
-                int srcy = srcrect->y + y * srcrect->h / dstrect->h;
-                int dstx = dstrect->x + x;
-                int dsty = dstrect->y + y;
-
-                set_pixel(dst, dstx, dsty, get_pixel(src, srcx, srcy));
-            }
+            srcrect->h = std::max(src->h - srcrect->y, 0);
+
+        if (dstrect->x >= 0 && dstrect->y >= 0 && is_parallel(*srcrect) && is_conversion(src, dst)) {
+            dstrect->w = srcrect->w;
+            dstrect->h = srcrect->h;
+
+            surface_lock srclock(src);
+            surface_lock dstlock(dst);
+
+            warp(src, srcrect, dst, dstrect, jacui::surface::nearest);
+        } else if (SDL_BlitSurface(src, srcrect, dst, dstrect) < 0) {
+            throw_error("error blitting surface");
         }
     }
 }
 
 namespace jacui {
+    pixel_view::pixel_view(surface* owner, detail::surface_type* s, const rect2d& r)
+        : owner_(owner), surface_(s), data_(0), pitch_(0), depth_(0), area_(r)
+    {
+        if (surface_) {
+            if (SDL_MUSTLOCK(surface_) && SDL_LockSurface(surface_) < 0)
+                throw_error("error locking surface");
+            pitch_ = surface_->pitch;
+            depth_ = surface_->format->BytesPerPixel;
+            data_ = static_cast<unsigned char*>(surface_->pixels) + r.y * pitch_ + r.x * depth_;
+        }
+    }
+
+    pixel_view::pixel_view(const pixel_view& rhs)
+        : owner_(rhs.owner_), surface_(rhs.surface_), data_(rhs.data_), pitch_(rhs.pitch_),
+          depth_(rhs.depth_), area_(rhs.area_)
+    {
+        // locks nest, so the pixels stay where they are
+        if (surface_ && SDL_MUSTLOCK(surface_) && SDL_LockSurface(surface_) < 0)
+            throw_error("error locking surface");
+    }
+
+    pixel_view::~pixel_view()
+    {
+        if (surface_ && SDL_MUSTLOCK(surface_))
+            SDL_UnlockSurface(surface_);
+        if (owner_) {
+            try {
+                owner_->damage(area_);
+            } catch (...) {
+                // nothing sensible to do in a destructor
+            }
+        }
+    }
+
+    bool pixel_view::matches(pixel_format format) const
+    {
+        if (!surface_)
+            return false;
+
+        const SDL_PixelFormat* f = surface_->format;
+        if (f->palette || f->Rmask != 0x00ff0000 || f->Gmask != 0x0000ff00 || f->Bmask != 0x000000ff)
+            return false;
+
+        switch (format) {
+        case rgb888:
+            return f->BytesPerPixel == 3;
+        case xrgb8888:
+            return f->BytesPerPixel == 4 && !f->Amask;
+        case argb8888:
+            return f->BytesPerPixel == 4 && f->Amask == 0xff000000;
+        default:
+            return false;
+        }
+    }
+
+    pixel_view::pixel_type pixel_view::map(const color& c) const
+    {
+        return surface_ ? map_color(surface_->format, c) : 0;
+    }
+
+    color pixel_view::unmap(pixel_type p) const
+    {
+        return surface_ ? map_pixel(surface_->format, p) : color();
+    }
+
+    void pixel_view::swap(pixel_view& rhs)
+    {
+        std::swap(owner_, rhs.owner_);
+        std::swap(surface_, rhs.surface_);
+        std::swap(data_, rhs.data_);
+        std::swap(pitch_, rhs.pitch_);
+        std::swap(depth_, rhs.depth_);
+        std::swap(area_, rhs.area_);
+    }
+
     surface::~surface()
     {
     }
 
+    void surface::damage(const rect2d&)
+    {
+    }
+
+    detail::surface_type* surface::unshare()
+    {
+        return detail();
+    }
+
     bool surface::empty() const 
     {
         SDL_Surface* s = detail();
@@ -179,7 +297,8 @@ namespace jacui {
 
     rect2d surface::clip(const rect2d& r)
     {
-        SDL_Surface* s = detail();
+        // the clipping area is part of the surface shared with copies
+        SDL_Surface* s = unshare();
 
         if (s) {
             SDL_Rect rect;
@@ -193,67 +312,93 @@ namespace jacui {
         }
     }
 
+    pixel_view surface::pixels()
+    {
+        return pixels(size());
+    }
+
+    pixel_view surface::pixels(const rect2d& r)
+    {
+        const size2d s = size();
+        rect2d area;
+
+        if (r.x < s.width && r.y < s.height) {
+            area = rect2d(r.x, r.y, std::min(r.width, s.width - r.x), std::min(r.height, s.height - r.y));
+        }
+        if (area.empty())
+            return pixel_view(0, 0, area);
+
+        return pixel_view(this, unshare(), area);
+    }
+
     void surface::fill(color c, const rect2d& r)
     {
-        SDL_Surface* s = detail();
+        SDL_Surface* s = unshare();
 
         if (s) {
             SDL_Rect rect = make_rect(r);
-            if (SDL_FillRect(s, &rect, map_color(s->format, c)) < 0) {
-                throw_error("error filling surface");
-            }
+            fill_surface(s, &rect, map_color(s->format, c));
+            if (rect.w && rect.h)
+                damage(rect2d(rect.x, rect.y, rect.w, rect.h));
         }
     }
 
-    void surface::blit(const surface& s, const rect2d& src, const rect2d& dst)
+    void surface::blit(const surface& s, const rect2d& src, const rect2d& dst, scale_filter f)
     {
         SDL_Surface* psrc = s.detail();
-        SDL_Surface* pdst = detail();
+        SDL_Surface* pdst = psrc ? unshare() : 0;
 
         if (psrc && pdst) {
             SDL_Rect srcrect = make_rect(src);
             SDL_Rect dstrect = make_rect(dst);
             
             if (srcrect.w == dstrect.w && srcrect.h == dstrect.h) {
-                if (SDL_BlitSurface(psrc, &srcrect, pdst, &dstrect) < 0) {
-                    throw_error("error blitting surface");
-                }
+                blit_surface(psrc, &srcrect, pdst, &dstrect);
             } else {
-                surface_lock srclock(psrc);
+                // large reductions read from a mip level, if any
+                const image level(mipmap(s.detail(), srcrect, dstrect));
+                SDL_Surface* from = level.empty() ? psrc : level.detail();
+
+                surface_lock srclock(from);
                 surface_lock dstlock(pdst);
 
-                warp(psrc, &srcrect, pdst, &dstrect);
+                warp(from, &srcrect, pdst, &dstrect, f);
             }
+
+            if (dstrect.w && dstrect.h)
+                damage(rect2d(dstrect.x, dstrect.y, dstrect.w, dstrect.h));
         }
     }
 
     void surface::blit(const surface& s, const rect2d& src, const point2d& dst)
     {
         SDL_Surface* psrc = s.detail();
-        SDL_Surface* pdst = detail();
+        SDL_Surface* pdst = psrc ? unshare() : 0;
 
         if (psrc && pdst) {
             SDL_Rect srcrect = make_rect(src);
             SDL_Rect dstrect = make_rect(dst);
 
-            if (SDL_BlitSurface(psrc, &srcrect, pdst, &dstrect) < 0) {
-                throw_error("error blitting surface");
-            }
+            blit_surface(psrc, &srcrect, pdst, &dstrect);
+
+            if (dstrect.w && dstrect.h)
+                damage(rect2d(dstrect.x, dstrect.y, dstrect.w, dstrect.h));
         }
     }
 
     void surface::blit(const surface& s, const rect2d& src, int x, int y)
     {
         SDL_Surface* psrc = s.detail();
-        SDL_Surface* pdst = detail();
+        SDL_Surface* pdst = psrc ? unshare() : 0;
 
         if (psrc && pdst) {
             SDL_Rect srcrect = make_rect(src);
             SDL_Rect dstrect = { x, y, 0, 0 };
 
-            if (SDL_BlitSurface(psrc, &srcrect, pdst, &dstrect) < 0) {
-                throw_error("error blitting surface");
-            }
+            blit_surface(psrc, &srcrect, pdst, &dstrect);
+
+            if (dstrect.w && dstrect.h)
+                damage(rect2d(dstrect.x, dstrect.y, dstrect.w, dstrect.h));
         }
     }
 }
@@ -0,0 +1,442 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "jacui/surface.hpp"
+#include "jacui/error.hpp"
+#include "detail.hpp"
+
+#include <SDL_thread.h>
+
+#include <algorithm>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace jacui::detail;
+
+namespace {
+    std::size_t processor_count()
+    {
+#ifdef WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return std::max<std::size_t>(info.dwNumberOfProcessors, 1);
+#else
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        return n > 0 ? n : 1;
+#endif
+    }
+
+    // a range of items to be processed in bands
+    struct task {
+        enum failure_type { none, out_of_memory, failed };
+
+        task(void (*fn)(void*, int, int), void* arg, int size, int bands)
+            : fn(fn), arg(arg), size(size), bands(bands), next(0), finished(0), failure(none)
+        {
+        }
+
+        int begin(int band) const { return int(long(size) * band / bands); }
+        int end(int band) const { return int(long(size) * (band + 1) / bands); }
+
+        // process a band without letting an exception escape a worker
+        // thread, called without the mutex
+        failure_type run(int band, std::string& msg)
+        {
+            try {
+                fn(arg, begin(band), end(band));
+                return none;
+            } catch (const std::bad_alloc&) {
+                return out_of_memory;
+            } catch (const std::exception& e) {
+                try {
+                    msg = e.what();
+                } catch (...) {
+                    return out_of_memory;
+                }
+                return failed;
+            } catch (...) {
+                return failed;
+            }
+        }
+
+        // throw the first error of any band in the calling thread
+        void rethrow() const
+        {
+            if (failure == out_of_memory)
+                throw std::bad_alloc();
+            else if (failure == failed)
+                throw jacui::error(msg.empty() ? "error in parallel task" : msg);
+        }
+
+        void (*fn)(void*, int, int);
+        void* arg;
+        int size;
+        int bands;
+        int next;
+        int finished;
+        failure_type failure;
+        std::string msg;
+    };
+
+    class thread_pool {
+    public:
+        thread_pool()
+            : mutex_(SDL_CreateMutex()), work_(SDL_CreateCond()), done_(SDL_CreateCond()),
+              task_(0), stop_(false), concurrency_(processor_count())
+        {
+        }
+
+        ~thread_pool()
+        {
+            stop();
+            SDL_DestroyCond(done_);
+            SDL_DestroyCond(work_);
+            SDL_DestroyMutex(mutex_);
+        }
+
+        std::size_t concurrency() const
+        {
+            mutex_lock lock(mutex_);
+            return concurrency_;
+        }
+
+        void concurrency(std::size_t n)
+        {
+            {
+                mutex_lock lock(mutex_);
+                concurrency_ = n ? n : processor_count();
+            }
+            // threads are started again as needed by the next task
+            stop();
+        }
+
+        void run(task& t)
+        {
+            SDL_LockMutex(mutex_);
+
+            if (task_) {
+                // pool busy with another caller's task: run serially
+                SDL_UnlockMutex(mutex_);
+                t.fn(t.arg, 0, t.size);
+                return;
+            }
+
+            if (threads_.size() + 1 < concurrency_) {
+                start();
+            }
+
+            task_ = &t;
+            SDL_CondBroadcast(work_);
+            work(t);
+            while (t.finished != t.bands) {
+                SDL_CondWait(done_, mutex_);
+            }
+            task_ = 0;
+
+            SDL_UnlockMutex(mutex_);
+            t.rethrow();
+        }
+
+    private:
+        // process bands of a task, called with the mutex locked
+        void work(task& t)
+        {
+            std::string msg;
+            while (t.next != t.bands) {
+                int band = t.next++;
+                SDL_UnlockMutex(mutex_);
+                task::failure_type failure = t.run(band, msg);
+                SDL_LockMutex(mutex_);
+                if (failure != task::none && t.failure == task::none) {
+                    // keep the first error and skip the remaining bands
+                    t.failure = failure;
+                    t.msg.swap(msg);
+                    t.finished += t.bands - t.next;
+                    t.next = t.bands;
+                }
+                if (++t.finished == t.bands) {
+                    SDL_CondBroadcast(done_);
+                }
+            }
+        }
+
+        // called with the mutex locked
+        void start()
+        {
+            while (threads_.size() + 1 < concurrency_) {
+                SDL_Thread* thread = SDL_CreateThread(worker, this);
+                if (!thread)
+                    break; // fewer threads is fine
+                threads_.push_back(thread);
+            }
+        }
+
+        void stop()
+        {
+            std::vector<SDL_Thread*> threads;
+
+            SDL_LockMutex(mutex_);
+            stop_ = true;
+            threads.swap(threads_);
+            SDL_CondBroadcast(work_);
+            SDL_UnlockMutex(mutex_);
+
+            // workers need the mutex to exit
+            for (std::size_t i = 0; i != threads.size(); ++i) {
+                SDL_WaitThread(threads[i], 0);
+            }
+
+            SDL_LockMutex(mutex_);
+            stop_ = false;
+            SDL_UnlockMutex(mutex_);
+        }
+
+        static int worker(void* p)
+        {
+            thread_pool* pool = static_cast<thread_pool*>(p);
+
+            SDL_LockMutex(pool->mutex_);
+            for (;;) {
+                while (!pool->stop_ && !(pool->task_ && pool->task_->next != pool->task_->bands)) {
+                    SDL_CondWait(pool->work_, pool->mutex_);
+                }
+                if (pool->stop_)
+                    break;
+                pool->work(*pool->task_);
+            }
+            SDL_UnlockMutex(pool->mutex_);
+
+            return 0;
+        }
+
+    private:
+        thread_pool(const thread_pool&);
+        thread_pool& operator=(const thread_pool&);
+
+    private:
+        SDL_mutex* mutex_;
+        SDL_cond* work_;
+        SDL_cond* done_;
+        std::vector<SDL_Thread*> threads_;
+        task* task_;
+        bool stop_;
+        std::size_t concurrency_;
+    };
+
+    thread_pool& get_thread_pool()
+    {
+        static thread_pool pool;
+        return pool;
+    }
+
+    // a queued job, ordered by priority, then by submission
+    struct job_entry {
+        job* pj;
+        unsigned long seq;
+
+        bool operator<(const job_entry& rhs) const {
+            if (pj->priority != rhs.pj->priority)
+                return pj->priority < rhs.pj->priority;
+            else
+                return seq > rhs.seq;
+        }
+    };
+
+    // background threads for long running jobs, e.g. image decoding
+    class job_queue {
+    public:
+        job_queue()
+            : mutex_(SDL_CreateMutex()), work_(SDL_CreateCond()), seq_(0), stop_(false),
+              size_(std::max<std::size_t>(processor_count(), 2) - 1)
+        {
+        }
+
+        ~job_queue()
+        {
+            SDL_LockMutex(mutex_);
+            stop_ = true;
+            SDL_CondBroadcast(work_);
+            SDL_UnlockMutex(mutex_);
+
+            for (std::size_t i = 0; i != threads_.size(); ++i) {
+                SDL_WaitThread(threads_[i], 0);
+            }
+            for (std::size_t i = 0; i != jobs_.size(); ++i) {
+                delete jobs_[i].pj;
+            }
+
+            SDL_DestroyCond(work_);
+            SDL_DestroyMutex(mutex_);
+        }
+
+        void post(job* pj)
+        {
+            SDL_LockMutex(mutex_);
+
+            if (threads_.size() < size_) {
+                if (SDL_Thread* thread = SDL_CreateThread(worker, this))
+                    threads_.push_back(thread);
+            }
+
+            if (threads_.empty()) {
+                // no background thread available: run synchronously
+                SDL_UnlockMutex(mutex_);
+                run(pj);
+                return;
+            }
+
+            job_entry e = { pj, seq_++ };
+            try {
+                jobs_.push_back(e);
+                std::push_heap(jobs_.begin(), jobs_.end());
+            } catch (...) {
+                SDL_UnlockMutex(mutex_);
+                delete pj;
+                throw;
+            }
+            SDL_CondSignal(work_);
+            SDL_UnlockMutex(mutex_);
+        }
+
+        bool reprioritize(job* pj, int priority)
+        {
+            mutex_lock lock(mutex_);
+            for (std::size_t i = 0; i != jobs_.size(); ++i) {
+                if (jobs_[i].pj == pj) {
+                    pj->priority = priority;
+                    std::make_heap(jobs_.begin(), jobs_.end());
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        static void run(job* pj)
+        {
+            try {
+                pj->run();
+            } catch (...) {
+                // jobs report their own errors
+            }
+            delete pj;
+        }
+
+        static int worker(void* p)
+        {
+            job_queue* queue = static_cast<job_queue*>(p);
+
+            SDL_LockMutex(queue->mutex_);
+            for (;;) {
+                while (!queue->stop_ && queue->jobs_.empty()) {
+                    SDL_CondWait(queue->work_, queue->mutex_);
+                }
+                if (queue->stop_)
+                    break;
+
+                std::pop_heap(queue->jobs_.begin(), queue->jobs_.end());
+                job* pj = queue->jobs_.back().pj;
+                queue->jobs_.pop_back();
+                SDL_UnlockMutex(queue->mutex_);
+                run(pj);
+                SDL_LockMutex(queue->mutex_);
+            }
+            SDL_UnlockMutex(queue->mutex_);
+
+            return 0;
+        }
+
+    private:
+        job_queue(const job_queue&);
+        job_queue& operator=(const job_queue&);
+
+    private:
+        SDL_mutex* mutex_;
+        SDL_cond* work_;
+        std::vector<SDL_Thread*> threads_;
+        std::vector<job_entry> jobs_; // a heap, highest priority first
+        unsigned long seq_;
+        bool stop_;
+        std::size_t size_;
+    };
+
+    job_queue& get_job_queue()
+    {
+        static job_queue queue;
+        return queue;
+    }
+}
+
+namespace jacui {
+    std::size_t concurrency()
+    {
+        return get_thread_pool().concurrency();
+    }
+
+    void concurrency(std::size_t n)
+    {
+        get_thread_pool().concurrency(n);
+    }
+
+    namespace detail {
+        job::~job()
+        {
+        }
+
+        void post_job(job* pj)
+        {
+            get_job_queue().post(pj);
+        }
+
+        bool reprioritize_job(job* pj, int priority)
+        {
+            return get_job_queue().reprioritize(pj, priority);
+        }
+
+        void parallel_for(int size, int grain, void (*fn)(void*, int, int), void* arg)
+        {
+            thread_pool& pool = get_thread_pool();
+
+            int bands = std::min<std::size_t>(size / std::max(grain, 1), pool.concurrency() * 4);
+
+            if (bands <= 1 || pool.concurrency() == 1) {
+                fn(arg, 0, size);
+            } else {
+                task t(fn, arg, size, bands);
+                pool.run(t);
+            }
+        }
+    }
+}
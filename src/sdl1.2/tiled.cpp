@@ -0,0 +1,377 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "jacui/tiled.hpp"
+#include "jacui/canvas.hpp"
+#include "detail.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <map>
+#include <vector>
+
+namespace {
+    struct tile_key {
+        tile_key(std::size_t level, std::size_t col, std::size_t row)
+            : level(level), col(col), row(row)
+        {
+        }
+
+        bool operator<(const tile_key& rhs) const
+        {
+            if (level != rhs.level)
+                return level < rhs.level;
+            if (row != rhs.row)
+                return row < rhs.row;
+            return col < rhs.col;
+        }
+
+        std::size_t level;
+        std::size_t col;
+        std::size_t row;
+    };
+}
+
+namespace jacui {
+    struct tiled_image::impl {
+        struct entry {
+            entry(const tile_key& key, std::size_t bytes) : key(key), bytes(bytes)
+            {
+            }
+
+            tile_key key;
+            std::size_t bytes;
+            image tile;
+        };
+
+        typedef std::list<entry> list_type;
+
+        typedef std::map<tile_key, list_type::iterator> map_type;
+
+        impl(std::size_t tile_size, std::size_t budget)
+            : tile_size(std::max<std::size_t>(tile_size & ~std::size_t(1), 16)),
+              budget(budget), format(xrgb8888)
+        {
+            stats.hits = stats.misses = stats.evictions = stats.entries = stats.bytes = 0;
+        }
+
+        void load(const char* filename)
+        {
+            detail::shared_data data = detail::shared_data::map(filename);
+            detail::raw_layout layout;
+            image img;
+            size2d size;
+
+            if (detail::layout_raw(data, layout)) {
+                size = size2d(layout.width, layout.height);
+                format = layout.amask ? argb8888 : xrgb8888;
+            } else {
+                // compressed files have to be decoded as a whole
+                detail::shared_data().swap(data);
+                image tmp(filename);
+                img.swap(tmp);
+                size = img.size();
+                format = img.detail()->format->Amask ? argb8888 : xrgb8888;
+
+                // copy pixels into tiles, including alpha, instead of blending them
+                SDL_SetAlpha(img.detail(), 0, SDL_ALPHA_OPAQUE);
+                SDL_SetColorKey(img.detail(), 0, 0);
+            }
+
+            clear();
+            this->data.swap(data);
+            this->layout = layout;
+            this->img.swap(img);
+
+            sizes.assign(1, size);
+            while (size.width > tile_size || size.height > tile_size) {
+                size = size2d((size.width + 1) / 2, (size.height + 1) / 2);
+                sizes.push_back(size);
+            }
+        }
+
+        // the tile of a pyramid level, valid until the next call
+        SDL_Surface* tile(std::size_t level, std::size_t col, std::size_t row)
+        {
+            tile_key key(level, col, row);
+            map_type::iterator i = index.find(key);
+
+            if (i != index.end()) {
+                ++stats.hits;
+                entries.splice(entries.begin(), entries, i->second);
+                return i->second->tile.detail();
+            }
+            ++stats.misses;
+
+            const std::size_t x = col * tile_size;
+            const std::size_t y = row * tile_size;
+            const std::size_t w = std::min(tile_size, sizes[level].width - x);
+            const std::size_t h = std::min(tile_size, sizes[level].height - y);
+            image t(detail::make_surface(w, h, format));
+
+            if (level == 0) {
+                read(t.detail(), x, y);
+            } else {
+                // children that are evicted again are read back on demand
+                const size2d& below = sizes[level - 1];
+                for (std::size_t dr = 0; dr != 2; ++dr) {
+                    for (std::size_t dc = 0; dc != 2; ++dc) {
+                        if ((2 * col + dc) * tile_size < below.width &&
+                            (2 * row + dr) * tile_size < below.height) {
+                            SDL_Surface* s = tile(level - 1, 2 * col + dc, 2 * row + dr);
+                            detail::halve(s, t.detail(), dc * tile_size / 2, dr * tile_size / 2);
+                        }
+                    }
+                }
+            }
+
+            std::size_t bytes = std::size_t(t.detail()->h) * t.detail()->pitch;
+            entries.push_front(entry(key, bytes));
+            entries.front().tile.swap(t);
+            index[key] = entries.begin();
+            ++stats.entries;
+            stats.bytes += bytes;
+            evict(budget, 1);
+            return entries.front().tile.detail();
+        }
+
+        // read a tile of the image itself
+        void read(SDL_Surface* dst, std::size_t x, std::size_t y)
+        {
+            if (SDL_Surface* src = img.detail()) {
+                SDL_Rect srcrect = detail::make_rect(rect2d(x, y, dst->w, dst->h));
+                SDL_Rect dstrect = { 0, 0, 0, 0 };
+                if (SDL_BlitSurface(src, &srcrect, dst, &dstrect) < 0)
+                    detail::throw_error("error reading image tile");
+                return;
+            }
+
+            // wrap the tile's rows of the mapped file; rows too wide
+            // for a surface's pitch are wrapped one at a time
+            detail::raw_layout rows(layout);
+            rows.offset = layout.offset + y * layout.pitch + x * (layout.depth / 8);
+            rows.width = dst->w;
+            rows.height = layout.wrappable() ? dst->h : 1;
+            if (!layout.wrappable())
+                rows.pitch = rows.width * (layout.depth / 8);
+
+            for (int i = 0; i < dst->h; i += rows.height, rows.offset += layout.pitch * rows.height) {
+                image src(detail::map_surface(data, rows));
+                SDL_Rect srcrect = detail::make_rect(src.size());
+                SDL_Rect dstrect = { 0, Sint16(i), 0, 0 };
+                SDL_SetAlpha(src.detail(), 0, SDL_ALPHA_OPAQUE);
+                if (SDL_BlitSurface(src.detail(), &srcrect, dst, &dstrect) < 0)
+                    detail::throw_error("error reading image tile");
+            }
+        }
+
+        // copy an area of a pyramid level to a surface
+        void copy(std::size_t level, const rect2d& r, SDL_Surface* dst)
+        {
+            detail::surface_lock lock(dst);
+
+            for (std::size_t row = r.y / tile_size; row * tile_size < r.y + r.height; ++row) {
+                for (std::size_t col = r.x / tile_size; col * tile_size < r.x + r.width; ++col) {
+                    SDL_Surface* t = tile(level, col, row);
+                    std::size_t x0 = std::max(r.x, col * tile_size);
+                    std::size_t y0 = std::max(r.y, row * tile_size);
+                    std::size_t x1 = std::min(r.x + r.width, col * tile_size + t->w);
+                    std::size_t y1 = std::min(r.y + r.height, row * tile_size + t->h);
+
+                    const Uint8* p = static_cast<const Uint8*>(t->pixels)
+                        + (y0 - row * tile_size) * t->pitch + (x0 - col * tile_size) * 4;
+                    Uint8* q = static_cast<Uint8*>(dst->pixels)
+                        + (y0 - r.y) * dst->pitch + (x0 - r.x) * 4;
+                    for (std::size_t y = y0; y != y1; ++y, p += t->pitch, q += dst->pitch)
+                        std::memcpy(q, p, (x1 - x0) * 4);
+                }
+            }
+        }
+
+        void draw(surface& dst, const rect2d& src, const rect2d& r, surface::scale_filter f)
+        {
+            const size2d& size = sizes.empty() ? size2d() : sizes[0];
+            if (src.empty() || r.empty() || src.x >= size.width || src.y >= size.height)
+                return;
+
+            // clip to the image, shrinking the destination to match
+            const std::size_t sw = std::min(src.width, size.width - src.x);
+            const std::size_t sh = std::min(src.height, size.height - src.y);
+            const rect2d d(r.x, r.y, std::size_t(double(r.width) * sw / src.width),
+                           std::size_t(double(r.height) * sh / src.height));
+            if (d.empty())
+                return;
+
+            std::size_t level = 0;
+            while (level + 1 < sizes.size() &&
+                   sw >> (level + 1) >= d.width && sh >> (level + 1) >= d.height)
+                ++level;
+
+            const std::size_t round = (std::size_t(1) << level) - 1;
+            const std::size_t x = src.x >> level;
+            const std::size_t y = src.y >> level;
+            const rect2d lr(x, y,
+                            std::min(sizes[level].width, (src.x + sw + round) >> level) - x,
+                            std::min(sizes[level].height, (src.y + sh + round) >> level) - y);
+
+            canvas tmp(lr.size(), format);
+            copy(level, lr, tmp.detail());
+
+            if (lr.size() == d.size())
+                dst.blit(tmp, d.offset());
+            else
+                dst.blit(tmp, d, f);
+        }
+
+        void erase(map_type::iterator i)
+        {
+            --stats.entries;
+            stats.bytes -= i->second->bytes;
+            entries.erase(i->second);
+            index.erase(i);
+        }
+
+        // evict least recently used tiles until the cache fits a
+        // budget, keeping the most recently used ones
+        void evict(std::size_t bytes, std::size_t keep)
+        {
+            while (stats.bytes > bytes && stats.entries > keep) {
+                erase(index.find(entries.back().key));
+                ++stats.evictions;
+            }
+        }
+
+        void clear()
+        {
+            entries.clear();
+            index.clear();
+            stats.entries = 0;
+            stats.bytes = 0;
+        }
+
+        const std::size_t tile_size;
+        std::size_t budget;
+        pixel_format format;
+        detail::shared_data data;  // mapped uncompressed file
+        detail::raw_layout layout;
+        image img;                 // or decoded image
+        std::vector<size2d> sizes; // of pyramid levels
+        cache_stats stats;
+        list_type entries; // most recently used first
+        map_type index;
+    };
+
+    tiled_image::tiled_image(std::size_t tile_size, std::size_t budget)
+        : pimpl_(new impl(tile_size, budget))
+    {
+    }
+
+    tiled_image::tiled_image(const char* filename, std::size_t tile_size, std::size_t budget)
+        : pimpl_(new impl(tile_size, budget))
+    {
+        try {
+            pimpl_->load(filename);
+        } catch (...) {
+            delete pimpl_;
+            throw;
+        }
+    }
+
+    tiled_image::~tiled_image()
+    {
+        delete pimpl_;
+    }
+
+    void tiled_image::load(const char* filename)
+    {
+        pimpl_->load(filename);
+    }
+
+    bool tiled_image::empty() const
+    {
+        return pimpl_->sizes.empty() || pimpl_->sizes[0].width == 0 || pimpl_->sizes[0].height == 0;
+    }
+
+    size2d tiled_image::size() const
+    {
+        return pimpl_->sizes.empty() ? size2d() : pimpl_->sizes[0];
+    }
+
+    std::size_t tiled_image::width() const
+    {
+        return size().width;
+    }
+
+    std::size_t tiled_image::height() const
+    {
+        return size().height;
+    }
+
+    std::size_t tiled_image::tile_size() const
+    {
+        return pimpl_->tile_size;
+    }
+
+    std::size_t tiled_image::levels() const
+    {
+        return pimpl_->sizes.size();
+    }
+
+    void tiled_image::draw(surface& dst, const rect2d& src, const point2d& p) const
+    {
+        pimpl_->draw(dst, src, rect2d(p, src.size()), surface::nearest);
+    }
+
+    void tiled_image::draw(surface& dst, const rect2d& src, const rect2d& r,
+                           surface::scale_filter f) const
+    {
+        pimpl_->draw(dst, src, r, f);
+    }
+
+    std::size_t tiled_image::budget() const
+    {
+        return pimpl_->budget;
+    }
+
+    void tiled_image::budget(std::size_t bytes)
+    {
+        pimpl_->budget = bytes;
+        pimpl_->evict(bytes, 0);
+    }
+
+    void tiled_image::clear()
+    {
+        pimpl_->clear();
+    }
+
+    tiled_image::cache_stats tiled_image::stats() const
+    {
+        return pimpl_->stats;
+    }
+}
@@ -27,3 +27,92 @@
  */
 
 #include "jacui/types.hpp"
+
+#include <algorithm>
+
+namespace {
+    inline std::size_t area(const jacui::rect2d& r)
+    {
+        return r.width * r.height;
+    }
+
+    jacui::rect2d unite(const jacui::rect2d& a, const jacui::rect2d& b)
+    {
+        std::size_t x0 = std::min(a.x, b.x);
+        std::size_t y0 = std::min(a.y, b.y);
+        std::size_t x1 = std::max(a.x + a.width, b.x + b.width);
+        std::size_t y1 = std::max(a.y + a.height, b.y + b.height);
+        return jacui::rect2d(x0, y0, x1 - x0, y1 - y0);
+    }
+
+    bool contains(const jacui::rect2d& a, const jacui::rect2d& b)
+    {
+        return b.x >= a.x && b.y >= a.y
+            && b.x + b.width <= a.x + a.width
+            && b.y + b.height <= a.y + a.height;
+    }
+
+    // area added by merging two rectangles, less their own areas
+    std::size_t cost(const jacui::rect2d& a, const jacui::rect2d& b)
+    {
+        std::size_t u = area(unite(a, b));
+        std::size_t s = area(a) + area(b);
+        return u > s ? u - s : 0;
+    }
+}
+
+namespace jacui {
+    rect2d region::bounds() const
+    {
+        if (rects_.empty())
+            return rect2d();
+
+        rect2d r = rects_.front();
+        for (const_iterator i = rects_.begin() + 1; i != rects_.end(); ++i) {
+            r = unite(r, *i);
+        }
+        return r;
+    }
+
+    void region::add(const rect2d& r)
+    {
+        if (r.empty())
+            return;
+
+        rect2d tmp = r;
+
+        // merge rectangles that cost no extra area, until none is left
+        for (std::size_t i = 0; i != rects_.size(); ) {
+            if (contains(rects_[i], tmp)) {
+                return;
+            } else if (contains(tmp, rects_[i]) || cost(rects_[i], tmp) == 0) {
+                tmp = unite(rects_[i], tmp);
+                rects_.erase(rects_.begin() + i);
+                i = 0;
+            } else {
+                ++i;
+            }
+        }
+
+        if (rects_.size() == max_size) {
+            // merge with the rectangle that adds the least area
+            std::size_t best = 0;
+            for (std::size_t i = 1; i != rects_.size(); ++i) {
+                if (cost(rects_[i], tmp) < cost(rects_[best], tmp))
+                    best = i;
+            }
+            tmp = unite(rects_[best], tmp);
+            rects_.erase(rects_.begin() + best);
+            add(tmp);
+        } else {
+            rects_.push_back(tmp);
+        }
+    }
+
+    void region::add(const region& r)
+    {
+        for (const_iterator i = r.begin(); i != r.end(); ++i) {
+            add(*i);
+        }
+    }
+}
@@ -0,0 +1,721 @@
+/*
+ * JACUI - Just Another C++ User Interface Library
+ *
+ * Copyright (C) 2011 The JACUI Project
+ *
+ * http://code.google.com/p/jacui/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "detail.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JACUI_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace jacui::detail;
+
+namespace {
+    // raw pixel load/store for a given number of bytes per pixel
+    template<int Bpp> struct pixel;
+
+    template<> struct pixel<1> {
+        static Uint32 load(const Uint8* p) { return *p; }
+        static void store(Uint8* p, Uint32 v) { *p = Uint8(v); }
+    };
+
+    template<> struct pixel<2> {
+        static Uint32 load(const Uint8* p) { return *reinterpret_cast<const Uint16*>(p); }
+        static void store(Uint8* p, Uint32 v) { *reinterpret_cast<Uint16*>(p) = Uint16(v); }
+    };
+
+    template<> struct pixel<3> {
+        static Uint32 load(const Uint8* p) {
+            if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
+                return p[0] << 16 | p[1] << 8 | p[2];
+            else
+                return p[0] | p[1] << 8 | p[2] << 16;
+        }
+
+        static void store(Uint8* p, Uint32 v) {
+            if (SDL_BYTEORDER == SDL_BIG_ENDIAN) {
+                p[0] = (v >> 16) & 0xff;
+                p[1] = (v >> 8) & 0xff;
+                p[2] = v & 0xff;
+            } else {
+                p[0] = v & 0xff;
+                p[1] = (v >> 8) & 0xff;
+                p[2] = (v >> 16) & 0xff;
+            }
+        }
+    };
+
+    template<> struct pixel<4> {
+        static Uint32 load(const Uint8* p) { return *reinterpret_cast<const Uint32*>(p); }
+        static void store(Uint8* p, Uint32 v) { *reinterpret_cast<Uint32*>(p) = v; }
+    };
+
+    // same pixel format: copy raw pixel values
+    struct copy_pixel {
+        Uint32 operator()(Uint32 v) const { return v; }
+    };
+
+    // 8 bit per channel formats: convert by shifting channels
+    struct shift_pixel {
+        shift_pixel(const SDL_PixelFormat* src, const SDL_PixelFormat* dst)
+            : rs(src->Rshift), gs(src->Gshift), bs(src->Bshift), as(src->Ashift),
+              rd(dst->Rshift), gd(dst->Gshift), bd(dst->Bshift), ad(dst->Ashift),
+              opaque(src->Amask == 0), amask(dst->Amask)
+        {
+        }
+
+        Uint32 operator()(Uint32 v) const {
+            Uint32 a = opaque ? 0xff : (v >> as) & 0xff;
+            return ((v >> rs) & 0xff) << rd
+                | ((v >> gs) & 0xff) << gd
+                | ((v >> bs) & 0xff) << bd
+                | (a << ad & amask);
+        }
+
+        Uint8 rs, gs, bs, as;
+        Uint8 rd, gd, bd, ad;
+        bool opaque;
+        Uint32 amask;
+    };
+
+    // anything else: let SDL do the mapping
+    struct convert_pixel {
+        convert_pixel(SDL_PixelFormat* src, SDL_PixelFormat* dst) : src(src), dst(dst) { }
+
+        Uint32 operator()(Uint32 v) const {
+            return map_color(dst, jacui::detail::map_pixel(src, v));
+        }
+
+        SDL_PixelFormat* src;
+        SDL_PixelFormat* dst;
+    };
+
+    // per-call lookup tables: source column offsets and source rows
+    struct warp_table {
+        std::vector<Uint32> xoff;
+        std::vector<const Uint8*> rows;
+        Uint8* dst;
+        int pitch;
+    };
+
+    template<int SrcBpp, int DstBpp, class Convert>
+    void warp_rows(const warp_table& t, int begin, int end, Convert cvt)
+    {
+        const std::size_t w = t.xoff.size();
+        const Uint32* xoff = &t.xoff[0];
+        const Uint8* prev = 0;
+        Uint8* dst = t.dst + begin * t.pitch;
+
+        for (int y = begin; y != end; ++y, dst += t.pitch) {
+            const Uint8* src = t.rows[y];
+
+            if (src == prev) {
+                // upscaling: repeat the previous destination row
+                std::memcpy(dst, dst - t.pitch, w * DstBpp);
+            } else {
+                Uint8* p = dst;
+                for (std::size_t x = 0; x != w; ++x, p += DstBpp) {
+                    pixel<DstBpp>::store(p, cvt(pixel<SrcBpp>::load(src + xoff[x])));
+                }
+                prev = src;
+            }
+        }
+    }
+
+    template<int SrcBpp, class Convert>
+    void warp_rows(const warp_table& t, int begin, int end, int dstbpp, Convert cvt)
+    {
+        switch (dstbpp) {
+        case 1:
+            warp_rows<SrcBpp, 1>(t, begin, end, cvt);
+            break;
+        case 2:
+            warp_rows<SrcBpp, 2>(t, begin, end, cvt);
+            break;
+        case 3:
+            warp_rows<SrcBpp, 3>(t, begin, end, cvt);
+            break;
+        case 4:
+            warp_rows<SrcBpp, 4>(t, begin, end, cvt);
+            break;
+        }
+    }
+
+    template<class Convert>
+    void warp_rows(const warp_table& t, int begin, int end, int srcbpp, int dstbpp, Convert cvt)
+    {
+        switch (srcbpp) {
+        case 1:
+            warp_rows<1>(t, begin, end, dstbpp, cvt);
+            break;
+        case 2:
+            warp_rows<2>(t, begin, end, dstbpp, cvt);
+            break;
+        case 3:
+            warp_rows<3>(t, begin, end, dstbpp, cvt);
+            break;
+        case 4:
+            warp_rows<4>(t, begin, end, dstbpp, cvt);
+            break;
+        }
+    }
+
+    template<class Convert>
+    struct warp_band {
+        warp_band(const warp_table& t, int srcbpp, int dstbpp, Convert cvt)
+            : t(t), srcbpp(srcbpp), dstbpp(dstbpp), cvt(cvt)
+        {
+        }
+
+        void operator()(int begin, int end) {
+            warp_rows(t, begin, end, srcbpp, dstbpp, cvt);
+        }
+
+        const warp_table& t;
+        int srcbpp, dstbpp;
+        Convert cvt;
+    };
+
+    template<class Convert>
+    void warp_bands(const warp_table& t, int srcbpp, int dstbpp, Convert cvt)
+    {
+        warp_band<Convert> band(t, srcbpp, dstbpp, cvt);
+        parallel_for(t.rows.size(), parallel_rows(t.xoff.size()), band);
+    }
+
+    bool same_color(const SDL_Color& lhs, const SDL_Color& rhs)
+    {
+        return lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b;
+    }
+
+    bool same_format(const SDL_PixelFormat* src, const SDL_PixelFormat* dst)
+    {
+        if (src == dst)
+            return true;
+        if (src->BytesPerPixel != dst->BytesPerPixel)
+            return false;
+        if (src->palette || dst->palette) {
+            return src->palette && dst->palette
+                && src->palette->ncolors == dst->palette->ncolors
+                && std::equal(src->palette->colors,
+                              src->palette->colors + src->palette->ncolors,
+                              dst->palette->colors, same_color);
+        }
+        return src->Rmask == dst->Rmask
+            && src->Gmask == dst->Gmask
+            && src->Bmask == dst->Bmask
+            && src->Amask == dst->Amask;
+    }
+
+    bool is_byte_channel(Uint32 mask, Uint8 shift)
+    {
+        return mask == Uint32(0xff) << shift && shift % 8 == 0;
+    }
+
+    bool is_rgb888(const SDL_PixelFormat* fmt)
+    {
+        return !fmt->palette
+            && (fmt->BytesPerPixel == 3 || fmt->BytesPerPixel == 4)
+            && is_byte_channel(fmt->Rmask, fmt->Rshift)
+            && is_byte_channel(fmt->Gmask, fmt->Gshift)
+            && is_byte_channel(fmt->Bmask, fmt->Bshift)
+            && (!fmt->Amask || is_byte_channel(fmt->Amask, fmt->Ashift));
+    }
+
+    // filtered scaling: fixed point precision of filter weights
+    enum { weight_bits = 14 };
+
+    // per-axis filter weights for a range of destination indices
+    struct filter_table {
+        std::vector<int> start;
+        std::vector<int> count;
+        std::vector<Sint16> weights;
+        int taps;
+    };
+
+    double sinc(double x)
+    {
+        if (x == 0.0)
+            return 1.0;
+        x *= 3.14159265358979323846;
+        return std::sin(x) / x;
+    }
+
+    double filter_support(jacui::surface::scale_filter f)
+    {
+        switch (f) {
+        case jacui::surface::box:
+            return 0.5;
+        case jacui::surface::lanczos:
+            return 3.0;
+        default:
+            return 1.0;
+        }
+    }
+
+    double filter_kernel(jacui::surface::scale_filter f, double x)
+    {
+        switch (f) {
+        case jacui::surface::box:
+            return x > -0.5 && x <= 0.5 ? 1.0 : 0.0;
+        case jacui::surface::lanczos:
+            return x > -3.0 && x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+        default:
+            x = std::fabs(x);
+            return x < 1.0 ? 1.0 - x : 0.0;
+        }
+    }
+
+    void make_filter_table(filter_table& t, jacui::surface::scale_filter f,
+                           int srclen, int dstlen, int first, int last)
+    {
+        const double scale = double(srclen) / dstlen;
+        const double fscale = std::max(scale, 1.0);
+        const double support = filter_support(f) * fscale;
+
+        t.taps = int(std::ceil(support)) * 2 + 1;
+        t.start.resize(last - first);
+        t.count.resize(last - first);
+        t.weights.assign((last - first) * t.taps, 0);
+
+        std::vector<double> w(t.taps);
+
+        for (int i = first; i != last; ++i) {
+            const double center = (i + 0.5) * scale;
+            int xmin = std::max(int(center - support + 0.5), 0);
+            int xmax = std::min(int(center + support + 0.5), srclen);
+            int n = std::min(std::max(xmax - xmin, 1), t.taps);
+            xmin = std::min(xmin, srclen - n);
+
+            double sum = 0.0;
+            for (int k = 0; k != n; ++k) {
+                w[k] = filter_kernel(f, (xmin + k + 0.5 - center) / fscale);
+                sum += w[k];
+            }
+
+            Sint16* fw = &t.weights[(i - first) * t.taps];
+            int total = 0, kmax = 0;
+            for (int k = 0; k != n; ++k) {
+                double v = sum != 0.0 ? w[k] / sum : (k == 0 ? 1.0 : 0.0);
+                fw[k] = Sint16(std::floor(v * (1 << weight_bits) + 0.5));
+                total += fw[k];
+                if (fw[k] > fw[kmax])
+                    kmax = k;
+            }
+            // make weights sum up to exactly one
+            fw[kmax] = Sint16(fw[kmax] + (1 << weight_bits) - total);
+
+            t.start[i - first] = xmin;
+            t.count[i - first] = n;
+        }
+    }
+
+    inline Uint8 clamp_channel(int v)
+    {
+        return v < 0 ? 0 : v > 0xff ? 0xff : Uint8(v);
+    }
+
+    // weighted sum of n four channel pixels, stride bytes apart
+    inline void convolve_scalar(Uint8* out, const Uint8* p, std::ptrdiff_t stride,
+                                const Sint16* w, int n)
+    {
+        int c0 = 1 << (weight_bits - 1), c1 = c0, c2 = c0, c3 = c0;
+
+        for (int i = 0; i != n; ++i, p += stride) {
+            c0 += p[0] * w[i];
+            c1 += p[1] * w[i];
+            c2 += p[2] * w[i];
+            c3 += p[3] * w[i];
+        }
+
+        out[0] = clamp_channel(c0 >> weight_bits);
+        out[1] = clamp_channel(c1 >> weight_bits);
+        out[2] = clamp_channel(c2 >> weight_bits);
+        out[3] = clamp_channel(c3 >> weight_bits);
+    }
+
+#ifdef JACUI_USE_SSE2
+    // the same sum, two taps per multiply-add
+    inline void convolve_sse2(Uint8* out, const Uint8* p, std::ptrdiff_t stride,
+                              const Sint16* w, int n)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_set1_epi32(1 << (weight_bits - 1));
+        int i = 0;
+
+        for (; i + 1 < n; i += 2, p += 2 * stride) {
+            Uint32 a, b;
+            std::memcpy(&a, p, 4);
+            std::memcpy(&b, p + stride, 4);
+            __m128i ab = _mm_unpacklo_epi8(_mm_cvtsi32_si128(a), _mm_cvtsi32_si128(b));
+            __m128i ww = _mm_set1_epi32(Uint16(w[i]) | Uint32(Uint16(w[i + 1])) << 16);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(ab, zero), ww));
+        }
+        if (i < n) {
+            Uint32 a;
+            std::memcpy(&a, p, 4);
+            __m128i a0 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(a), zero);
+            __m128i ww = _mm_set1_epi32(Uint16(w[i]));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(a0, zero), ww));
+        }
+
+        acc = _mm_srai_epi32(acc, weight_bits);
+        acc = _mm_packs_epi32(acc, acc);
+        int v = _mm_cvtsi128_si32(_mm_packus_epi16(acc, acc));
+        std::memcpy(out, &v, 4);
+    }
+#endif
+
+    // whether filtered scaling uses SIMD instructions, if available
+    bool simd_enabled = true;
+
+    // the convolution kernel, selected once per band so that it is
+    // inlined into the pixel loops
+    template<bool Simd> struct kernel {
+        static void convolve(Uint8* out, const Uint8* p, std::ptrdiff_t stride,
+                             const Sint16* w, int n)
+        {
+            convolve_scalar(out, p, stride, w, n);
+        }
+    };
+
+#ifdef JACUI_USE_SSE2
+    template<> struct kernel<true> {
+        static void convolve(Uint8* out, const Uint8* p, std::ptrdiff_t stride,
+                             const Sint16* w, int n)
+        {
+            convolve_sse2(out, p, stride, w, n);
+        }
+    };
+#endif
+
+    // intermediate format for filtered scaling
+    SDL_PixelFormat make_rgba_format()
+    {
+        SDL_PixelFormat fmt;
+        std::memset(&fmt, 0, sizeof fmt);
+        fmt.BitsPerPixel = 32;
+        fmt.BytesPerPixel = 4;
+        fmt.Rmask = 0x000000ff;
+        fmt.Gmask = 0x0000ff00;
+        fmt.Bmask = 0x00ff0000;
+        fmt.Amask = 0xff000000;
+        fmt.Rshift = 0;
+        fmt.Gshift = 8;
+        fmt.Bshift = 16;
+        fmt.Ashift = 24;
+        fmt.alpha = 0xff;
+        return fmt;
+    }
+
+    SDL_PixelFormat rgba_format = make_rgba_format();
+
+    template<int SrcBpp, int DstBpp, class Convert>
+    void convert_row(const Uint8* src, Uint8* dst, int n, Convert cvt)
+    {
+        for (int i = 0; i != n; ++i, src += SrcBpp, dst += DstBpp) {
+            pixel<DstBpp>::store(dst, cvt(pixel<SrcBpp>::load(src)));
+        }
+    }
+
+    template<int SrcBpp, int DstBpp>
+    void convert_row(const Uint8* src, SDL_PixelFormat* from, Uint8* dst, SDL_PixelFormat* to, int n)
+    {
+        if (same_format(from, to))
+            convert_row<SrcBpp, DstBpp>(src, dst, n, copy_pixel());
+        else if (is_rgb888(from) && is_rgb888(to))
+            convert_row<SrcBpp, DstBpp>(src, dst, n, shift_pixel(from, to));
+        else
+            convert_row<SrcBpp, DstBpp>(src, dst, n, convert_pixel(from, to));
+    }
+
+    // convert a row of pixels from or to the four byte working format
+    void load_row(const Uint8* src, SDL_PixelFormat* from, Uint8* dst, SDL_PixelFormat* to, int n)
+    {
+        switch (from->BytesPerPixel) {
+        case 1:
+            convert_row<1, 4>(src, from, dst, to, n);
+            break;
+        case 2:
+            convert_row<2, 4>(src, from, dst, to, n);
+            break;
+        case 3:
+            convert_row<3, 4>(src, from, dst, to, n);
+            break;
+        case 4:
+            convert_row<4, 4>(src, from, dst, to, n);
+            break;
+        }
+    }
+
+    void store_row(const Uint8* src, SDL_PixelFormat* from, Uint8* dst, SDL_PixelFormat* to, int n)
+    {
+        switch (to->BytesPerPixel) {
+        case 1:
+            convert_row<4, 1>(src, from, dst, to, n);
+            break;
+        case 2:
+            convert_row<4, 2>(src, from, dst, to, n);
+            break;
+        case 3:
+            convert_row<4, 3>(src, from, dst, to, n);
+            break;
+        case 4:
+            convert_row<4, 4>(src, from, dst, to, n);
+            break;
+        }
+    }
+
+    // separable resampling: horizontal pass into an intermediate
+    // buffer, then vertical pass into the destination surface
+    class resampler {
+    public:
+        resampler(SDL_Surface* src, const SDL_Rect& srcrect, SDL_Surface* dst,
+                  const SDL_Rect& dstrect, int x0, int y0, int x1, int y1,
+                  jacui::surface::scale_filter f)
+            : src_(src), dst_(dst), srcrect_(srcrect), x0_(x0), y0_(y0), width_(x1 - x0),
+              work_(&rgba_format), simd_(simd_enabled), vertical_(false)
+        {
+            make_filter_table(xt_, f, srcrect.w, dstrect.w, x0 - dstrect.x, x1 - dstrect.x);
+            make_filter_table(yt_, f, srcrect.h, dstrect.h, y0 - dstrect.y, y1 - dstrect.y);
+
+            // four byte pixels of the same format need no conversion
+            if (src->format->BytesPerPixel == 4 && same_format(src->format, dst->format))
+                work_ = src->format;
+
+            // all source rows touched by the vertical taps
+            rmin_ = yt_.start.front();
+            rmax_ = yt_.start.back() + yt_.count.back();
+            hbuf_.resize((rmax_ - rmin_) * width_ * 4);
+        }
+
+        void run()
+        {
+            vertical_ = false;
+            parallel_for(rmax_ - rmin_, parallel_rows(width_), *this);
+            vertical_ = true;
+            parallel_for(int(yt_.start.size()), parallel_rows(width_), *this);
+        }
+
+        void operator()(int begin, int end)
+        {
+            if (vertical_ && simd_)
+                vertical<true>(begin, end);
+            else if (vertical_)
+                vertical<false>(begin, end);
+            else if (simd_)
+                horizontal<true>(rmin_ + begin, rmin_ + end);
+            else
+                horizontal<false>(rmin_ + begin, rmin_ + end);
+        }
+
+    private:
+        bool direct() const
+        {
+            return work_ == src_->format;
+        }
+
+        template<bool Simd> void horizontal(int begin, int end)
+        {
+            const int srcbpp = src_->format->BytesPerPixel;
+            const Uint8* srcpixels = static_cast<const Uint8*>(src_->pixels);
+            std::vector<Uint8> row(direct() ? 0 : srcrect_.w * 4);
+
+            for (int r = begin; r != end; ++r) {
+                const Uint8* p = srcpixels + (srcrect_.y + r) * src_->pitch + srcrect_.x * srcbpp;
+
+                if (!direct()) {
+                    load_row(p, src_->format, &row[0], work_, srcrect_.w);
+                    p = &row[0];
+                }
+
+                Uint8* out = &hbuf_[(r - rmin_) * width_ * 4];
+                for (int x = 0; x != width_; ++x, out += 4) {
+                    kernel<Simd>::convolve(out, p + xt_.start[x] * 4, 4,
+                                           &xt_.weights[x * xt_.taps], xt_.count[x]);
+                }
+            }
+        }
+
+        template<bool Simd> void vertical(int begin, int end)
+        {
+            const int dstbpp = dst_->format->BytesPerPixel;
+            const std::ptrdiff_t stride = width_ * 4;
+            std::vector<Uint8> row(direct() ? 0 : width_ * 4);
+
+            for (int y = begin; y != end; ++y) {
+                Uint8* d = static_cast<Uint8*>(dst_->pixels) + (y0_ + y) * dst_->pitch + x0_ * dstbpp;
+                Uint8* out = direct() ? d : &row[0];
+                const Uint8* p = &hbuf_[(yt_.start[y] - rmin_) * stride];
+                const Sint16* yw = &yt_.weights[y * yt_.taps];
+
+                for (int x = 0; x != width_; ++x) {
+                    kernel<Simd>::convolve(out + x * 4, p + x * 4, stride, yw, yt_.count[y]);
+                }
+
+                if (!direct()) {
+                    store_row(out, work_, d, dst_->format, width_);
+                }
+            }
+        }
+
+    private:
+        SDL_Surface* src_;
+        SDL_Surface* dst_;
+        SDL_Rect srcrect_;
+        int x0_, y0_, width_;
+        SDL_PixelFormat* work_;
+        bool simd_;
+        filter_table xt_, yt_;
+        int rmin_, rmax_;
+        std::vector<Uint8> hbuf_;
+        bool vertical_;
+    };
+
+    // average 2x2 pixel blocks, one byte channel at a time
+    struct halve_band {
+        halve_band(const SDL_Surface* src, SDL_Surface* dst, int x, int y)
+            : src(src), dst(dst), x(x), y(y)
+        {
+        }
+
+        void operator()(int begin, int end) {
+            const int bpp = src->format->BytesPerPixel;
+            const int w = (src->w + 1) / 2;
+
+            for (int r = begin; r != end; ++r) {
+                const Uint8* p = static_cast<const Uint8*>(src->pixels) + 2 * r * src->pitch;
+                const Uint8* q = 2 * r + 1 < src->h ? p + src->pitch : p;
+                Uint8* out = static_cast<Uint8*>(dst->pixels) + (y + r) * dst->pitch + x * bpp;
+
+                for (int i = 0; i != w; ++i, p += 2 * bpp, q += 2 * bpp, out += bpp) {
+                    const int dx = 2 * i + 1 < src->w ? bpp : 0;
+                    for (int k = 0; k != bpp; ++k)
+                        out[k] = Uint8((p[k] + p[k + dx] + q[k] + q[k + dx] + 2) >> 2);
+                }
+            }
+        }
+
+        const SDL_Surface* src;
+        SDL_Surface* dst;
+        int x, y;
+    };
+}
+
+namespace jacui {
+    namespace detail {
+        void warp(SDL_Surface* src, SDL_Rect* srcrect, SDL_Surface* dst, SDL_Rect* dstrect,
+                  surface::scale_filter filter)
+        {
+            assert(src && srcrect->x >= 0 && srcrect->y >= 0);
+            assert(dst && dstrect->x >= 0 && dstrect->y >= 0);
+
+            if (srcrect->x + srcrect->w > src->w)
+                srcrect->w = std::max(src->w - srcrect->x, 0);
+            if (srcrect->y + srcrect->h > src->h)
+                srcrect->h = std::max(src->h - srcrect->y, 0);
+            if (srcrect->w <= 0 || srcrect->h <= 0 || dstrect->w <= 0 || dstrect->h <= 0) {
+                dstrect->w = dstrect->h = 0;
+                return;
+            }
+
+            SDL_Rect clip;
+            SDL_GetClipRect(dst, &clip);
+
+            // clip destination, but keep the scale of the unclipped rect
+            int x0 = std::max<int>(dstrect->x, clip.x);
+            int y0 = std::max<int>(dstrect->y, clip.y);
+            int x1 = std::min(dstrect->x + dstrect->w, clip.x + clip.w);
+            int y1 = std::min(dstrect->y + dstrect->h, clip.y + clip.h);
+
+            if (x1 <= x0 || y1 <= y0) {
+                dstrect->w = dstrect->h = 0;
+                return;
+            }
+
+            // scale tables map the unclipped rect, only x0..x1, y0..y1 is drawn
+            const SDL_Rect full = *dstrect;
+            const SDL_Rect clipped = { Sint16(x0), Sint16(y0), Uint16(x1 - x0), Uint16(y1 - y0) };
+
+            if (filter != surface::nearest) {
+                resampler(src, *srcrect, dst, full, x0, y0, x1, y1, filter).run();
+                *dstrect = clipped;
+                return;
+            }
+
+            const int srcbpp = src->format->BytesPerPixel;
+            const int dstbpp = dst->format->BytesPerPixel;
+            const Uint8* srcpixels = static_cast<const Uint8*>(src->pixels);
+
+            warp_table t;
+            t.xoff.resize(x1 - x0);
+            t.rows.resize(y1 - y0);
+
+            for (int x = x0; x != x1; ++x) {
+                Uint32 n = Uint32(x - full.x) * srcrect->w / full.w;
+                t.xoff[x - x0] = (srcrect->x + n) * srcbpp;
+            }
+
+            for (int y = y0; y != y1; ++y) {
+                Uint32 n = Uint32(y - full.y) * srcrect->h / full.h;
+                t.rows[y - y0] = srcpixels + (srcrect->y + n) * src->pitch;
+            }
+
+            t.dst = static_cast<Uint8*>(dst->pixels) + y0 * dst->pitch + x0 * dstbpp;
+            t.pitch = dst->pitch;
+
+            if (same_format(src->format, dst->format)) {
+                warp_bands(t, srcbpp, dstbpp, copy_pixel());
+            } else if (is_rgb888(src->format) && is_rgb888(dst->format)) {
+                warp_bands(t, srcbpp, dstbpp, shift_pixel(src->format, dst->format));
+            } else {
+                warp_bands(t, srcbpp, dstbpp, convert_pixel(src->format, dst->format));
+            }
+            *dstrect = clipped;
+        }
+
+        void simd(bool enable)
+        {
+            simd_enabled = enable;
+        }
+
+        void halve(const SDL_Surface* src, SDL_Surface* dst, int x, int y)
+        {
+            assert(src->format->BytesPerPixel == dst->format->BytesPerPixel);
+
+            halve_band band(src, dst, x, y);
+            parallel_for((src->h + 1) / 2, parallel_rows((src->w + 1) / 2), band);
+        }
+    }
+}
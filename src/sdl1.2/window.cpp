@@ -29,6 +29,9 @@
 #include "jacui/window.hpp"
 #include "detail.hpp"
 
+#include <algorithm>
+#include <vector>
+
 namespace {
     class wmsurface: public jacui::surface {
     public:
@@ -39,6 +42,19 @@ namespace {
         {
             return jacui::detail::make_surface(SDL_GetVideoSurface());
         }
+
+        jacui::region& damaged()
+        {
+            return damaged_;
+        }
+
+        void damage(const jacui::rect2d& r)
+        {
+            damaged_.add(r);
+        }
+
+    private:
+        jacui::region damaged_;
     };
 
     inline Uint32 make_flags(jacui::window::flags_type f)
@@ -47,16 +63,43 @@ namespace {
         flags ^= SDL_RESIZABLE; // inverted!
         return flags;
     }
+
+    inline int make_bpp(jacui::pixel_format format)
+    {
+        return format == jacui::rgb888 ? 24 : 32;
+    }
 }
 
 namespace jacui {
+    namespace detail {
+        bool update_rects(const SDL_Surface* s, const region& r, std::vector<SDL_Rect>& rects)
+        {
+            if (s->flags & SDL_DOUBLEBUF)
+                return false;
+
+            rects.reserve(r.size());
+            for (region::const_iterator i = r.begin(); i != r.end(); ++i) {
+                // clip to the current video mode, which may have changed
+                SDL_Rect rect = make_rect(*i);
+                if (rect.x + rect.w > s->w)
+                    rect.w = std::max(s->w - rect.x, 0);
+                if (rect.y + rect.h > s->h)
+                    rect.h = std::max(s->h - rect.y, 0);
+                if (rect.w && rect.h)
+                    rects.push_back(rect);
+            }
+            return true;
+        }
+    }
+
     struct window::impl {
-        impl(const char* caption, std::size_t width, std::size_t height, flags_type f) 
+        impl(const char* caption, std::size_t width, std::size_t height, pixel_format format, flags_type f) 
         {
             if (caption)
                 SDL_WM_SetCaption(caption, caption);
-            if (!SDL_SetVideoMode(width, height, 24, make_flags(f)))
+            if (!SDL_SetVideoMode(width, height, make_bpp(format), make_flags(f)))
                 detail::throw_error("error setting video mode");
+            surface.damaged().add(surface.size());
         }
 
         wmsurface surface;
@@ -70,17 +113,33 @@ namespace jacui {
     const window::flags_type window::noframe = SDL_NOFRAME;
 
     window::window(const std::string& caption, flags_type f)
-        : pimpl_(new impl(caption.c_str(), 0, 0, f))
+        : pimpl_(new impl(caption.c_str(), 0, 0, rgb888, f))
     {
     }
 
     window::window(const std::string& caption, const size2d& s, flags_type f)
-        : pimpl_(new impl(caption.c_str(), s.width, s.height, f))
+        : pimpl_(new impl(caption.c_str(), s.width, s.height, rgb888, f))
     {
     }
 
     window::window(const std::string& caption, std::size_t width, std::size_t height, flags_type f)
-        : pimpl_(new impl(caption.c_str(), width, height, f))
+        : pimpl_(new impl(caption.c_str(), width, height, rgb888, f))
+    {
+    }
+
+    window::window(const std::string& caption, pixel_format format, flags_type f)
+        : pimpl_(new impl(caption.c_str(), 0, 0, format, f))
+    {
+    }
+
+    window::window(const std::string& caption, const size2d& s, pixel_format format, flags_type f)
+        : pimpl_(new impl(caption.c_str(), s.width, s.height, format, f))
+    {
+    }
+
+    window::window(const std::string& caption, std::size_t width, std::size_t height, 
+                   pixel_format format, flags_type f)
+        : pimpl_(new impl(caption.c_str(), width, height, format, f))
     {
     }
 
@@ -157,13 +216,34 @@ namespace jacui {
 
         if (!s)
             detail::throw_error("error resizing window");
-        if (!SDL_SetVideoMode(width, height, 0, s->flags))
+        if (!SDL_SetVideoMode(width, height, s->format->BitsPerPixel, s->flags))
             detail::throw_error("error resizing window");
+        pimpl_->surface.damaged().clear();
+        pimpl_->surface.damaged().add(pimpl_->surface.size());
+    }
+
+    const region& window::damaged() const
+    {
+        return pimpl_->surface.damaged();
     }
 
     void window::update()
     {
-        SDL_Flip(SDL_GetVideoSurface());
+        update(pimpl_->surface.damaged());
+        pimpl_->surface.damaged().clear();
+    }
+
+    void window::update(const region& r)
+    {
+        SDL_Surface* s = SDL_GetVideoSurface();
+        std::vector<SDL_Rect> rects;
+
+        if (!detail::update_rects(s, r, rects)) {
+            // page flipping always presents the whole back buffer
+            SDL_Flip(s);
+        } else if (!rects.empty()) {
+            SDL_UpdateRects(s, rects.size(), &rects[0]);
+        }
     }
 
     void window::close()
@@ -0,0 +1,140 @@
+#ifndef JACUI_TESTS_CHECK_HPP
+#define JACUI_TESTS_CHECK_HPP
+
+#include "jacui/canvas.hpp"
+#include "detail.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// helpers shared by the tests, each test is a single source file
+namespace {
+    bool failed = false;
+
+    inline void check(bool cond, const char* what)
+    {
+        if (!cond) {
+            std::fprintf(stderr, "check failed: %s\n", what);
+            failed = true;
+        }
+    }
+
+    // the color of a single pixel
+    inline jacui::color pixel(const jacui::surface& s, int x, int y)
+    {
+        jacui::detail::surface_lock lock(s.detail());
+        SDL_Surface* p = lock.get();
+        const Uint8* q = static_cast<const Uint8*>(p->pixels)
+            + y * p->pitch + x * p->format->BytesPerPixel;
+
+        Uint32 v = 0;
+        for (int i = 0; i != p->format->BytesPerPixel; ++i) {
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+            v |= Uint32(q[i]) << (8 * i);
+#else
+            v = v << 8 | q[i];
+#endif
+        }
+
+        Uint8 r, g, b, a;
+        SDL_GetRGBA(v, p->format, &r, &g, &b, &a);
+        return jacui::color(r, g, b, a);
+    }
+
+    // a distinct opaque color for each pixel of a small surface
+    inline jacui::color pattern(int x, int y)
+    {
+        return jacui::color(x * 16 + y, y * 16 + x, (x ^ y) * 8 + 3);
+    }
+
+    inline void fill_pattern(jacui::surface& s)
+    {
+        for (int y = 0; y != int(s.height()); ++y)
+            for (int x = 0; x != int(s.width()); ++x)
+                s.fill(pattern(x, y), jacui::rect2d(x, y, 1, 1));
+    }
+
+    inline bool has_pattern(const jacui::surface& s)
+    {
+        for (int y = 0; y != int(s.height()); ++y)
+            for (int x = 0; x != int(s.width()); ++x)
+                if (pixel(s, x, y).rgb() != pattern(x, y).rgb())
+                    return false;
+        return true;
+    }
+
+    // whether two surfaces of the same format have the same bytes
+    inline bool same_pixels(const jacui::surface& lhs, const jacui::surface& rhs,
+                            const jacui::rect2d& r)
+    {
+        jacui::detail::surface_lock a(lhs.detail());
+        jacui::detail::surface_lock b(rhs.detail());
+        const std::size_t depth = a.get()->format->BytesPerPixel;
+        if (b.get()->format->BytesPerPixel != depth)
+            return false;
+
+        const Uint8* p = static_cast<const Uint8*>(a.get()->pixels)
+            + r.y * a.get()->pitch + r.x * depth;
+        const Uint8* q = static_cast<const Uint8*>(b.get()->pixels)
+            + r.y * b.get()->pitch + r.x * depth;
+        for (std::size_t y = 0; y != r.height; ++y, p += a.get()->pitch, q += b.get()->pitch)
+            if (std::memcmp(p, q, r.width * depth))
+                return false;
+        return true;
+    }
+
+    // whether two surfaces of any format have the same colors
+    inline bool same_colors(const jacui::surface& lhs, const jacui::surface& rhs)
+    {
+        if (lhs.size() != rhs.size())
+            return false;
+        for (int y = 0; y != int(lhs.height()); ++y)
+            for (int x = 0; x != int(lhs.width()); ++x)
+                if (pixel(lhs, x, y).rgb() != pixel(rhs, x, y).rgb())
+                    return false;
+        return true;
+    }
+
+    inline void put_le(std::vector<unsigned char>& b, std::size_t pos, unsigned long v, int n)
+    {
+        for (int i = 0; i != n; ++i)
+            b[pos + i] = (unsigned char)(v >> (8 * i) & 0xff);
+    }
+
+    // a 24 bit BMP file of the test pattern
+    inline std::vector<unsigned char> make_bmp(int width, int height)
+    {
+        std::size_t pitch = (width * 3 + 3) & ~3;
+        std::vector<unsigned char> b(54 + height * pitch);
+        b[0] = 'B';
+        b[1] = 'M';
+        put_le(b, 2, b.size(), 4);
+        put_le(b, 10, 54, 4);
+        put_le(b, 14, 40, 4);
+        put_le(b, 18, width, 4);
+        put_le(b, 22, height, 4);
+        put_le(b, 26, 1, 2);
+        put_le(b, 28, 24, 2);
+        for (int y = 0; y != height; ++y) {
+            for (int x = 0; x != width; ++x) {
+                jacui::color c = pattern(x, y);
+                unsigned char* p = &b[54 + (height - 1 - y) * pitch + x * 3];
+                p[0] = c.b;
+                p[1] = c.g;
+                p[2] = c.r;
+            }
+        }
+        return b;
+    }
+
+    inline void write_file(const char* filename, const std::vector<unsigned char>& b)
+    {
+        if (std::FILE* fp = std::fopen(filename, "wb")) {
+            std::fwrite(&b[0], 1, b.size(), fp);
+            std::fclose(fp);
+        }
+    }
+}
+
+#endif
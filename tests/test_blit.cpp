@@ -1,4 +1,258 @@
-#include "jacui/canvas.hpp"
+#include "jacui/error.hpp"
+
+#include "check.hpp"
+
+#include <new>
+#include <string>
+
+namespace {
+    // whether each pixel of a surface shows the pattern scaled by an
+    // integer factor, or is black outside a clip rect
+    bool has_scaled_pattern(const jacui::surface& s, int sx, int sy, const jacui::rect2d& clip)
+    {
+        for (int y = 0; y != int(s.height()); ++y) {
+            for (int x = 0; x != int(s.width()); ++x) {
+                bool inside = x >= int(clip.x) && x < int(clip.x + clip.width)
+                    && y >= int(clip.y) && y < int(clip.y + clip.height);
+                jacui::color c = inside ? pattern(x / sx, y / sy) : jacui::color(0, 0, 0);
+                if (pixel(s, x, y).rgb() != c.rgb())
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // a nearest neighbour scale repeats each source pixel
+    void test_nearest()
+    {
+        using namespace jacui;
+
+        canvas src(4, 3);
+        fill_pattern(src);
+
+        canvas dst(8, 9);
+        dst.blit(src, rect2d(0, 0, 8, 9));
+        check(has_scaled_pattern(dst, 2, 3, rect2d(0, 0, 8, 9)), "nearest blit");
+
+        canvas part(4, 4);
+        part.blit(src, rect2d(1, 1, 2, 2), rect2d(0, 0, 4, 4));
+        bool ok = true;
+        for (int y = 0; y != 4; ++y)
+            for (int x = 0; x != 4; ++x)
+                ok = ok && pixel(part, x, y).rgb() == pattern(1 + x / 2, 1 + y / 2).rgb();
+        check(ok, "nearest blit of a source rect");
+    }
+
+    // a clipped scaled blit keeps the scale of the unclipped rect
+    void test_nearest_clipped()
+    {
+        using namespace jacui;
+
+        canvas src(4, 3);
+        fill_pattern(src);
+
+        canvas dst(8, 9);
+        dst.fill(color(0, 0, 0));
+        dst.clip(rect2d(3, 2, 4, 5));
+        dst.blit(src, rect2d(0, 0, 8, 9));
+        check(has_scaled_pattern(dst, 2, 3, rect2d(3, 2, 4, 5)), "clipped nearest blit");
+    }
+
+    // a clipped filtered blit draws the same pixels as an unclipped one
+    void test_filtered_clipped(jacui::surface::scale_filter f)
+    {
+        using namespace jacui;
+
+        canvas src(4, 3);
+        fill_pattern(src);
+
+        canvas full(11, 7);
+        full.blit(src, rect2d(0, 0, 11, 7), f);
+        canvas clipped(11, 7);
+        clipped.clip(rect2d(4, 2, 5, 4));
+        clipped.blit(src, rect2d(0, 0, 11, 7), f);
+        check(same_pixels(full, clipped, rect2d(4, 2, 5, 4)), "clipped filtered blit");
+    }
+
+    // a large fill or scaled blit, drawn with a given number of threads
+    void draw_band(jacui::canvas& dst, const jacui::rect2d& clip, int op, std::size_t n)
+    {
+        using namespace jacui;
+
+        canvas small(13, 11);
+        fill_pattern(small);
+        canvas large(301, 203);
+        large.blit(small, rect2d(0, 0, 301, 203));
+
+        dst.clip(rect2d(0, 0, dst.width(), dst.height()));
+        dst.fill(color(0, 0, 0));
+        dst.clip(clip);
+
+        concurrency(n);
+        switch (op) {
+        case 0:
+            dst.fill(color(4, 5, 6), rect2d(17, 9, 600, 400));
+            break;
+        case 1:
+            dst.blit(small, rect2d(0, 0, 640, 480));
+            break;
+        case 2:
+            dst.blit(small, rect2d(3, 2, 637, 471), surface::bilinear);
+            break;
+        case 3:
+            dst.blit(large, rect2d(0, 0, 640, 480), surface::bilinear);
+            break;
+        case 4:
+            dst.blit(large, rect2d(5, 7, 150, 460), surface::box);
+            break;
+        case 5:
+            dst.blit(large, rect2d(0, 7, 639, 131), surface::box);
+            break;
+        }
+        concurrency(0);
+    }
+
+    // parallel bands draw the same bytes as a single thread
+    void test_parallel(const jacui::rect2d& clip)
+    {
+        using namespace jacui;
+
+        static const char* const what[] = {
+            "parallel fill", "parallel nearest blit", "parallel bilinear upscale",
+            "parallel bilinear downscale", "parallel box blit", "parallel wide box blit"
+        };
+
+        for (int op = 0; op != 6; ++op) {
+            canvas serial(640, 480);
+            draw_band(serial, clip, op, 1);
+            canvas parallel(640, 480);
+            draw_band(parallel, clip, op, 4);
+            check(same_pixels(serial, parallel, rect2d(0, 0, 640, 480)), what[op]);
+        }
+    }
+
+    // parallel format conversion matches a single thread byte for byte
+    void test_parallel_conversion()
+    {
+        using namespace jacui;
+
+        canvas src(400, 200, rgb888);
+        pixel_view v = src.pixels();
+        for (std::size_t y = 0; y != v.height(); ++y)
+            for (std::size_t x = 0; x != v.width() * 3; ++x)
+                v.row(y)[x] = (unsigned char)(x * 7 + y * 13);
+
+        concurrency(1);
+        canvas serial(500, 200, xrgb8888);
+        serial.fill(color(0, 0, 0));
+        serial.blit(src, point2d(300, 0));
+        serial.blit(src, point2d(-350, 20));
+
+        concurrency(4);
+        canvas parallel(500, 200, xrgb8888);
+        parallel.fill(color(0, 0, 0));
+        parallel.blit(src, point2d(300, 0));
+        parallel.blit(src, point2d(-350, 20));
+
+        check(same_pixels(serial, parallel, rect2d(0, 0, 500, 200)), "parallel conversion");
+        concurrency(0);
+    }
+
+    // throws in the band containing a given item
+    struct throwing_band {
+        throwing_band(int item, bool out_of_memory)
+            : item(item), out_of_memory(out_of_memory)
+        {
+        }
+
+        void operator()(int begin, int end)
+        {
+            SDL_Delay(1); // let other threads take bands
+            if (begin <= item && item < end) {
+                if (out_of_memory)
+                    throw std::bad_alloc();
+                throw jacui::error("band failed");
+            }
+        }
+
+        int item;
+        bool out_of_memory;
+    };
+
+    // a throwing band on any thread reaches the caller, and leaves
+    // the pool ready for the next task
+    void test_parallel_error(int item, bool out_of_memory)
+    {
+        using namespace jacui;
+
+        concurrency(4);
+        throwing_band band(item, out_of_memory);
+        bool caught = false;
+        try {
+            detail::parallel_for(1000, 10, band);
+        } catch (const std::bad_alloc&) {
+            caught = out_of_memory;
+        } catch (const error& e) {
+            caught = !out_of_memory && std::string(e.what()) == "band failed";
+        }
+        check(caught, "parallel error rethrown");
+
+        canvas serial(640, 480);
+        draw_band(serial, rect2d(0, 0, 640, 480), 3, 1);
+        canvas parallel(640, 480);
+        draw_band(parallel, rect2d(0, 0, 640, 480), 3, 4);
+        check(same_pixels(serial, parallel, rect2d(0, 0, 640, 480)), "parallel after error");
+        concurrency(0);
+    }
+
+    // sharp edges and extreme values, so filters overshoot and clamp
+    void fill_noise(jacui::canvas& c)
+    {
+        jacui::pixel_view v = c.pixels();
+        for (std::size_t y = 0; y != v.height(); ++y) {
+            unsigned char* p = v.row(y);
+            for (std::size_t x = 0; x != v.width() * v.depth(); ++x)
+                p[x] = (x / 5 + y / 3) % 4 == 0 ? 0xff : (unsigned char)(x * x * 7 + y * 13 + (x ^ y));
+        }
+    }
+
+    // the SIMD kernel draws the same bytes as the scalar one, with odd
+    // numbers of taps and with the many taps of large reductions
+    void test_simd(jacui::pixel_format format)
+    {
+        using namespace jacui;
+
+        static const struct {
+            surface::scale_filter filter;
+            int width, height;
+            const char* what;
+        } blits[] = {
+            { surface::lanczos, 61, 37, "SIMD lanczos downscale" },
+            { surface::box, 83, 47, "SIMD box downscale" },
+            { surface::bilinear, 125, 75, "SIMD bilinear downscale" },
+            { surface::lanczos, 333, 201, "SIMD lanczos odd downscale" },
+            { surface::bilinear, 1331, 603, "SIMD bilinear odd upscale" },
+            { surface::lanczos, 1995, 1203, "SIMD lanczos upscale" }
+        };
+
+        canvas src(997, 601, format);
+        fill_noise(src);
+
+        for (std::size_t i = 0; i != sizeof blits / sizeof blits[0]; ++i) {
+            const rect2d r(0, 0, blits[i].width, blits[i].height);
+
+            detail::simd(false);
+            canvas scalar(r.width, r.height, format);
+            scalar.blit(src, r, blits[i].filter);
+
+            detail::simd(true);
+            canvas simd(r.width, r.height, format);
+            simd.blit(src, r, blits[i].filter);
+
+            check(same_pixels(scalar, simd, r), blits[i].what);
+        }
+    }
+}
 
 int main(int argc, char *argv[])
 {
@@ -16,5 +270,57 @@ int main(int argc, char *argv[])
     c2.blit(c1, rect2d(0, 0, 0, 0), point2d(0, 0));
     c2.blit(c1, rect2d(0, 0, 100, 100), rect2d(0, 0, 0, 0));
 
-    return 0;
+    canvas c3(40, 30);
+    c3.fill(color(0xff, 0, 0));
+
+    c2.blit(c3, rect2d(0, 0, 100, 100));
+    c2.blit(c3, rect2d(0, 0, 10, 10));
+    c2.blit(c3, rect2d(50, 50, 200, 200));
+    c2.blit(c3, rect2d(10, 10, 100, 100), rect2d(0, 0, 50, 50));
+
+    c2.blit(c3, rect2d(0, 0, 100, 100), surface::bilinear);
+    c2.blit(c3, rect2d(0, 0, 10, 10), surface::box);
+    c2.blit(c3, rect2d(5, 5, 90, 30), surface::lanczos);
+    c2.blit(c3, rect2d(10, 10, 1, 1), rect2d(0, 0, 100, 100), surface::lanczos);
+
+    c2.clip(rect2d(10, 10, 20, 20));
+    c2.blit(c3, rect2d(0, 0, 100, 100));
+    c2.blit(c3, rect2d(0, 0, 100, 100), surface::bilinear);
+
+    concurrency(4);
+
+    canvas c4(640, 480);
+    c4.fill(color(0, 0xff, 0));
+    c4.blit(c3, rect2d(0, 0, 640, 480));
+    c4.blit(c3, rect2d(0, 0, 640, 480), surface::lanczos);
+
+    canvas c5(320, 240, xrgb8888);
+    canvas c6(320, 240, argb8888);
+    c5.blit(c4);
+    c5.blit(c4, rect2d(0, 0, 100, 100), surface::bilinear);
+    c6.fill(color(0, 0, 0xff, 0x80));
+    c6.resize(400, 300);
+    c4.blit(c6);
+    c4.blit(c6, rect2d(0, 0, 640, 480), surface::box);
+
+    concurrency(0);
+
+    test_nearest();
+    test_nearest_clipped();
+    test_filtered_clipped(surface::bilinear);
+    test_filtered_clipped(surface::box);
+    test_filtered_clipped(surface::lanczos);
+
+    test_parallel(rect2d(0, 0, 640, 480));
+    test_parallel(rect2d(37, 11, 501, 397));
+
+    test_parallel_conversion();
+    test_parallel_error(0, false);
+    test_parallel_error(999, false);
+    test_parallel_error(500, true);
+
+    test_simd(xrgb8888);
+    test_simd(rgb888);
+
+    return failed ? 1 : 0;
 }
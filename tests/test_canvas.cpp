@@ -0,0 +1,335 @@
+#include "jacui/error.hpp"
+
+#include "check.hpp"
+
+#include <utility>
+#include <vector>
+
+namespace {
+    // the depth and alpha mask of a surface's pixels
+    bool has_format(const jacui::surface& s, int bits, Uint32 amask)
+    {
+        const SDL_PixelFormat* f = s.detail()->format;
+        return f->BitsPerPixel == bits && f->Amask == amask;
+    }
+
+    void test_formats()
+    {
+        using namespace jacui;
+
+        check(has_format(canvas(3, 2), 24, 0), "rgb888 default");
+        check(has_format(canvas(3, 2, rgb888), 24, 0), "rgb888 canvas");
+        check(has_format(canvas(3, 2, xrgb8888), 32, 0), "xrgb8888 canvas");
+        check(has_format(canvas(size2d(3, 2), argb8888), 32, 0xff000000), "argb8888 canvas");
+    }
+
+    // blits convert between all formats without losing colors
+    void test_conversion()
+    {
+        using namespace jacui;
+
+        canvas c1(13, 7, rgb888);
+        fill_pattern(c1);
+        canvas c2(13, 7, xrgb8888);
+        c2.blit(c1);
+        canvas c3(13, 7, argb8888);
+        c3.blit(c2);
+        canvas c4(13, 7, rgb888);
+        c4.blit(c3);
+
+        check(has_pattern(c2), "rgb888 to xrgb8888");
+        check(has_pattern(c3) && pixel(c3, 12, 6).a == 0xff, "xrgb8888 to argb8888");
+        check(has_pattern(c4), "argb8888 to rgb888");
+    }
+
+    // resizing keeps the format and the overlapping pixels, unblended
+    void test_resize(jacui::pixel_format format, int bits, Uint32 amask)
+    {
+        using namespace jacui;
+
+        canvas c(13, 7, format);
+        fill_pattern(c);
+        if (format == argb8888)
+            c.fill(color(1, 2, 3, 4), rect2d(0, 0, 1, 1));
+
+        c.resize(20, 9);
+        check(c.size() == size2d(20, 9) && has_format(c, bits, amask), "resize format");
+        bool ok = pixel(c, 0, 0) == (format == argb8888 ? color(1, 2, 3, 4) : pattern(0, 0));
+        for (int y = 0; y != 7; ++y)
+            for (int x = y ? 0 : 1; x != 13; ++x)
+                ok = ok && pixel(c, x, y).rgb() == pattern(x, y).rgb();
+        check(ok, "resize pixels");
+
+        c.resize(size2d(5, 3));
+        check(c.size() == size2d(5, 3) && has_format(c, bits, amask), "shrink format");
+        check(pixel(c, 4, 2).rgb() == pattern(4, 2).rgb(), "shrink pixels");
+    }
+
+    // the layout of a view matches its surface's format
+    void test_pixel_layout(jacui::pixel_format format, std::size_t depth)
+    {
+        using namespace jacui;
+
+        canvas c(13, 7, format);
+        pixel_view v = c.pixels();
+        check(v.size() == c.size() && v.depth() == depth && v.pitch() >= 13 * depth,
+              "pixel view layout");
+        check(v.matches(format) && !v.matches(format == rgb888 ? xrgb8888 : rgb888),
+              "pixel view format");
+        check(v.unmap(v.map(pattern(3, 2))).rgb() == pattern(3, 2).rgb(), "pixel view map");
+    }
+
+    // pixels are read and written through a clipped view
+    void test_pixel_access(jacui::pixel_format format)
+    {
+        using namespace jacui;
+
+        canvas c(13, 7, format);
+        fill_pattern(c);
+        {
+            pixel_view v = c.pixels(rect2d(10, 5, 8, 8));
+            check(v.size() == size2d(3, 2), "pixel view clipped");
+            check(v.unmap(v.row<Uint32>(1)[2]).rgb() == pattern(12, 6).rgb(), "pixel view read");
+
+            pixel_view copy(v);
+            for (std::size_t y = 0; y != copy.height(); ++y)
+                for (std::size_t x = 0; x != copy.width(); ++x)
+                    copy.row<Uint32>(y)[x] = Uint32(copy.map(color(x, y, 7)));
+        }
+
+        bool ok = true;
+        for (int y = 0; y != 7; ++y) {
+            for (int x = 0; x != 13; ++x) {
+                color expected = x >= 10 && y >= 5 ? color(x - 10, y - 5, 7) : pattern(x, y);
+                ok = ok && pixel(c, x, y).rgb() == expected.rgb();
+            }
+        }
+        check(ok, "pixel view write");
+    }
+
+    // copies share pixels until either of them is drawn onto
+    void test_unshare()
+    {
+        using namespace jacui;
+
+        canvas c(13, 7, xrgb8888);
+        fill_pattern(c);
+        c.clip(rect2d(2, 1, 8, 4));
+
+        canvas copy(c);
+        check(copy.detail() == c.detail(), "canvas copy shares pixels");
+        check(copy.clip() == rect2d(2, 1, 8, 4), "canvas copy clip");
+
+        c.fill(color(1, 2, 3));
+        check(copy.detail() != c.detail() && has_pattern(copy), "canvas unshared by fill");
+        check(pixel(c, 2, 1).rgb() == 0x010203 && pixel(c, 1, 1).rgb() == pattern(1, 1).rgb(),
+              "canvas clip kept when unshared");
+
+        canvas assigned;
+        assigned = copy;
+        assigned.blit(c);
+        check(assigned.detail() != copy.detail() && has_pattern(copy), "canvas unshared by blit");
+
+        canvas clipped(copy);
+        clipped.clip(rect2d(0, 0, 13, 7));
+        check(clipped.detail() != copy.detail() && copy.clip() == rect2d(2, 1, 8, 4),
+              "canvas unshared by clip");
+
+        canvas viewed(copy);
+        viewed.pixels().row<Uint32>(0)[0] = 0;
+        check(viewed.detail() != copy.detail() && has_pattern(copy), "canvas unshared by pixels");
+    }
+
+    // counts calls of an external pixel buffer's release function
+    struct release_count {
+        release_count() : calls(0), pixels(0) { }
+
+        static void release(void* pixels, void* context)
+        {
+            release_count* self = static_cast<release_count*>(context);
+            ++self->calls;
+            self->pixels = pixels;
+        }
+
+        int calls;
+        void* pixels;
+    };
+
+    // a canvas draws onto caller-owned pixels, which are released
+    // exactly once, when the last reference is gone
+    void test_external()
+    {
+        using namespace jacui;
+
+        std::vector<Uint32> buffer(16 * 8, 0);
+        release_count count;
+        {
+            canvas c(&buffer[0], size2d(13, 7), 16 * 4, xrgb8888, release_count::release, &count);
+            c.fill(color(1, 2, 3), rect2d(12, 6, 1, 1));
+            check(buffer[6 * 16 + 12] == 0x010203 && buffer[6 * 16 + 13] == 0, "external pixels drawn");
+
+            canvas copy(c);
+            check(copy.detail() != c.detail(), "external pixels copied");
+            copy.fill(color(4, 5, 6));
+            check(buffer[0] == 0, "external pixels copy drawn onto");
+
+            canvas moved;
+            moved.swap(c);
+            check(count.calls == 0, "external pixels in use");
+        }
+        check(count.calls == 1 && count.pixels == &buffer[0], "external pixels released once");
+
+        // the constructor releases the pixels it rejects
+        release_count rejected;
+        bool thrown = false;
+        try {
+            canvas c(&buffer[0], size2d(13, 7), 12 * 4, xrgb8888, release_count::release, &rejected);
+        } catch (const error&) {
+            thrown = true;
+        }
+        check(thrown && rejected.calls == 1, "external pixels released when rejected");
+
+        // without a release function, the caller keeps the pixels
+        canvas c(&buffer[0], size2d(16, 8), 16 * 4, argb8888);
+        c.fill(color(7, 8, 9, 10));
+        check(buffer[16 * 8 - 1] == 0x0a070809, "external pixels without release");
+    }
+
+    // resizing within the capacity keeps the pixels in place
+    void test_capacity()
+    {
+        using namespace jacui;
+
+        canvas c(13, 7, xrgb8888);
+        check(c.capacity() == size2d(13, 7), "capacity");
+        fill_pattern(c);
+
+        c.reserve(size2d(40, 20));
+        SDL_Surface* p = c.detail();
+        check(c.size() == size2d(13, 7) && c.capacity() == size2d(40, 20) && has_pattern(c),
+              "reserve");
+
+        c.resize(5, 3);
+        check(c.detail() == p && c.capacity() == size2d(40, 20) && has_pattern(c), "resize smaller");
+
+        // pixels that become visible again are cleared
+        c.resize(30, 20);
+        bool ok = c.detail() == p && c.clip() == rect2d(0, 0, 30, 20);
+        for (int y = 0; y != 20; ++y)
+            for (int x = 0; x != 30; ++x)
+                ok = ok && pixel(c, x, y).rgb() == (x < 5 && y < 3 ? pattern(x, y).rgb() : 0);
+        check(ok, "resize within capacity");
+
+        c.resize(50, 10);
+        check(c.detail() != p && c.capacity() == size2d(50, 20) && pixel(c, 4, 2).rgb() == pattern(4, 2).rgb(),
+              "resize beyond capacity");
+
+        // rgb888 rows are padded to 4 bytes, leaving room for a pixel
+        canvas padded(7, 2, rgb888);
+        check(padded.capacity() == size2d(8, 2), "padded capacity");
+        padded.resize(8, 2);
+        check(padded.size() == size2d(8, 2) && padded.capacity() == size2d(8, 2), "resize into padding");
+
+        // copies share the pixels, so neither is resized in place
+        canvas shared(c);
+        p = c.detail();
+        c.resize(10, 5);
+        check(c.detail() != p && shared.detail() == p && shared.size() == size2d(50, 10)
+              && pixel(shared, 4, 2).rgb() == pattern(4, 2).rgb(), "resize of a shared canvas");
+
+        // external pixels are neither cleared nor resized in place
+        std::vector<Uint32> buffer(16 * 8, 0x010203);
+        canvas external(&buffer[0], size2d(16, 8), 16 * 4, xrgb8888);
+        check(external.capacity() == size2d(16, 8), "external capacity");
+        external.resize(8, 4);
+        check(external.detail()->pixels != &buffer[0] && external.size() == size2d(8, 4)
+              && pixel(external, 7, 3).rgb() == 0x010203, "external pixels resized");
+        external.resize(12, 6);
+        check(pixel(external, 11, 5).rgb() == 0 && buffer[16 * 8 - 1] == 0x010203,
+              "external pixels not cleared");
+    }
+
+    // destroyed canvases' pixels are reused within the pool budget
+    void test_pool()
+    {
+        using namespace jacui;
+
+        canvas::pool_budget(1 << 20);
+        void* pixels;
+        {
+            canvas c(100, 60, xrgb8888);
+            c.fill(color(1, 2, 3));
+            pixels = c.detail()->pixels;
+        }
+
+        // the same size class, rounded up by at most a quarter
+        canvas c(98, 58, xrgb8888);
+        check(c.detail()->pixels == pixels && c.size() == size2d(98, 58), "pool reuse");
+        check(pixel(c, 97, 57).rgb() == 0 && c.clip() == rect2d(0, 0, 98, 58), "pool reuse cleared");
+
+        canvas other(98, 58, argb8888);
+        check(other.detail()->pixels != pixels, "pool keeps formats apart");
+
+        // surfaces keep their size class when resized in place
+        c.resize(10, 10);
+        check(c.detail()->pixels == pixels && c.capacity() == size2d(112, 64), "pool capacity");
+        c = canvas();
+        canvas reserved(20, 20, xrgb8888);
+        reserved.reserve(size2d(100, 60));
+        check(reserved.detail()->pixels == pixels && reserved.size() == size2d(20, 20)
+              && reserved.capacity() == size2d(112, 64), "pool reuse by reserve");
+
+        canvas::pool_budget(0);
+        check(canvas::pool_budget() == 0, "pool disabled");
+    }
+
+#ifdef JACUI_HAS_RVALUE_REFERENCES
+    // moves hand over the surface and leave the source empty
+    void test_move()
+    {
+        using namespace jacui;
+
+        canvas c(13, 7, xrgb8888);
+        fill_pattern(c);
+        SDL_Surface* p = c.detail();
+
+        canvas moved(std::move(c));
+        check(c.empty() && moved.detail() == p && p->refcount == 1, "canvas move");
+
+        canvas assigned(3, 2);
+        assigned = std::move(moved);
+        check(moved.empty() && assigned.detail() == p && has_pattern(assigned), "canvas move assignment");
+
+        std::vector<canvas> v;
+        v.push_back(std::move(assigned));
+        for (int i = 0; i != 16; ++i)
+            v.push_back(canvas(1, 1));
+        check(v[0].detail() == p && p->refcount == 1, "canvas moved by vector growth");
+    }
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    using namespace jacui;
+
+    test_formats();
+    test_conversion();
+    test_resize(rgb888, 24, 0);
+    test_resize(xrgb8888, 32, 0);
+    test_resize(argb8888, 32, 0xff000000);
+    test_pixel_layout(rgb888, 3);
+    test_pixel_layout(xrgb8888, 4);
+    test_pixel_layout(argb8888, 4);
+    test_pixel_access(xrgb8888);
+    test_pixel_access(argb8888);
+    test_unshare();
+    test_external();
+    test_capacity();
+    test_pool();
+#ifdef JACUI_HAS_RVALUE_REFERENCES
+    test_move();
+#endif
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,209 @@
+#include "jacui/image.hpp"
+
+#include "check.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#ifdef JACUI_HAVE_LIBPNG
+#include <png.h>
+#endif
+
+#ifdef JACUI_HAVE_LIBJPEG
+extern "C" {
+#include <jpeglib.h>
+}
+#endif
+
+namespace {
+    const int width = 64;
+    const int height = 48;
+
+    // constant in blocks of n x n pixels, so scaling by 1/n is exact
+    jacui::color block(int x, int y, int n)
+    {
+        return jacui::color(x / n * 50 + 10, y / n * 60 + 20, 230 - (x / n ^ y / n) * 40);
+    }
+
+    // whether an image shows the blocks reduced by a factor
+    bool has_blocks(const jacui::surface& s, int n, int scale, int tolerance)
+    {
+        for (int y = 0; y != int(s.height()); ++y) {
+            for (int x = 0; x != int(s.width()); ++x) {
+                jacui::color c = pixel(s, x, y);
+                jacui::color b = block(x * scale, y * scale, n);
+                if (std::abs(c.r - b.r) > tolerance || std::abs(c.g - b.g) > tolerance
+                    || std::abs(c.b - b.b) > tolerance)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // whether an image was decoded into RGB bytes in memory order,
+    // i.e. scaled while decoding
+    bool decoded_scaled(const jacui::surface& s)
+    {
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+        return s.detail()->format->Rmask == 0x000000ff;
+#else
+        return s.detail()->format->Rmask == (s.detail()->format->Amask ? 0xff000000 : 0xff0000);
+#endif
+    }
+
+    void test_fit_size()
+    {
+        using jacui::size2d;
+        using jacui::detail::fit_size;
+
+        check(fit_size(size2d(64, 48), size2d(16, 16)) == size2d(16, 12), "fit width");
+        check(fit_size(size2d(48, 64), size2d(16, 16)) == size2d(12, 16), "fit height");
+        check(fit_size(size2d(64, 48), size2d(0, 24)) == size2d(32, 24), "fit unbounded width");
+        check(fit_size(size2d(64, 48), size2d(0, 0)) == size2d(64, 48), "fit unbounded");
+        check(fit_size(size2d(64, 48), size2d(100, 100)) == size2d(64, 48), "fit never enlarges");
+        check(fit_size(size2d(1000, 1), size2d(10, 10)) == size2d(10, 1), "fit at least one pixel");
+    }
+
+    // formats without a scaling decoder are decoded in full and
+    // scaled with a box filter
+    void test_fallback()
+    {
+        using namespace jacui;
+
+        write_file("test_decode.bmp", make_bmp(width, height));
+
+        image full("test_decode.bmp");
+        image img("test_decode.bmp", size2d(16, 16));
+        check(img.size() == size2d(16, 12), "fallback size");
+
+        canvas expected(img.size(), xrgb8888);
+        expected.blit(full, rect2d(0, 0, 16, 12), surface::box);
+        check(same_colors(img, expected), "fallback pixels");
+
+        image same("test_decode.bmp", size2d(0, 0));
+        check(same_colors(same, full), "fallback unscaled");
+        std::remove("test_decode.bmp");
+    }
+
+#ifdef JACUI_HAVE_LIBPNG
+    void write_png(const char* filename, int n, bool alpha)
+    {
+        std::FILE* fp = std::fopen(filename, "wb");
+        png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+        png_infop info = png_create_info_struct(png);
+        png_init_io(png, fp);
+        png_set_IHDR(png, info, width, height, 8, alpha ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB,
+                     PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+        png_write_info(png, info);
+
+        std::vector<png_byte> row(width * 4);
+        for (int y = 0; y != height; ++y) {
+            png_bytep p = &row[0];
+            for (int x = 0; x != width; ++x) {
+                jacui::color c = block(x, y, n);
+                *p++ = c.r;
+                *p++ = c.g;
+                *p++ = c.b;
+                if (alpha)
+                    *p++ = 0x80;
+            }
+            png_write_row(png, &row[0]);
+        }
+        png_write_end(png, info);
+        png_destroy_write_struct(&png, &info);
+        std::fclose(fp);
+    }
+
+    // PNG files are averaged row by row while decoding
+    void test_png(bool alpha)
+    {
+        using namespace jacui;
+
+        write_png("test_decode.png", 4, alpha);
+        image img("test_decode.png", size2d(16, 16));
+        check(img.size() == size2d(16, 12), "PNG scaled size");
+        check(decoded_scaled(img), "PNG scaled while decoding");
+        check(has_blocks(img, 4, 4, 0), "PNG scaled pixels");
+        check(!alpha || pixel(img, 3, 5).a == 0x80, "PNG scaled alpha");
+
+        image half("test_decode.png", size2d(0, 24));
+        check(half.size() == size2d(32, 24) && has_blocks(half, 4, 2, 0), "PNG scaled by half");
+
+        image full("test_decode.png", size2d(width, height));
+        check(full.size() == size2d(width, height), "PNG not scaled");
+
+        image unlimited("test_decode.png", size2d(0, 0));
+        image plain("test_decode.png");
+        check(unlimited.size() == plain.size() && same_pixels(unlimited, plain, rect2d(plain.size())),
+              "PNG without a limit");
+        std::remove("test_decode.png");
+    }
+#endif
+
+#ifdef JACUI_HAVE_LIBJPEG
+    void write_jpeg(const char* filename, int n)
+    {
+        std::FILE* fp = std::fopen(filename, "wb");
+        jpeg_compress_struct cinfo;
+        jpeg_error_mgr err;
+        cinfo.err = jpeg_std_error(&err);
+        jpeg_create_compress(&cinfo);
+        jpeg_stdio_dest(&cinfo, fp);
+        cinfo.image_width = width;
+        cinfo.image_height = height;
+        cinfo.input_components = 3;
+        cinfo.in_color_space = JCS_RGB;
+        jpeg_set_defaults(&cinfo);
+        jpeg_set_quality(&cinfo, 95, TRUE);
+        jpeg_start_compress(&cinfo, TRUE);
+
+        std::vector<JSAMPLE> row(width * 3);
+        while (cinfo.next_scanline < cinfo.image_height) {
+            JSAMPROW p = &row[0];
+            for (int x = 0; x != width; ++x) {
+                jacui::color c = block(x, cinfo.next_scanline, n);
+                *p++ = c.r;
+                *p++ = c.g;
+                *p++ = c.b;
+            }
+            p = &row[0];
+            jpeg_write_scanlines(&cinfo, &p, 1);
+        }
+        jpeg_finish_compress(&cinfo);
+        jpeg_destroy_compress(&cinfo);
+        std::fclose(fp);
+    }
+
+    // JPEG files are reduced by DCT scaling while decoding
+    void test_jpeg()
+    {
+        using namespace jacui;
+
+        write_jpeg("test_decode.jpg", 16);
+        image img("test_decode.jpg", size2d(16, 16));
+        check(img.size() == size2d(16, 12), "JPEG scaled size");
+        check(decoded_scaled(img), "JPEG scaled while decoding");
+        check(has_blocks(img, 16, 4, 8), "JPEG scaled pixels");
+
+        image odd("test_decode.jpg", size2d(0, 20));
+        check(odd.size() == size2d(27, 20) && decoded_scaled(odd), "JPEG scaled to an odd size");
+        std::remove("test_decode.jpg");
+    }
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    test_fit_size();
+    test_fallback();
+#ifdef JACUI_HAVE_LIBPNG
+    test_png(false);
+    test_png(true);
+#endif
+#ifdef JACUI_HAVE_LIBJPEG
+    test_jpeg();
+#endif
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+#include "jacui/image.hpp"
+
+#include "check.hpp"
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+    typedef std::vector<unsigned char> bytes;
+
+    jacui::color gradient(int x, int y)
+    {
+        return jacui::color((x * 7 + y) & 0xff, (y * 3 + x * 5) & 0xff, (x ^ y) & 0xff);
+    }
+
+    // an opaque gradient in any pixel format
+    jacui::canvas make_canvas(int width, int height, jacui::pixel_format format)
+    {
+        using namespace jacui;
+
+        canvas res(width, height, format);
+        for (int y = 0; y != height; ++y)
+            for (int x = 0; x != width; ++x)
+                res.fill(gradient(x, y), rect2d(x, y, 1, 1));
+        return res;
+    }
+
+    // whether a surface has the gradient's colors
+    bool has_gradient(const jacui::surface& s, int width, int height)
+    {
+        if (s.size() != jacui::size2d(width, height))
+            return false;
+
+        for (int y = 0; y != height; ++y)
+            for (int x = 0; x != width; ++x)
+                if (pixel(s, x, y).rgb() != gradient(x, y).rgb())
+                    return false;
+        return true;
+    }
+
+    bytes read_file(const char* filename)
+    {
+        bytes res;
+        if (std::FILE* fp = std::fopen(filename, "rb")) {
+            int c;
+            while ((c = std::fgetc(fp)) != EOF)
+                res.push_back((unsigned char)c);
+            std::fclose(fp);
+        }
+        return res;
+    }
+
+    unsigned long le16(const bytes& b, std::size_t pos)
+    {
+        return b[pos] | (unsigned long)b[pos + 1] << 8;
+    }
+
+    unsigned long le32(const bytes& b, std::size_t pos)
+    {
+        return le16(b, pos) | le16(b, pos + 2) << 16;
+    }
+
+    // PPM files are read back by mapping them
+    void test_ppm(jacui::pixel_format format)
+    {
+        make_canvas(13, 7, format).save_ppm("test_encode.ppm");
+
+        jacui::image img;
+        img.map("test_encode.ppm");
+        check(has_gradient(img, 13, 7), "save_ppm pixels");
+        std::remove("test_encode.ppm");
+    }
+
+    // BMP files are written bottom-up, so the rows are compared here
+    void test_bmp(jacui::pixel_format format)
+    {
+        const int width = 13;
+        const int height = 7;
+        const std::size_t pitch = (width * 3 + 3) & ~3;
+
+        make_canvas(width, height, format).save_bmp("test_encode.bmp");
+        bytes b = read_file("test_encode.bmp");
+
+        bool ok = b.size() == 54 + height * pitch && b[0] == 'B' && b[1] == 'M'
+            && le32(b, 2) == b.size() && le32(b, 10) == 54 && le32(b, 14) == 40
+            && le32(b, 18) == std::size_t(width) && le32(b, 22) == std::size_t(height)
+            && le16(b, 26) == 1 && le16(b, 28) == 24 && le32(b, 30) == 0;
+        check(ok, "save_bmp header");
+
+        for (int y = 0; ok && y != height; ++y) {
+            const unsigned char* p = &b[54 + (height - 1 - y) * pitch];
+            for (int x = 0; ok && x != width; ++x, p += 3)
+                ok = jacui::color(p[2], p[1], p[0]).rgb() == gradient(x, y).rgb();
+        }
+        check(ok, "save_bmp pixels");
+        std::remove("test_encode.bmp");
+    }
+
+    // PNG files are checked by probing and decoding them
+    void test_png(jacui::pixel_format format, int width, int height, int level)
+    {
+        using namespace jacui;
+
+        make_canvas(width, height, format).save_png("test_encode.png", level);
+
+        image_info info = image::probe("test_encode.png");
+        check(info.size == size2d(width, height), "save_png size");
+        check(info.depth == (format == argb8888 ? 32u : 24u), "save_png depth");
+        check(info.alpha == (format == argb8888), "save_png alpha");
+
+        image img("test_encode.png");
+        check(has_gradient(img, width, height), "save_png pixels");
+        std::remove("test_encode.png");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    using namespace jacui;
+
+    test_ppm(rgb888);
+    test_ppm(xrgb8888);
+    test_ppm(argb8888);
+
+    test_bmp(rgb888);
+    test_bmp(xrgb8888);
+    test_bmp(argb8888);
+
+    test_png(rgb888, 13, 7, 6);
+    test_png(xrgb8888, 13, 7, 0);
+    test_png(argb8888, 13, 7, 9);
+    test_png(rgb888, 1, 1, 6);
+
+    // large enough to be compressed in several blocks, in parallel
+    concurrency(4);
+    test_png(xrgb8888, 600, 400, 6);
+    test_png(argb8888, 600, 400, 1);
+    concurrency(0);
+
+    return failed ? 1 : 0;
+}
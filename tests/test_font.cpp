@@ -0,0 +1,197 @@
+#include "jacui/font.hpp"
+#include "jacui/image.hpp"
+
+#include "check.hpp"
+#include "../examples/bitstream_vera.hpp"
+
+#include <SDL_ttf.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+    // a canvas that records the areas drawn to
+    class recorder: public jacui::canvas {
+    public:
+        recorder(std::size_t width, std::size_t height) : jacui::canvas(width, height) { }
+
+        void damage(const jacui::rect2d& r)
+        {
+            jacui::canvas::damage(r);
+            damaged.add(r);
+        }
+
+        jacui::region damaged;
+    };
+
+    std::string long_text(int n)
+    {
+        char buf[64];
+        std::sprintf(buf, "%d: the quick brown fox jumps over the lazy dog", n);
+        return buf;
+    }
+
+    // text rendered by SDL_ttf itself onto a background
+    jacui::canvas ttf_render(const Uint16* text, bool kerning, jacui::color fg, jacui::color bg)
+    {
+        TTF_Font* f = TTF_OpenFontRW(SDL_RWFromConstMem(bitstream_vera_ttf, sizeof bitstream_vera_ttf), 1, 16);
+#if SDL_VERSIONNUM(SDL_TTF_MAJOR_VERSION, SDL_TTF_MINOR_VERSION, SDL_TTF_PATCHLEVEL) >= SDL_VERSIONNUM(2, 0, 10)
+        TTF_SetFontKerning(f, kerning);
+#endif
+        jacui::image tmp(jacui::detail::make_surface(TTF_RenderUNICODE_Blended(f, text, jacui::detail::make_color(fg))));
+        TTF_CloseFont(f);
+
+        jacui::canvas res(tmp.size(), jacui::xrgb8888);
+        res.fill(bg);
+        res.blit(tmp);
+        return res;
+    }
+
+    jacui::canvas ttf_render(const std::wstring& text, bool kerning, jacui::color fg, jacui::color bg)
+    {
+        std::vector<Uint16> uc(text.begin(), text.end());
+        uc.push_back(0);
+        return ttf_render(&uc[0], kerning, fg, bg);
+    }
+
+    // whether two renderings differ at most by rounding
+    bool same_text(const jacui::surface& lhs, const jacui::surface& rhs)
+    {
+        if (lhs.size() != rhs.size())
+            return false;
+        for (int y = 0; y != int(lhs.height()); ++y) {
+            for (int x = 0; x != int(lhs.width()); ++x) {
+                jacui::color a = pixel(lhs, x, y), b = pixel(rhs, x, y);
+                if (std::abs(a.r - b.r) > 2 || std::abs(a.g - b.g) > 2 || std::abs(a.b - b.b) > 2)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // sizes of longer text are cached, sizes of short text are not
+    void test_size_cache()
+    {
+        using namespace jacui;
+
+        font f(bitstream_vera_ttf, sizeof bitstream_vera_ttf, 16);
+        std::string s = long_text(0);
+        std::wstring ws(s.begin(), s.end());
+
+        size2d size = f.size(s);
+        check(size.width > f.size("0: the").width && size.height > 0, "text size");
+        check(f.stats().hits == 0 && f.stats().misses == 1, "text size cache miss");
+        check(f.size(s) == size && f.stats().hits == 1, "text size cache hit");
+        check(f.size(ws) == size && f.stats().misses == 2, "wide text size");
+        check(f.size(ws) == size && f.stats().hits == 2, "wide text size cache hit");
+
+        f.size("short text");
+        f.size(L"short text");
+        check(f.stats().hits == 2 && f.stats().misses == 2, "short text not cached");
+        check(f.size("short text") == f.size(L"short text"), "short text size");
+        check(f.size("caf\xc3\xa9") == f.size(L"caf\xe9"), "UTF-8 text size");
+
+        // the least recently used sizes are dropped
+        for (int i = 1; i <= 1024; ++i)
+            f.size(long_text(i));
+        font::cache_stats stats = f.stats();
+        check(f.size(s) == size && f.stats().misses == stats.misses + 1, "text size cache limit");
+
+        // and all of them when the font is resized
+        f.resize(32);
+        stats = f.stats();
+        check(f.size(s).width > size.width && f.stats().misses == stats.misses + 1,
+              "text size cache cleared");
+    }
+
+    // drawing text at a baseline damages the area of its glyphs
+    void test_draw_damage()
+    {
+        using namespace jacui;
+
+        font f(bitstream_vera_ttf, sizeof bitstream_vera_ttf, 16);
+        recorder c(100, 50);
+        f.draw(c, "Hello", color(0xff, 0xff, 0xff), 10, 30);
+
+        rect2d r = c.damaged.bounds();
+        int top = 30 - f.ascent();
+        check(!r.empty() && r.x >= 10 && r.x + r.width <= 10 + f.size("Hello").width
+              && int(r.y) >= top && int(r.y + r.height) <= top + f.height(), "text damage");
+    }
+
+    // drawing text onto a copy leaves the original's pixels alone
+    void test_draw_unshare()
+    {
+        using namespace jacui;
+
+        font f(bitstream_vera_ttf, sizeof bitstream_vera_ttf, 16);
+        canvas c(100, 50, xrgb8888);
+        canvas copy(c);
+        f.draw(copy, "Hello", color(0xff, 0xff, 0xff), 10, 30);
+
+        bool blank = true;
+        for (int y = 0; y != 50; ++y)
+            for (int x = 0; x != 100; ++x)
+                blank = blank && pixel(c, x, y).rgb() == 0;
+        check(blank && copy.detail() != c.detail(), "text drawn onto a copy");
+    }
+
+    // kerned or not, text looks as if rendered by SDL_ttf
+    void test_kerning()
+    {
+        using namespace jacui;
+
+        const color fg(0xff, 0xff, 0xff), bg(0x20, 0x40, 0x80);
+        const std::wstring text = L"AVATAR To WAVY";
+
+        font f(bitstream_vera_ttf, sizeof bitstream_vera_ttf, 16);
+        canvas kerned = ttf_render(text, true, fg, bg);
+        check(f.size(text) == kerned.size(), "kerned text size");
+        check(same_text(f.render(text, fg, bg), kerned), "kerned text");
+        check(same_text(f.render(std::string(text.begin(), text.end()), fg, bg), kerned),
+              "kerned UTF-8 text");
+
+        canvas c(kerned.size(), xrgb8888);
+        c.fill(bg);
+        f.draw(c, text, fg, 0, f.ascent());
+        check(same_text(c, kerned), "kerned text drawn");
+
+        f.kerning(false);
+        canvas unkerned = ttf_render(text, false, fg, bg);
+        check(!f.kerning() && f.size(text) == unkerned.size(), "unkerned text size");
+        check(same_text(f.render(text, fg, bg), unkerned), "unkerned text");
+
+        font copy(f, 16);
+        check(!copy.kerning() && same_text(copy.render(text, fg, bg), unkerned),
+              "kerning disabled in a copy");
+    }
+
+    // more glyphs than fit in the glyph cache are drawn just the same
+    void test_glyph_limit()
+    {
+        using namespace jacui;
+
+        const color fg(0xff, 0xff, 0xff), bg(0, 0, 0);
+        std::wstring text;
+        for (wchar_t ch = 0x100; ch != 0x580; ++ch)
+            text += ch;
+
+        font f(bitstream_vera_ttf, sizeof bitstream_vera_ttf, 16);
+        f.kerning(false);
+        check(same_text(f.render(text, fg, bg), ttf_render(text, false, fg, bg)), "glyph cache limit");
+        check(same_text(f.render(text, fg, bg), ttf_render(text, false, fg, bg)), "glyph cache refilled");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    test_size_cache();
+    test_draw_damage();
+    test_draw_unshare();
+    test_kerning();
+    test_glyph_limit();
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,371 @@
+#include "jacui/cache.hpp"
+#include "jacui/image.hpp"
+#include "jacui/prefetcher.hpp"
+#include "jacui/window.hpp"
+#include "jacui/error.hpp"
+
+#include "check.hpp"
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    const char* const filename = "test_image.bmp";
+
+    // a background load decodes the same image as a foreground one
+    void test_load_async()
+    {
+        using namespace jacui;
+
+        image_future f = image::load_async(filename);
+        check(f.valid(), "load_async valid");
+        f.wait();
+        check(f.ready(), "load_async ready");
+
+        image img = f.get();
+        check(same_colors(img, image(filename)), "load_async image");
+        check(f.get().empty(), "load_async image retrieved once");
+
+        image_future copy = image::load_async(filename);
+        image_future other(copy);
+        check(!copy.get().empty() && other.get().empty(), "load_async copies");
+
+        bool thrown = false;
+        image_future missing = image::load_async("test_image.missing");
+        try {
+            missing.get();
+        } catch (const error&) {
+            thrown = true;
+        }
+        check(thrown, "load_async of a missing file");
+    }
+
+    // finished loads are signalled through an event queue
+    void test_load_event()
+    {
+        using namespace jacui;
+
+        window w("test_image", 64, 48);
+        image_future f1 = image::load_async(filename, w.events());
+        image_future f2 = image::load_async(filename, w.events());
+
+        int n1 = 0, n2 = 0;
+        while (n1 + n2 != 2) {
+            event* e = w.events().wait();
+            n1 += f1.matches(e);
+            n2 += f2.matches(e);
+        }
+        check(n1 == 1 && n2 == 1 && f1.ready() && f2.ready(), "load_async events");
+        check(same_colors(f1.get(), f2.get()), "load_async event images");
+    }
+
+    // the order in which jobs start
+    struct job_log {
+        job_log() : mutex(SDL_CreateMutex()), cond(SDL_CreateCond()), started(0), released(false) { }
+
+        ~job_log()
+        {
+            SDL_DestroyCond(cond);
+            SDL_DestroyMutex(mutex);
+        }
+
+        SDL_mutex* mutex;
+        SDL_cond* cond;
+        int started;
+        bool released;
+    };
+
+    class logged_job: public jacui::detail::job {
+    public:
+        logged_job(job_log& log, int priority, int* start, bool blocks)
+            : job(priority), log_(log), start_(start), blocks_(blocks)
+        {
+        }
+
+        void run()
+        {
+            SDL_LockMutex(log_.mutex);
+            int n = log_.started++;
+            if (start_)
+                *start_ = n;
+            while (blocks_ && !log_.released)
+                SDL_CondWait(log_.cond, log_.mutex);
+            SDL_UnlockMutex(log_.mutex);
+        }
+
+    private:
+        job_log& log_;
+        int* start_;
+        bool blocks_;
+    };
+
+    // a queued job runs by its current priority
+    void test_reprioritize()
+    {
+        using namespace jacui::detail;
+
+        // more blocking jobs than there are background threads
+        const int blockers = 256;
+        job_log log;
+        for (int i = 0; i != blockers; ++i)
+            post_job(new logged_job(log, 100, 0, true));
+
+        int lower = -1, raised = -1;
+        post_job(new logged_job(log, 0, &lower, false));
+        logged_job* pj = new logged_job(log, -1, &raised, false);
+        post_job(pj);
+        check(reprioritize_job(pj, 200), "queued job reprioritized");
+
+        SDL_LockMutex(log.mutex);
+        log.released = true;
+        SDL_CondBroadcast(log.cond);
+        SDL_UnlockMutex(log.mutex);
+
+        for (bool done = false; !done; SDL_Delay(1)) {
+            SDL_LockMutex(log.mutex);
+            done = log.started == blockers + 2;
+            SDL_UnlockMutex(log.mutex);
+        }
+        check(raised < blockers && lower == blockers + 1, "jobs run by priority");
+    }
+
+    // a prefetcher steps through files and decodes them in the background
+    void test_prefetcher()
+    {
+        using namespace jacui;
+
+        std::vector<std::string> files;
+        for (int i = 0; i != 4; ++i) {
+            char name[32];
+            std::sprintf(name, "test_prefetch%d.bmp", i);
+            write_file(name, make_bmp(8 + i, 6));
+            files.push_back(name);
+        }
+        files.push_back("test_prefetch.missing");
+
+        image_prefetcher p(files, 2, 1);
+        check(p.size() == 5 && p.index() == 0, "prefetcher position");
+        check(same_colors(p.current(), image(files[0].c_str())) && p.ready(), "prefetcher image");
+
+        p.prev();
+        check(p.index() == 4 && p.filename() == files[4], "prefetcher wraps around");
+        bool thrown = false;
+        try {
+            p.current();
+        } catch (const error&) {
+            thrown = true;
+        }
+        check(thrown && p.ready(), "prefetcher missing file");
+
+        // moving back and forth keeps decoding in the background
+        p.prev();
+        p.next();
+        p.seek(2);
+        check(same_colors(p.current(), image(files[2].c_str())), "prefetcher seek");
+        check(p.bytes() > 0, "prefetcher bytes");
+
+        // with an event queue, images can be shown once ready
+        window w("test_image", 64, 48);
+        image_prefetcher q(files, w.events());
+        q.next();
+        while (!q.ready()) {
+            event* e = w.events().wait();
+            q.update(e);
+        }
+        check(same_colors(q.current(), image(files[1].c_str())), "prefetcher event");
+
+        for (int i = 0; i != 4; ++i)
+            std::remove(files[i].c_str());
+    }
+
+    // cached images are shared until evicted, and stay valid after
+    void test_cache()
+    {
+        using namespace jacui;
+
+        image_cache cache;
+        image img = cache.get(filename);
+        check(same_colors(img, image(filename)), "cached image");
+        check(cache.get(filename).detail() == img.detail() && cache.stats().hits == 1, "cache hit");
+
+        image converted = cache.get(filename, argb8888);
+        check(converted.detail()->format->Amask && same_colors(converted, img), "cached image converted");
+        check(cache.stats().misses == 2 && cache.stats().entries == 2, "cache entries");
+
+        cache.budget(0);
+        check(cache.stats().entries == 0 && cache.stats().evictions == 2, "cache evicted");
+        cache.budget(1 << 20);
+        cache.get(filename);
+        cache.clear();
+        check(cache.stats().entries == 0 && same_colors(img, image(filename))
+              && same_colors(converted, img), "evicted images valid");
+    }
+
+    // converting keeps which pixels are transparent
+    void test_convert()
+    {
+        using namespace jacui;
+
+        image img(detail::make_surface(13, 7, xrgb8888));
+        fill_pattern(img);
+        color key = pattern(2, 1);
+        SDL_SetColorKey(img.detail(), SDL_SRCCOLORKEY, SDL_MapRGB(img.detail()->format, key.r, key.g, key.b));
+
+        image converted(detail::convert_surface(img.detail(), rgb888));
+        check(converted.detail()->format->BytesPerPixel == 3 && same_colors(converted, img), "converted image");
+
+        canvas c(13, 7, xrgb8888);
+        c.blit(converted);
+        check(pixel(c, 2, 1).rgb() == 0 && pixel(c, 3, 1).rgb() == pattern(3, 1).rgb(),
+              "converted colorkey");
+
+        SDL_SetColorKey(img.detail(), 0, 0);
+        SDL_SetAlpha(img.detail(), SDL_SRCALPHA, 0x80);
+        image blended(detail::convert_surface(img.detail(), argb8888));
+        check((blended.detail()->flags & SDL_SRCALPHA) && blended.detail()->format->alpha == 0x80,
+              "converted alpha");
+    }
+
+    // the test pattern with its 2x2 pixel blocks averaged n times
+    jacui::color halved(int x, int y, int n)
+    {
+        if (n == 0)
+            return pattern(x, y);
+
+        jacui::color c0 = halved(2 * x, 2 * y, n - 1);
+        jacui::color c1 = halved(2 * x + 1, 2 * y, n - 1);
+        jacui::color c2 = halved(2 * x, 2 * y + 1, n - 1);
+        jacui::color c3 = halved(2 * x + 1, 2 * y + 1, n - 1);
+        return jacui::color((c0.r + c1.r + c2.r + c3.r + 2) >> 2,
+                            (c0.g + c1.g + c2.g + c3.g + 2) >> 2,
+                            (c0.b + c1.b + c2.b + c3.b + 2) >> 2);
+    }
+
+    bool has_halved(const jacui::surface& s, int n)
+    {
+        for (int y = 0; y != int(s.height()); ++y)
+            for (int x = 0; x != int(s.width()); ++x)
+                if (pixel(s, x, y).rgb() != halved(x, y, n).rgb())
+                    return false;
+        return true;
+    }
+
+    // the mip level a blit to a 16x8 rectangle reads from
+    jacui::image level16x8(const jacui::image& img)
+    {
+        SDL_Rect src = { 0, 0, Uint16(img.width()), Uint16(img.height()) };
+        SDL_Rect dst = { 0, 0, 16, 8 };
+        return jacui::image(jacui::detail::mipmap(img.detail(), src, dst));
+    }
+
+    // scaled-down blits read from mip levels, which are built once,
+    // shared by images with the same pixels, and dropped when the
+    // image is drawn onto
+    void test_mipmaps()
+    {
+        using namespace jacui;
+
+        image img(detail::make_surface(64, 32, xrgb8888));
+        fill_pattern(img);
+        check(!img.mipmaps() && level16x8(img).empty(), "mipmaps disabled by default");
+
+        img.mipmaps(true);
+        check(img.mipmaps(), "mipmaps enabled");
+
+        canvas quarter(16, 8, xrgb8888);
+        quarter.blit(img, rect2d(0, 0, 64, 32), rect2d(0, 0, 16, 8), surface::nearest);
+        check(has_halved(quarter, 2), "mipmap blit");
+
+        image level = level16x8(img);
+        check(level.size() == size2d(16, 8) && has_halved(level, 2), "mipmap level");
+        check(level16x8(img).detail() == level.detail(), "mipmap level reused");
+
+        image shared(detail::share_surface(img.detail()));
+        check(shared.mipmaps() && level16x8(shared).detail() == level.detail(),
+              "mipmap level shared");
+
+        image copy(img);
+        check(copy.mipmaps() && level16x8(copy).detail() == level.detail(),
+              "mipmap level shared by a copy");
+
+        // the blit must not read the stale level
+        img.fill(color(10, 20, 30));
+        quarter.blit(img, rect2d(0, 0, 64, 32), rect2d(0, 0, 16, 8), surface::nearest);
+        check(pixel(quarter, 5, 3).rgb() == color(10, 20, 30).rgb(), "mipmap dropped after drawing");
+        check(pixel(level16x8(img), 5, 3).rgb() == color(10, 20, 30).rgb(), "mipmap level rebuilt");
+        check(has_halved(level, 2), "mipmap level still referenced");
+
+        img.mipmaps(false);
+        check(!img.mipmaps() && level16x8(img).empty(), "mipmaps disabled");
+        check(copy.mipmaps() && has_halved(level16x8(copy), 2), "mipmaps of a copy kept");
+    }
+
+    // images sharing a surface, e.g. from an image_cache, copy it
+    // before drawing onto it
+    void test_unshare()
+    {
+        using namespace jacui;
+
+        image img(detail::make_surface(13, 7, xrgb8888));
+        fill_pattern(img);
+
+        image shared(detail::share_surface(img.detail()));
+        image copy(img);
+        check(copy.detail() == img.detail(), "image copy shares pixels");
+
+        copy.fill(color(1, 2, 3), rect2d(0, 0, 1, 1));
+        check(copy.detail() != img.detail() && shared.detail() == img.detail(), "image copy unshared");
+        check(pixel(copy, 0, 0).rgb() == 0x010203 && has_pattern(img), "image copy drawn onto");
+
+        // the last reference draws in place
+        SDL_Surface* p = copy.detail();
+        copy.fill(color(4, 5, 6), rect2d(1, 0, 1, 1));
+        check(copy.detail() == p && pixel(copy, 1, 0).rgb() == 0x040506, "image drawn in place");
+
+        shared.pixels().row<Uint32>(0)[0] = 0;
+        check(shared.detail() != img.detail() && has_pattern(img), "image pixels unshared");
+    }
+
+#ifdef JACUI_HAS_RVALUE_REFERENCES
+    // moves hand over the surface or load and leave the source empty
+    void test_move()
+    {
+        using namespace jacui;
+
+        image img(filename);
+        SDL_Surface* p = img.detail();
+        image moved(std::move(img));
+        check(img.empty() && moved.detail() == p && p->refcount == 1, "image move");
+
+        img = std::move(moved);
+        check(moved.empty() && img.detail() == p && p->refcount == 1, "image move assignment");
+
+        image_future f = image::load_async(filename);
+        image_future g(std::move(f));
+        check(!f.valid() && g.valid(), "image_future move");
+        f = std::move(g);
+        check(f.valid() && !g.valid() && !f.get().empty(), "image_future move assignment");
+    }
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    write_file(filename, make_bmp(13, 7));
+    test_load_async();
+    test_load_event();
+    test_reprioritize();
+    test_prefetcher();
+    test_cache();
+    test_convert();
+    test_mipmaps();
+    test_unshare();
+#ifdef JACUI_HAS_RVALUE_REFERENCES
+    test_move();
+#endif
+    std::remove(filename);
+
+    return failed ? 1 : 0;
+}
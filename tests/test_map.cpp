@@ -0,0 +1,243 @@
+#include "jacui/error.hpp"
+#include "jacui/image.hpp"
+
+#include "check.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+    typedef std::vector<unsigned char> bytes;
+
+    const int width = 5;
+    const int height = 3;
+
+    // a binary PPM of the test pattern, or a PGM of its red channel
+    bytes make_pnm(bool gray)
+    {
+        char header[32];
+        std::sprintf(header, "%s\n# comment\n%d %d\n255\n", gray ? "P5" : "P6", width, height);
+        bytes b(header, header + std::strlen(header));
+        for (int y = 0; y != height; ++y) {
+            for (int x = 0; x != width; ++x) {
+                jacui::color c = pattern(x, y);
+                b.push_back(c.r);
+                if (!gray) {
+                    b.push_back(c.g);
+                    b.push_back(c.b);
+                }
+            }
+        }
+        return b;
+    }
+
+    // an uncompressed top-down BMP, or a bottom-up one, with 32 bit
+    // pixels aligned
+    bytes make_bmp(int depth, bool top_down)
+    {
+        std::size_t offset = depth == 32 ? 56 : 54;
+        std::size_t pitch = (width * depth + 31) / 32 * 4;
+        bytes b(offset + height * pitch);
+        b[0] = 'B';
+        b[1] = 'M';
+        put_le(b, 2, b.size(), 4);
+        put_le(b, 10, offset, 4);
+        put_le(b, 14, 40, 4);
+        put_le(b, 18, width, 4);
+        put_le(b, 22, top_down ? -height : height, 4);
+        put_le(b, 26, 1, 2);
+        put_le(b, 28, depth, 2);
+        for (int y = 0; y != height; ++y) {
+            unsigned char* p = &b[offset + (top_down ? y : height - 1 - y) * pitch];
+            for (int x = 0; x != width; ++x, p += depth / 8) {
+                jacui::color c = pattern(x, y);
+                p[0] = c.b;
+                p[1] = c.g;
+                p[2] = c.r;
+                if (depth == 32)
+                    p[3] = 0xff;
+            }
+        }
+        return b;
+    }
+
+    // an uncompressed TGA with a top-left or bottom-left origin, with
+    // an image id which aligns 32 bit pixels
+    bytes make_tga(int depth, bool top_left)
+    {
+        std::size_t offset = depth == 32 ? 20 : 18;
+        bytes b(offset + width * height * depth / 8);
+        b[0] = (unsigned char)(offset - 18);
+        b[2] = 2;
+        put_le(b, 12, width, 2);
+        put_le(b, 14, height, 2);
+        b[16] = (unsigned char)depth;
+        b[17] = (unsigned char)((top_left ? 0x20 : 0) | (depth == 32 ? 8 : 0));
+        unsigned char* p = &b[offset];
+        for (int y = 0; y != height; ++y) {
+            for (int x = 0; x != width; ++x, p += depth / 8) {
+                jacui::color c = pattern(x, y);
+                p[0] = c.b;
+                p[1] = c.g;
+                p[2] = c.r;
+                if (depth == 32)
+                    p[3] = 0xff;
+            }
+        }
+        return b;
+    }
+
+    bool layout(const bytes& b, jacui::detail::raw_layout& l)
+    {
+        return jacui::detail::layout_raw(jacui::detail::shared_data(&b[0], b.size()), l);
+    }
+
+    bool has_layout(const bytes& b, std::size_t offset, std::size_t pitch, int depth, bool gray)
+    {
+        jacui::detail::raw_layout l;
+        return layout(b, l) && l.offset == offset && l.width == std::size_t(width)
+            && l.height == std::size_t(height) && l.pitch == pitch && l.depth == depth
+            && l.gray == gray;
+    }
+
+    bool no_layout(const bytes& b)
+    {
+        jacui::detail::raw_layout l;
+        return !layout(b, l);
+    }
+
+    // map a file and compare its pixels with the test pattern
+    bool maps_pattern(const bytes& b, const char* filename, bool gray)
+    {
+        write_file(filename, b);
+
+        jacui::image img;
+        img.map(filename);
+        bool res = img.size() == jacui::size2d(width, height);
+        for (int y = 0; res && y != height; ++y) {
+            for (int x = 0; res && x != width; ++x) {
+                jacui::color c = pixel(img, x, y);
+                jacui::color p = pattern(x, y);
+                res = gray ? c.r == p.r && c.g == p.r && c.b == p.r : c.rgb() == p.rgb();
+            }
+        }
+        std::remove(filename);
+        return res;
+    }
+
+    // headers of files that can be mapped
+    void test_layouts()
+    {
+        bytes ppm = make_pnm(false);
+        bytes pgm = make_pnm(true);
+        check(has_layout(ppm, ppm.size() - width * height * 3, width * 3, 24, false), "PPM layout");
+        check(has_layout(pgm, pgm.size() - width * height, width, 8, true), "PGM layout");
+        check(has_layout(make_bmp(24, true), 54, 16, 24, false), "24 bit BMP layout");
+        check(has_layout(make_bmp(32, true), 56, width * 4, 32, false), "32 bit BMP layout");
+        check(has_layout(make_tga(24, true), 18, width * 3, 24, false), "24 bit TGA layout");
+        check(has_layout(make_tga(32, true), 20, width * 4, 32, false), "32 bit TGA layout");
+    }
+
+    // files that must be decoded instead
+    void test_rejected()
+    {
+        check(no_layout(make_bmp(24, false)), "bottom-up BMP");
+        check(no_layout(make_tga(24, false)), "bottom-left TGA");
+
+        std::string s = "P6 5 3 65535\n";
+        bytes ppm16(s.begin(), s.end());
+        ppm16.resize(ppm16.size() + width * height * 6);
+        check(no_layout(ppm16), "16 bit PPM");
+
+        // fits() rejects missing pixels, but not missing row padding
+        bytes ppm = make_pnm(false);
+        ppm.pop_back();
+        check(no_layout(ppm), "truncated PPM");
+        bytes bmp = make_bmp(24, true);
+        bmp.resize(bmp.size() - 1);
+        check(!no_layout(bmp), "BMP without last row padding");
+        bmp.resize(bmp.size() - 1);
+        check(no_layout(bmp), "truncated BMP");
+
+        // 32 bit pixels at an unaligned offset
+        bytes tga = make_tga(32, true);
+        tga[0] = 3;
+        tga.insert(tga.begin() + 20, 0);
+        check(no_layout(tga), "misaligned TGA");
+    }
+
+    void test_map()
+    {
+        check(maps_pattern(make_pnm(false), "test_map.ppm", false), "map PPM");
+        check(maps_pattern(make_pnm(true), "test_map.pgm", true), "map PGM");
+        check(maps_pattern(make_bmp(24, true), "test_map.bmp", false), "map 24 bit BMP");
+        check(maps_pattern(make_bmp(32, true), "test_map.bmp", false), "map 32 bit BMP");
+        check(maps_pattern(make_tga(24, true), "test_map.tga", false), "map 24 bit TGA");
+        check(maps_pattern(make_tga(32, true), "test_map.tga", false), "map 32 bit TGA");
+    }
+
+    bool has_bytes(const jacui::detail::shared_data& data, const bytes& b)
+    {
+        return data.size() == b.size() && std::memcmp(data.data(), &b[0], b.size()) == 0;
+    }
+
+    struct map_args {
+        const jacui::detail::shared_data* first;
+        bool shared;
+    };
+
+    void map_band(void* arg, int begin, int end)
+    {
+        map_args* args = static_cast<map_args*>(arg);
+        for (int i = begin; i != end; ++i) {
+            jacui::detail::shared_data data = jacui::detail::shared_data::map("test_map.dat");
+            if (data.data() != args->first->data())
+                args->shared = false;
+        }
+    }
+
+    // read-only mappings of the same version of a file are shared
+    void test_shared_data()
+    {
+        using jacui::detail::shared_data;
+
+        bytes old_bytes(100, 'a');
+        write_file("test_map.dat", old_bytes);
+        shared_data data = shared_data::map("test_map.dat");
+        check(has_bytes(data, old_bytes), "mapped data");
+        check(shared_data::map("./test_map.dat").data() == data.data(), "mapping shared by file");
+        check(shared_data::map("test_map.dat", true).data() != data.data(), "private mapping");
+
+        map_args args = { &data, true };
+        jacui::detail::parallel_for(64, 1, map_band, &args);
+        check(args.shared, "mapping shared by threads");
+
+        // replacing a file gives a new mapping, not the old one
+        bytes new_bytes(200, 'b');
+        write_file("test_map.tmp", new_bytes);
+        std::remove("test_map.dat");
+        std::rename("test_map.tmp", "test_map.dat");
+        shared_data replaced = shared_data::map("test_map.dat");
+        check(has_bytes(replaced, new_bytes) && has_bytes(data, old_bytes), "replaced file mapped");
+        std::remove("test_map.dat");
+
+        bool thrown = false;
+        try {
+            shared_data::map("test_map.dat");
+        } catch (const jacui::error&) {
+            thrown = true;
+        }
+        check(thrown, "missing file");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    test_layouts();
+    test_rejected();
+    test_map();
+    test_shared_data();
+
+    return failed ? 1 : 0;
+}
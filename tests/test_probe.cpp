@@ -0,0 +1,137 @@
+#include "jacui/image.hpp"
+#include "jacui/error.hpp"
+
+#include "check.hpp"
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+    bool same_info(const jacui::image_info& info, std::size_t width, std::size_t height,
+                   std::size_t depth, bool alpha, std::size_t frames)
+    {
+        return info.size == jacui::size2d(width, height) && info.depth == depth
+            && info.alpha == alpha && info.frames == frames;
+    }
+
+    bool probe_fails(const void* data, std::size_t size)
+    {
+        try {
+            jacui::image::probe(data, size);
+            return false;
+        } catch (const jacui::error&) {
+            return true;
+        }
+    }
+
+    bool probe_fails(const char* filename)
+    {
+        try {
+            jacui::image::probe(filename);
+            return false;
+        } catch (const jacui::error&) {
+            return true;
+        }
+    }
+
+    // a PNG signature and header chunk, without image data
+    std::vector<unsigned char> png_header(int width, int height, int depth, int type)
+    {
+        static const unsigned char header[33] = {
+            0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n', 0, 0, 0, 13, 'I', 'H', 'D', 'R'
+        };
+        std::vector<unsigned char> b(header, header + sizeof header);
+        for (int i = 0; i != 4; ++i) {
+            b[16 + i] = (unsigned char)(width >> (24 - 8 * i) & 0xff);
+            b[20 + i] = (unsigned char)(height >> (24 - 8 * i) & 0xff);
+        }
+        b[24] = (unsigned char)depth;
+        b[25] = (unsigned char)type;
+        return b;
+    }
+
+    // headers of files on disk and in memory
+    void test_files()
+    {
+        using namespace jacui;
+
+        write_file("test_probe.bmp", make_bmp(13, 7));
+        check(same_info(image::probe("test_probe.bmp"), 13, 7, 24, false, 1), "probe BMP");
+        std::remove("test_probe.bmp");
+
+        std::vector<unsigned char> png = png_header(13, 7, 8, 2);
+        check(same_info(image::probe(&png[0], png.size()), 13, 7, 24, false, 1), "probe RGB PNG");
+        png = png_header(5, 9, 8, 6);
+        check(same_info(image::probe(&png[0], png.size()), 5, 9, 32, true, 1), "probe RGBA PNG");
+        png = png_header(300, 2, 16, 0);
+        check(same_info(image::probe(&png[0], png.size()), 300, 2, 16, false, 1), "probe gray PNG");
+        png[25] = 5;
+        check(probe_fails(&png[0], png.size()), "probe invalid PNG color type");
+
+        check(probe_fails("test_probe.missing"), "probe missing file");
+    }
+
+    // headers of files the library writes
+    void test_saved()
+    {
+        using namespace jacui;
+
+        canvas c1(13, 7, rgb888);
+        fill_pattern(c1);
+        c1.save_png("test_probe.png");
+        c1.save_bmp("test_probe.bmp");
+        check(same_info(image::probe("test_probe.png"), 13, 7, 24, false, 1), "probe saved RGB PNG");
+        check(same_info(image::probe("test_probe.bmp"), 13, 7, 24, false, 1), "probe saved BMP");
+
+        canvas c2(5, 9, argb8888);
+        c2.fill(color(1, 2, 3, 4));
+        c2.save_png("test_probe.png");
+        check(same_info(image::probe("test_probe.png"), 5, 9, 32, true, 1), "probe saved RGBA PNG");
+
+        std::remove("test_probe.png");
+        std::remove("test_probe.bmp");
+    }
+
+    // headers of formats the library does not write
+    void test_headers()
+    {
+        using namespace jacui;
+
+        // 3x2 with a 4 color global table, a transparent color and two frames
+        static const unsigned char gif[] = {
+            'G', 'I', 'F', '8', '9', 'a', 3, 0, 2, 0, 0x81, 0, 0,
+            0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3,
+            0x21, 0xf9, 4, 1, 0, 0, 0, 0,
+            0x2c, 0, 0, 0, 0, 3, 0, 2, 0, 0, 2, 1, 0, 0,
+            0x2c, 0, 0, 0, 0, 3, 0, 2, 0, 0, 2, 1, 0, 0,
+            0x3b
+        };
+        check(same_info(image::probe(gif, sizeof gif), 3, 2, 2, true, 2), "probe GIF");
+
+        // APP0 segment followed by a baseline frame header, 640x480 YCbCr
+        static const unsigned char jpeg[] = {
+            0xff, 0xd8, 0xff, 0xe0, 0, 4, 0, 0,
+            0xff, 0xc0, 0, 17, 8, 0x01, 0xe0, 0x02, 0x80, 3
+        };
+        check(same_info(image::probe(jpeg, sizeof jpeg), 640, 480, 24, false, 1), "probe JPEG");
+
+        // 32 bit true color with a top-left origin
+        static const unsigned char tga[18] = {
+            0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 300 & 0xff, 300 >> 8, 200, 0, 32, 0x28
+        };
+        check(same_info(image::probe(tga, sizeof tga), 300, 200, 32, true, 1), "probe TGA");
+
+        static const unsigned char text[] = "not an image";
+        check(probe_fails(text, sizeof text), "probe unknown format");
+        check(probe_fails(jpeg, 10), "probe truncated JPEG");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    test_files();
+    test_saved();
+    test_headers();
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+#include "jacui/canvas.hpp"
+#include "jacui/error.hpp"
+
+#include "check.hpp"
+
+#include <cstdio>
+
+namespace {
+    const char* const filename = "test_raw.jcanvas";
+
+    // whether two surfaces have the same pixel format
+    bool same_format(const jacui::surface& lhs, const jacui::surface& rhs)
+    {
+        const SDL_PixelFormat* a = lhs.detail()->format;
+        const SDL_PixelFormat* b = rhs.detail()->format;
+        return a->BitsPerPixel == b->BitsPerPixel && a->Rmask == b->Rmask
+            && a->Gmask == b->Gmask && a->Bmask == b->Bmask && a->Amask == b->Amask;
+    }
+
+    bool map_fails(const char* name)
+    {
+        try {
+            jacui::canvas c;
+            c.map_raw(name);
+            return false;
+        } catch (const jacui::error&) {
+            return true;
+        }
+    }
+
+    // a snapshot restores the same pixels in the same format
+    void test_round_trip(jacui::pixel_format format)
+    {
+        using namespace jacui;
+
+        canvas c(13, 7, format);
+        fill_pattern(c);
+        c.save_raw(filename);
+
+        canvas m;
+        m.map_raw(filename);
+        check(m.size() == c.size(), "snapshot size");
+        check(same_format(m, c), "snapshot format");
+        check(same_pixels(c, m, rect2d(0, 0, 13, 7)), "snapshot pixels");
+
+        // drawing onto the mapped canvas leaves the file unchanged
+        m.fill(color(0, 0, 0));
+        canvas again;
+        again.map_raw(filename);
+        check(same_pixels(c, again, rect2d(0, 0, 13, 7)), "snapshot file unchanged");
+    }
+
+    void test_invalid()
+    {
+        using namespace jacui;
+
+        static const char ppm[] = "P6\n3 2\n255\n000000000000000000";
+        write_file("test_raw.ppm", std::vector<unsigned char>(ppm, ppm + sizeof ppm - 1));
+        check(map_fails("test_raw.ppm"), "map_raw of a PPM file");
+        std::remove("test_raw.ppm");
+
+        canvas c(3, 2);
+        c.save_raw(filename);
+        if (std::FILE* fp = std::fopen(filename, "r+b")) {
+            // the byte order field
+            std::fseek(fp, 12, SEEK_SET);
+            std::fputc(3, fp);
+            std::fclose(fp);
+        }
+        check(map_fails(filename), "map_raw with another byte order");
+
+        check(map_fails("test_raw.missing"), "map_raw of a missing file");
+
+        std::remove(filename);
+        canvas palette(detail::make_surface(SDL_CreateRGBSurface(SDL_SWSURFACE, 4, 4, 8, 0, 0, 0, 0)));
+        try {
+            palette.save_raw(filename);
+            check(false, "save_raw of a canvas with a palette");
+        } catch (const error&) {
+        }
+        std::FILE* fp = std::fopen(filename, "rb");
+        check(!fp, "no file for a canvas with a palette");
+        if (fp)
+            std::fclose(fp);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    using namespace jacui;
+
+    test_round_trip(rgb888);
+    test_round_trip(xrgb8888);
+    test_round_trip(argb8888);
+    test_invalid();
+
+    std::remove(filename);
+    return failed ? 1 : 0;
+}
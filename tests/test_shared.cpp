@@ -0,0 +1,160 @@
+#include "jacui/shared.hpp"
+#include "jacui/error.hpp"
+
+#include "check.hpp"
+
+#include <SDL.h>
+#include <SDL_thread.h>
+
+namespace {
+    const char* const name = "/jacui-test-shared";
+
+    // whether a frame has a single color, and which
+    bool is_uniform(jacui::surface& s, jacui::color& c)
+    {
+        c = pixel(s, 0, 0);
+        for (int y = 0; y != int(s.height()); ++y)
+            for (int x = 0; x != int(s.width()); ++x)
+                if (pixel(s, x, y).rgb() != c.rgb())
+                    return false;
+        return true;
+    }
+
+    void test_publish(jacui::pixel_format format)
+    {
+        using namespace jacui;
+
+        shared_canvas writer(name, size2d(13, 7), format);
+        shared_canvas reader(name);
+        check(writer.writable() && !reader.writable(), "shared writable");
+        check(reader.size() == size2d(13, 7) && reader.format() == format, "shared header");
+
+        canvas dst(13, 7, xrgb8888);
+        check(!reader.draw(dst, point2d(0, 0)), "shared draw before publish");
+        check(writer.generation() == 0 && reader.generation() == 0, "shared generation 0");
+
+        fill_pattern(writer.view());
+        writer.publish();
+        check(reader.generation() == 1, "shared generation 1");
+        check(reader.draw(dst, point2d(0, 0)) && has_pattern(dst), "shared draw");
+
+        // the next frame is invisible until it is published
+        writer.view().fill(color(1, 2, 3));
+        check(reader.draw(dst, point2d(0, 0)) && has_pattern(dst), "shared draw unpublished");
+        writer.publish();
+        color c;
+        check(reader.draw(dst, point2d(0, 0)) && is_uniform(dst, c) && c.rgb() == 0x010203,
+              "shared draw second frame");
+        check(reader.generation() == 2, "shared generation 2");
+
+        canvas scaled(26, 14, xrgb8888);
+        check(reader.draw(scaled, rect2d(0, 0, 26, 14)) && is_uniform(scaled, c) && c.rgb() == 0x010203,
+              "shared scaled draw");
+
+        bool thrown = false;
+        try {
+            reader.view();
+        } catch (const error&) {
+            thrown = true;
+        }
+        check(thrown, "shared view of a reader");
+    }
+
+    // frames must stay in shared memory and fit into the header
+    void test_invalid()
+    {
+        using namespace jacui;
+
+        bool thrown = false;
+        try {
+            shared_canvas huge(name, size2d(4096, 0x100000), xrgb8888);
+        } catch (const error&) {
+            thrown = true;
+        }
+        check(thrown, "shared canvas too large");
+
+        shared_canvas writer(name, size2d(13, 7), xrgb8888);
+        shared_canvas reader(name);
+        writer.view().resize(size2d(20, 10));
+        thrown = false;
+        try {
+            writer.publish();
+        } catch (const error&) {
+            thrown = true;
+        }
+        check(thrown && writer.generation() == 0, "shared publish of a resized frame");
+
+        writer.view() = canvas(13, 7, xrgb8888);
+        thrown = false;
+        try {
+            writer.publish();
+        } catch (const error&) {
+            thrown = true;
+        }
+        check(thrown, "shared publish of an assigned frame");
+
+        writer.view().fill(color(1, 2, 3));
+        writer.publish();
+        canvas dst(13, 7, xrgb8888);
+        color c;
+        check(writer.view().size() == size2d(13, 7) && reader.draw(dst, point2d(0, 0))
+              && is_uniform(dst, c) && c.rgb() == 0x010203, "shared frames restored");
+    }
+
+    const int frames = 200;
+
+    int publish_frames(void* p)
+    {
+        jacui::shared_canvas& writer = *static_cast<jacui::shared_canvas*>(p);
+        for (int i = 1; i <= frames; ++i) {
+            writer.view().fill(jacui::color(i, i, i));
+            writer.publish();
+            SDL_Delay(1);
+        }
+        return 0;
+    }
+
+    // a reader never sees a frame the writer is drawing
+    void test_concurrent()
+    {
+        using namespace jacui;
+
+        shared_canvas writer(name, size2d(64, 64), xrgb8888);
+        shared_canvas reader(name);
+        canvas dst(64, 64, xrgb8888);
+
+        SDL_Thread* thread = SDL_CreateThread(publish_frames, &writer);
+        check(thread != 0, "shared writer thread");
+
+        bool uniform = true;
+        bool ordered = true;
+        int last = 0;
+        while (thread && last != frames) {
+            color c;
+            if (reader.draw(dst, point2d(0, 0))) {
+                uniform = uniform && is_uniform(dst, c);
+                ordered = ordered && c.r >= last;
+                last = c.r;
+            }
+        }
+        if (thread)
+            SDL_WaitThread(thread, 0);
+        check(uniform, "shared frames not torn");
+        check(ordered, "shared frames in order");
+        check(reader.generation() == (unsigned long)frames, "shared generation");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    using namespace jacui;
+
+    shared_canvas::remove(name);
+    test_publish(rgb888);
+    test_publish(xrgb8888);
+    test_invalid();
+    test_concurrent();
+    shared_canvas::remove(name);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+#include "jacui/tiled.hpp"
+
+#include "check.hpp"
+
+#include <cstdio>
+
+namespace {
+    const int width = 100;
+    const int height = 60;
+
+    // constant in blocks of 4x4 pixels, so halving twice is exact
+    jacui::color block(int x, int y)
+    {
+        return jacui::color(x / 4 * 10, y / 4 * 16, (x / 4 ^ y / 4) * 8);
+    }
+
+    void save_blocks(const char* filename, bool png)
+    {
+        jacui::canvas c(width, height, jacui::xrgb8888);
+        for (int y = 0; y < height; y += 4)
+            for (int x = 0; x < width; x += 4)
+                c.fill(block(x, y), jacui::rect2d(x, y, 4, 4));
+        if (png)
+            c.save_png(filename);
+        else
+            c.save_ppm(filename);
+    }
+
+    // whether a surface shows the blocks reduced by a power of two
+    bool has_blocks(jacui::surface& s, int shift)
+    {
+        for (int y = 0; y != int(s.height()); ++y)
+            for (int x = 0; x != int(s.width()); ++x)
+                if (pixel(s, x, y).rgb() != block(x << shift, y << shift).rgb())
+                    return false;
+        return true;
+    }
+
+    void test_levels()
+    {
+        using namespace jacui;
+
+        save_blocks("test_tiled.ppm", false);
+        tiled_image t("test_tiled.ppm", 16);
+        check(t.size() == size2d(width, height), "tiled size");
+        check(t.tile_size() == 16, "tiled tile size");
+        // 100x60, 50x30, 25x15 and 13x8, which fits a tile
+        check(t.levels() == 4, "tiled levels");
+
+        // 7x4 tiles at the original size
+        canvas full(width, height, xrgb8888);
+        t.draw(full, rect2d(0, 0, width, height), point2d(0, 0));
+        check(has_blocks(full, 0), "tiled draw");
+        tiled_image::cache_stats s = t.stats();
+        check(s.misses == 28 && s.hits == 0 && s.entries == 28, "tiled tiles read");
+
+        t.draw(full, rect2d(0, 0, width, height), point2d(0, 0));
+        s = t.stats();
+        check(s.misses == 28 && s.hits == 28, "tiled tiles cached");
+
+        // a quarter of the size is drawn from level 2, which is
+        // computed from all tiles of the levels below
+        t.clear();
+        canvas quarter(width / 4, height / 4, xrgb8888);
+        t.draw(quarter, rect2d(0, 0, width, height), rect2d(0, 0, width / 4, height / 4));
+        check(has_blocks(quarter, 2), "tiled draw from level 2");
+        s = t.stats();
+        check(s.misses == 28 + 28 + 8 + 2 && s.entries == 28 + 8 + 2, "tiled pyramid computed");
+
+        t.draw(quarter, rect2d(0, 0, width, height), rect2d(0, 0, width / 4, height / 4));
+        check(t.stats().hits == s.hits + 2 && t.stats().misses == s.misses, "tiled level 2 cached");
+        std::remove("test_tiled.ppm");
+    }
+
+    void test_eviction()
+    {
+        using namespace jacui;
+
+        save_blocks("test_tiled.ppm", false);
+        tiled_image t("test_tiled.ppm", 16);
+        canvas full(width, height, xrgb8888);
+        t.draw(full, rect2d(0, 0, width, height), point2d(0, 0));
+
+        // a full tile has 16 rows of at least 64 bytes
+        t.budget(4 * 16 * 64);
+        tiled_image::cache_stats s = t.stats();
+        check(t.budget() == 4 * 16 * 64, "tiled budget");
+        check(s.bytes <= t.budget() && s.entries < 28 && s.evictions == 28 - s.entries,
+              "tiled eviction");
+
+        // the last tile drawn is the most recently used one
+        t.draw(full, rect2d(96, 48, 4, 12), point2d(96, 48));
+        check(t.stats().hits == s.hits + 1 && t.stats().misses == s.misses, "tiled LRU order");
+
+        // evicted tiles are read again, within the budget
+        full.fill(color(0, 0, 0));
+        t.draw(full, rect2d(0, 0, width, height), point2d(0, 0));
+        check(has_blocks(full, 0), "tiled draw after eviction");
+        check(t.stats().bytes <= t.budget() && t.stats().misses > s.misses, "tiled reload");
+        std::remove("test_tiled.ppm");
+    }
+
+    // compressed files are decoded once and split into tiles
+    void test_decoded()
+    {
+        using namespace jacui;
+
+        save_blocks("test_tiled.png", true);
+        tiled_image t("test_tiled.png", 16);
+        canvas full(width, height, xrgb8888);
+        t.draw(full, rect2d(0, 0, width, height), point2d(0, 0));
+        check(has_blocks(full, 0), "tiled draw of a PNG file");
+        std::remove("test_tiled.png");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    test_levels();
+    test_eviction();
+    test_decoded();
+
+    return failed ? 1 : 0;
+}
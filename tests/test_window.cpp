@@ -0,0 +1,161 @@
+#include "jacui/window.hpp"
+#include "jacui/image.hpp"
+
+#include "check.hpp"
+
+#include <vector>
+
+namespace {
+    int bits(const jacui::window& w)
+    {
+        return w.view().detail()->format->BitsPerPixel;
+    }
+
+    // the window's view has the requested depth, also after resizing
+    void test_format(jacui::pixel_format format, int depth)
+    {
+        using namespace jacui;
+
+        window w("test_window", 64, 48, format);
+        check(w.size() == size2d(64, 48) && bits(w) == depth, "window format");
+        w.resize(80, 60);
+        check(w.size() == size2d(80, 60) && bits(w) == depth, "resized window format");
+    }
+
+    // optimized images have the window's format and the same colors
+    void test_optimize(jacui::pixel_format format)
+    {
+        using namespace jacui;
+
+        window w("test_window", 64, 48, format);
+        const SDL_PixelFormat* f = w.view().detail()->format;
+        std::vector<unsigned char> bmp = make_bmp(13, 7);
+
+        image src(&bmp[0], bmp.size());
+        image img(src);
+        img.optimize_for(w);
+        const SDL_PixelFormat* g = img.detail()->format;
+        check(g->BitsPerPixel == f->BitsPerPixel && g->Rmask == f->Rmask
+              && g->Gmask == f->Gmask && g->Bmask == f->Bmask, "optimized format");
+        check(same_colors(src, img), "optimized colors");
+
+        image loaded(&bmp[0], bmp.size(), w);
+        check(loaded.detail()->format->BitsPerPixel == f->BitsPerPixel, "image loaded for a window");
+        check(same_colors(src, loaded), "image loaded for a window colors");
+    }
+
+    bool covers(const jacui::region& r, const jacui::rect2d& a)
+    {
+        for (jacui::region::const_iterator i = r.begin(); i != r.end(); ++i) {
+            if (a.x >= i->x && a.y >= i->y && a.x + a.width <= i->x + i->width
+                && a.y + a.height <= i->y + i->height)
+                return true;
+        }
+        return false;
+    }
+
+    void test_region()
+    {
+        using namespace jacui;
+
+        region r;
+        check(r.empty() && r.bounds() == rect2d(), "empty region");
+        r.add(rect2d(0, 0, 10, 10));
+        r.add(rect2d(2, 2, 3, 3));
+        r.add(rect2d(5, 5, 0, 0));
+        check(r.size() == 1 && *r.begin() == rect2d(0, 0, 10, 10), "region of a contained rect");
+        r.add(rect2d(10, 0, 5, 10));
+        check(r.size() == 1 && *r.begin() == rect2d(0, 0, 15, 10), "region of adjacent rects");
+        r.add(rect2d(40, 40, 5, 5));
+        check(r.size() == 2 && r.bounds() == rect2d(0, 0, 45, 45), "region of disjoint rects");
+        r.add(rect2d(0, 0, 50, 50));
+        check(r.size() == 1 && *r.begin() == rect2d(0, 0, 50, 50), "region of a containing rect");
+
+        // too many rects are merged, but still covered
+        region g;
+        for (int i = 0; i != 40; ++i)
+            g.add(rect2d(i % 8 * 20, i / 8 * 20, 5, 5));
+        bool covered = true;
+        for (int i = 0; i != 40; ++i)
+            covered = covered && covers(g, rect2d(i % 8 * 20, i / 8 * 20, 5, 5));
+        check(g.size() <= region::max_size, "region size limit");
+        check(covered && g.bounds() == rect2d(0, 0, 145, 85), "merged region");
+    }
+
+    // drawing to the view damages the clipped area it changed
+    void test_damage()
+    {
+        using namespace jacui;
+
+        window w("test_window", 64, 48, xrgb8888);
+        check(w.damaged().size() == 1 && w.damaged().bounds() == rect2d(0, 0, 64, 48),
+              "new window damaged");
+        w.update();
+        check(w.damaged().empty(), "window updated");
+
+        w.view().fill(color(1, 2, 3), rect2d(60, 40, 10, 10));
+        check(w.damaged().size() == 1 && w.damaged().bounds() == rect2d(60, 40, 4, 8),
+              "fill damage");
+        canvas c(8, 8);
+        w.view().blit(c, point2d(1, 2));
+        w.view().blit(c, rect2d(20, 0, 16, 16));
+        check(w.damaged().size() == 3 && covers(w.damaged(), rect2d(1, 2, 8, 8))
+              && covers(w.damaged(), rect2d(20, 0, 16, 16)), "blit damage");
+        w.view().fill(color(1, 2, 3), rect2d(100, 100, 10, 10));
+        check(w.damaged().size() == 3, "no damage outside the view");
+
+        w.update(region(rect2d(0, 0, 1, 1)));
+        check(w.damaged().size() == 3, "updating a region keeps the damage");
+
+        w.update();
+        {
+            pixel_view v = w.view().pixels(rect2d(40, 10, 30, 4));
+            check(w.damaged().empty(), "no pixel view damage while viewed");
+        }
+        check(w.damaged().size() == 1 && w.damaged().bounds() == rect2d(40, 10, 24, 4),
+              "pixel view damage");
+        w.resize(32, 32);
+        check(w.damaged().size() == 1 && w.damaged().bounds() == rect2d(0, 0, 32, 32),
+              "resized window damaged");
+    }
+
+    // damaged rects are clipped to the video surface, unless it can
+    // only be flipped
+    void test_update_rects()
+    {
+        using namespace jacui;
+
+        SDL_Surface* s = SDL_CreateRGBSurface(SDL_SWSURFACE, 64, 48, 32, 0, 0, 0, 0);
+        region r(rect2d(60, 40, 10, 10));
+        r.add(rect2d(0, 0, 2, 2));
+        r.add(rect2d(70, 10, 2, 2));
+
+        std::vector<SDL_Rect> rects;
+        bool ok = detail::update_rects(s, r, rects) && rects.size() == 2;
+        for (std::size_t i = 0; ok && i != rects.size(); ++i) {
+            ok = rects[i].x + rects[i].w <= 64 && rects[i].y + rects[i].h <= 48
+                && (rects[i].w == 2 || (rects[i].x == 60 && rects[i].w == 4 && rects[i].h == 8));
+        }
+        check(ok, "update rects");
+
+        s->flags |= SDL_DOUBLEBUF;
+        rects.clear();
+        check(!detail::update_rects(s, r, rects) && rects.empty(), "flipped update");
+        SDL_FreeSurface(s);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    using namespace jacui;
+
+    test_format(rgb888, 24);
+    test_format(xrgb8888, 32);
+    test_optimize(rgb888);
+    test_optimize(xrgb8888);
+    test_region();
+    test_damage();
+    test_update_rects();
+
+    return failed ? 1 : 0;
+}